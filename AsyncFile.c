@@ -0,0 +1,50 @@
+#include "general.h"
+
+static int torch_AsyncFile_new(lua_State *L)
+{
+  const char *name = luaL_checkstring(L, 1);
+  size_t prefetchSize = (size_t)luaL_optnumber(L, 2, 16*1048576);
+  int nBuffers = (int)luaL_optinteger(L, 3, 4);
+  int isQuiet = luaT_optboolean(L, 4, 0);
+  THFile *self;
+
+  luaL_argcheck(L, nBuffers >= 2, 3, "at least two buffers are required");
+  luaL_argcheck(L, prefetchSize >= (size_t)nBuffers, 2, "prefetch size is too small");
+  self = THAsyncFile_new(name, prefetchSize/nBuffers, nBuffers, isQuiet);
+
+  luaT_pushudata(L, self, "torch.AsyncFile");
+  return 1;
+}
+
+static int torch_AsyncFile_free(lua_State *L)
+{
+  THFile *self = luaT_checkudata(L, 1, "torch.AsyncFile");
+  THFile_free(self);
+  return 0;
+}
+
+static int torch_AsyncFile___tostring__(lua_State *L)
+{
+  THFile *self = luaT_checkudata(L, 1, "torch.AsyncFile");
+  lua_pushfstring(L, "torch.AsyncFile on <%s> [status: %s -- mode %c%c]",
+                  THAsyncFile_name(self),
+                  (THFile_isOpened(self) ? "open" : "closed"),
+                  (THFile_isReadable(self) ? 'r' : ' '),
+                  (THFile_isWritable(self) ? 'w' : ' '));
+
+  return 1;
+}
+
+static const struct luaL_Reg torch_AsyncFile__ [] = {
+  {"__tostring__", torch_AsyncFile___tostring__},
+  {NULL, NULL}
+};
+
+void torch_AsyncFile_init(lua_State *L)
+{
+  luaT_newmetatable(L, "torch.AsyncFile", "torch.File",
+                    torch_AsyncFile_new, torch_AsyncFile_free, NULL);
+
+  luaT_setfuncs(L, torch_AsyncFile__, 0);
+  lua_pop(L, 1);
+}
@@ -2,10 +2,14 @@
 
 static int torch_DiskFile_new(lua_State *L)
 {
-  const char *name = luaL_checkstring(L, 1);
   const char *mode = luaL_optstring(L, 2, "r");
   int isQuiet = luaT_optboolean(L, 3, 0);
-  THFile *self = THDiskFile_new(name, mode, isQuiet);
+  THFile *self;
+
+  if(lua_type(L, 1) == LUA_TNUMBER)
+    self = THDiskFile_newWithFd((int)lua_tointeger(L, 1), mode, isQuiet);
+  else
+    self = THDiskFile_new(luaL_checkstring(L, 1), mode, isQuiet);
 
   luaT_pushudata(L, self, "torch.DiskFile");
   return 1;
@@ -70,6 +74,26 @@ static int torch_DiskFile_noBuffer(lua_State *L)
   return 1;
 }
 
+static int torch_DiskFile_reserve(lua_State *L)
+{
+  THFile *self = luaT_checkudata(L, 1, "torch.DiskFile");
+  ptrdiff_t size = (ptrdiff_t)luaL_checknumber(L, 2);
+  luaL_argcheck(L, size >= 0, 2, "size must be positive");
+  THDiskFile_reserve(self, (size_t)size);
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int torch_DiskFile_truncate(lua_State *L)
+{
+  THFile *self = luaT_checkudata(L, 1, "torch.DiskFile");
+  ptrdiff_t size = (ptrdiff_t)luaL_checknumber(L, 2);
+  luaL_argcheck(L, size >= 0, 2, "size must be positive");
+  THDiskFile_truncate(self, (size_t)size);
+  lua_settop(L, 1);
+  return 1;
+}
+
 static int torch_DiskFile___tostring__(lua_State *L)
 {
   THFile *self = luaT_checkudata(L, 1, "torch.DiskFile");
@@ -89,6 +113,8 @@ static const struct luaL_Reg torch_DiskFile__ [] = {
   {"bigEndianEncoding", torch_DiskFile_bigEndianEncoding},
   {"longSize", torch_DiskFile_longSize},
   {"noBuffer", torch_DiskFile_noBuffer},
+  {"reserve", torch_DiskFile_reserve},
+  {"truncate", torch_DiskFile_truncate},
   {"__tostring__", torch_DiskFile___tostring__},
   {NULL, NULL}
 };
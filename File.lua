@@ -21,6 +21,11 @@ local TYPE_BOOLEAN  = 5
 local TYPE_FUNCTION = 6
 local TYPE_RECUR_FUNCTION = 8
 local LEGACY_TYPE_RECUR_FUNCTION = 7
+local TYPE_STORAGE_REF = 9
+
+-- incremental checkpoints: storages smaller than this are always written inline
+local STORAGE_REF_MIN_SIZE = 4096
+local STORAGE_INDEX_MAGIC = 'T7SINDEX'
 
 -- Lua 5.2 compatibility
 local loadstring = loadstring or load
@@ -104,6 +109,25 @@ local function formatStack(objectNameStack)
    return table.concat(parts, '.')
 end
 
+-- absolute file name made relative to an absolute directory, so that
+-- checkpoints can be moved together; kept absolute across drives
+local function relativePath(name, directory)
+   local nameParts, directoryParts, parts = {}, {}, {}
+   for part in name:gmatch('[^/\\]+') do table.insert(nameParts, part) end
+   for part in directory:gmatch('[^/\\]+') do table.insert(directoryParts, part) end
+   local common = 0
+   while common < #directoryParts and common < #nameParts-1
+      and nameParts[common+1] == directoryParts[common+1] do
+      common = common + 1
+   end
+   if common == 0 and nameParts[1] and nameParts[1]:find(':') then
+      return name
+   end
+   for i = common+1, #directoryParts do table.insert(parts, '..') end
+   for i = common+1, #nameParts do table.insert(parts, nameParts[i]) end
+   return table.concat(parts, '/')
+end
+
 function File:writeObject(object, debugname, hook)
    -- define a default hook function if not provided
    hook = hook or function(object) return object end
@@ -140,6 +164,19 @@ function File:writeObject(object, debugname, hook)
    if not typeidx then
       error(string.format('Unwritable object <%s> at %s', type(object), formatStack(objectNameStack)))
    end
+
+   -- incremental mode: storages found unchanged in the base checkpoint are
+   -- written as a reference to their data in that checkpoint
+   local storageIndex = torch.getenv(self).storageIndex
+   local storageKey, storageRef
+   if storageIndex and typeidx == TYPE_TORCH and torch.isStorage(object)
+      and object:size()*object:elementSize() >= STORAGE_REF_MIN_SIZE then
+      storageKey = string.format('%s:%d:%s', torch.typename(object), object:size(), object:hash())
+      storageRef = torch.getenv(self).storageBase[storageKey]
+      if storageRef then
+         typeidx = TYPE_STORAGE_REF
+      end
+   end
    self:writeInt(typeidx)
 
    if typeidx == TYPE_NUMBER then
@@ -150,7 +187,7 @@ function File:writeObject(object, debugname, hook)
       local stringStorage = torch.CharStorage():string(object)
       self:writeInt(#stringStorage)
       self:writeChar(stringStorage)
-   elseif typeidx == TYPE_TORCH or typeidx == TYPE_TABLE or  typeidx == TYPE_RECUR_FUNCTION then
+   elseif typeidx == TYPE_TORCH or typeidx == TYPE_TABLE or  typeidx == TYPE_RECUR_FUNCTION or typeidx == TYPE_STORAGE_REF then
       -- check it exists already (we look at the pointer!)
       local objects = torch.getenv(self).writeObjects
       local objectsRef = torch.getenv(self).writeObjectsRef
@@ -198,6 +235,15 @@ function File:writeObject(object, debugname, hook)
             self:writeInt(#stringStorage)
             self:writeChar(stringStorage)
             self:writeObject(upvalues, UPVALUES_TOKEN, hook)
+         elseif typeidx == TYPE_STORAGE_REF then
+            local className = torch.CharStorage():string(torch.typename(object))
+            local fileName = torch.CharStorage():string(relativePath(storageRef.file, torch.getenv(self).directory))
+            self:writeInt(#className)
+            self:writeChar(className)
+            self:writeInt(#fileName)
+            self:writeChar(fileName)
+            self:writeLong(storageRef.offset)
+            storageIndex[storageKey] = storageRef
          elseif typeidx == TYPE_TORCH then
             local version   = torch.CharStorage():string('V ' .. torch.version(object))
             local className = torch.CharStorage():string(torch.typename(object))
@@ -205,6 +251,9 @@ function File:writeObject(object, debugname, hook)
             self:writeChar(version)
             self:writeInt(#className)
             self:writeChar(className)
+            if storageKey then
+               storageIndex[storageKey] = {offset = self:position()-1}
+            end
             local write = getmetamethod(object, 'write')
             if write then
                write(object, self)
@@ -282,7 +331,7 @@ function File:readObject()
           debug.setupvalue(func, index, upvalue)
        end
        return func
-   elseif typeidx == TYPE_TABLE or typeidx == TYPE_TORCH or typeidx == TYPE_RECUR_FUNCTION or typeidx == LEGACY_TYPE_RECUR_FUNCTION then
+   elseif typeidx == TYPE_TABLE or typeidx == TYPE_TORCH or typeidx == TYPE_RECUR_FUNCTION or typeidx == LEGACY_TYPE_RECUR_FUNCTION or typeidx == TYPE_STORAGE_REF then
       -- read the index
       local index = self:readInt()
 
@@ -329,6 +378,30 @@ function File:readObject()
             end
          end
          return func
+      elseif typeidx == TYPE_STORAGE_REF then
+         local env = torch.getenv(self)
+         local className = self:readChar(self:readInt()):string()
+         local fileName = self:readChar(self:readInt()):string()
+         local offset = self:readLong()
+         if not torch.factory(className) then
+            error(string.format('unknown Torch class <%s>', tostring(className)))
+         end
+         if env.directory then
+            fileName = paths.concat(env.directory, fileName)
+         end
+         env.storageFiles = env.storageFiles or {}
+         local file = env.storageFiles[fileName]
+         if not file then
+            file = torch.DiskFile(fileName, 'r'):binary()
+            env.storageFiles[fileName] = file
+         end
+         file:seek(offset+1)
+         local object = torch.factory(className)(file)
+         object:read(file)
+         if not force then
+             objects[index] = object
+         end
+         return object
       elseif typeidx == TYPE_TORCH then
          local version, className, versionNumber
          version = self:readChar(self:readInt()):string()
@@ -347,7 +420,9 @@ function File:readObject()
              objects[index] = object
          end
          local read = getmetamethod(object, 'read')
-         if read then
+         if torch.getenv(self).storageView and torch.isStorage(object) then
+            object:readView(self)
+         elseif read then
             read(object, self, versionNumber)
          elseif type(object) == 'table' then
             local var = self:readObject()
@@ -376,16 +451,157 @@ function File:readObject()
    end
 end
 
+-- Tensor frames: a minimal header (magic, type, sizes) followed by the raw
+-- contiguous data, without the object bookkeeping of writeObject. Meant to
+-- stream tensors through pipes and sockets.
+local TENSOR_FRAME_MAGIC = 0x54374652
+local TENSOR_FRAME_TYPES = {'Byte', 'Char', 'Short', 'Int', 'Long', 'Float', 'Double'}
+local TENSOR_FRAME_CODES = {}
+for code, typeName in ipairs(TENSOR_FRAME_TYPES) do
+   TENSOR_FRAME_CODES['torch.' .. typeName .. 'Tensor'] = code
+end
+
+function File:writeTensorFrame(tensor)
+   assert(self:isBinary(), 'tensor frames require a binary file')
+   local code = TENSOR_FRAME_CODES[torch.typename(tensor)]
+   if not code then
+      error(string.format('cannot write a frame of <%s>', torch.type(tensor)))
+   end
+   self:writeInt(TENSOR_FRAME_MAGIC)
+   self:writeInt(code)
+   self:writeInt(tensor:dim())
+   if tensor:dim() > 0 then
+      self:writeLong(tensor:size())
+   end
+   if tensor:nElement() > 0 then
+      tensor = tensor:contiguous()
+      -- one write of the whole data, through a storage view
+      local storage = torch[TENSOR_FRAME_TYPES[code] .. 'Storage'](tensor:storage(), tensor:storageOffset(), tensor:nElement())
+      self['write' .. TENSOR_FRAME_TYPES[code]](self, storage)
+   end
+   return self
+end
+
+-- Reads a frame into tensor when given (it is resized if needed, and must
+-- have the type of the frame), or into a new tensor. Returns nil at the end
+-- of the file.
+function File:readTensorFrame(tensor)
+   assert(self:isBinary(), 'tensor frames require a binary file')
+   local isQuiet = self:isQuiet()
+   self:quiet()
+   local magic = self:readInt()
+   if not isQuiet then
+      self:pedantic()
+   end
+   if self:hasError() then
+      self:clearError()
+      return nil
+   end
+   if magic ~= TENSOR_FRAME_MAGIC then
+      error('not a tensor frame')
+   end
+   local typeName = TENSOR_FRAME_TYPES[self:readInt()]
+   if not typeName then
+      error('unknown tensor frame type')
+   end
+   local nDimension = self:readInt()
+   local size = nDimension > 0 and self:readLong(nDimension) or torch.LongStorage()
+
+   local tensorType = 'torch.' .. typeName .. 'Tensor'
+   if tensor then
+      if torch.typename(tensor) ~= tensorType then
+         error(string.format('frame of <%s> cannot be read into <%s>', tensorType, torch.type(tensor)))
+      end
+   else
+      tensor = torch[typeName .. 'Tensor']()
+   end
+
+   if nDimension == 0 then
+      return tensor:set()
+   end
+   if not tensor:isSize(size) then
+      tensor:resize(size)
+   end
+   local target = tensor:isContiguous() and tensor or torch[typeName .. 'Tensor'](size)
+   if target:nElement() > 0 then
+      -- read straight into the tensor memory
+      local storage = torch[typeName .. 'Storage'](target:storage(), target:storageOffset(), target:nElement())
+      self['read' .. typeName](self, storage)
+   end
+   if target ~= tensor then
+      tensor:copy(target)
+   end
+   return tensor
+end
+
+-- returns the storage index of an incremental checkpoint (with absolute
+-- file names), or nil if the file has none
+local function readStorageIndex(filename)
+   filename = paths.concat(filename)
+   local file = torch.DiskFile(filename, 'r'):binary()
+   file:seekEnd()
+   local size = file:position()-1
+   local index
+   if size >= #STORAGE_INDEX_MAGIC + 8 then
+      file:seek(size - #STORAGE_INDEX_MAGIC - 8 + 1)
+      local position = file:readLong()
+      if file:readChar(#STORAGE_INDEX_MAGIC):string() == STORAGE_INDEX_MAGIC then
+         file:seek(position+1)
+         index = file:readObject()
+      end
+   end
+   file:close()
+   if index then
+      local directory = paths.dirname(filename)
+      for key, entry in pairs(index) do
+         entry.file = entry.file and paths.concat(directory, entry.file) or filename
+      end
+   end
+   return index
+end
+
+-- appends the storage index of an incremental checkpoint, with file names
+-- relative to the checkpoint directory
+local function writeStorageIndex(file, filename, index)
+   local directory = paths.dirname(paths.concat(filename))
+   local relative = {}
+   for key, entry in pairs(index) do
+      relative[key] = {file = entry.file and relativePath(entry.file, directory), offset = entry.offset}
+   end
+   local position = file:position()-1
+   file:writeObject(relative)
+   file:writeLong(position)
+   file:writeString(STORAGE_INDEX_MAGIC)
+end
+
 -- simple helpers to save/load arbitrary objects/tables
-function torch.save(filename, object, mode, referenced)
+function torch.save(filename, object, mode, referenced, base)
    assert(mode == nil or mode == 'binary' or mode == 'ascii', '"binary" or "ascii" (or nil) expected for mode')
    assert(referenced == nil or referenced == true or referenced == false, 'true or false (or nil) expected for referenced')
+   assert(base == nil or base == true or type(base) == 'string', 'true or a base checkpoint filename (or nil) expected for base')
    mode = mode or 'binary'
    referenced = referenced == nil and true or referenced
+   assert(not base or mode == 'binary', 'incremental checkpoints must be saved in binary mode')
+   local storageBase = {}
+   if type(base) == 'string' then
+      storageBase = readStorageIndex(base)
+      if not storageBase then
+         error(string.format('<%s> is not an incremental checkpoint', base))
+      end
+   end
    local file = torch.DiskFile(filename, 'w')
    file[mode](file)
    file:referenced(referenced)
+   if base then
+      local env = torch.getenv(file)
+      env.storageBase = storageBase
+      env.storageIndex = {}
+      env.directory = paths.dirname(paths.concat(filename))
+   end
    file:writeObject(object)
+   if base then
+      writeStorageIndex(file, filename, torch.getenv(file).storageIndex)
+   end
    file:close()
 end
 
@@ -406,15 +622,27 @@ function torch.load(filename, mode, referenced)
    file[mode](file)
    file:referenced(referenced)
    if longSize then file:longSize(longSize) end
+   local env = torch.getenv(file)
+   env.directory = paths.dirname(paths.concat(filename))
    local object = file:readObject()
+   for _, storageFile in pairs(env.storageFiles or {}) do
+      storageFile:close()
+   end
    file:close()
    return object
 end
 
 -- simple helpers to serialize/deserialize arbitrary objects/tables
 function torch.serialize(object, mode)
-   local storage = torch.serializeToStorage(object, mode)
-   return storage:string()
+   mode = mode or 'binary'
+   local f = torch.MemoryFile()
+   f = f[mode](f)
+   f:writeObject(object)
+   -- straight from the pieces of the file to the string, without
+   -- flattening them in its storage first
+   local str = f:drain()
+   f:close()
+   return str
 end
 
 -- Serialize to a CharStorage, not a lua string. This avoids
@@ -430,15 +658,29 @@ function torch.serializeToStorage(object, mode)
    return storage
 end
 
-function torch.deserializeFromStorage(storage, mode)
+-- With view set to true (binary mode only), the deserialized storages point
+-- into the given storage when their data is suitably aligned, instead of
+-- being copied: they cannot be resized, and share its memory.
+function torch.deserializeFromStorage(storage, mode, view)
    mode = mode or 'binary'
-   local tx = torch.CharTensor(storage)
-   local xp = torch.CharStorage(tx:size(1)+1)
-   local txp = torch.CharTensor(xp)
-   txp:narrow(1,1,tx:size(1)):copy(tx)
-   txp[tx:size(1)+1] = 0
-   local f = torch.MemoryFile(xp)
+   assert(not view or mode == 'binary', 'storage views require the binary mode')
+   local f
+   if mode == 'binary' then
+      -- binary reading does not need a terminating 0: no copy
+      f = torch.MemoryFile(storage, 'r', true)
+   else
+      local tx = torch.CharTensor(storage)
+      local xp = torch.CharStorage(tx:size(1)+1)
+      local txp = torch.CharTensor(xp)
+      txp:narrow(1,1,tx:size(1)):copy(tx)
+      txp[tx:size(1)+1] = 0
+      f = torch.MemoryFile(xp)
+   end
    f = f[mode](f)
+   if view then
+      f:referenced(true)
+      torch.getenv(f).storageView = true
+   end
    local object = f:readObject()
    f:close()
    return object
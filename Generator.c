@@ -1,6 +1,19 @@
 #include <general.h>
 
+/* serialization version, 2 since the Philox fields are written */
+#define TORCH_GENERATOR_VERSION 2
+
+static const char *torch_Generator_algorithms[] = {"mt19937", "philox", NULL};
+
 int torch_Generator_new(lua_State *L)
+{
+  int type = luaL_checkoption(L, 1, "mt19937", torch_Generator_algorithms);
+  THGenerator *gen = THGenerator_newWithType(type == 0 ? TH_GENERATOR_MT19937 : TH_GENERATOR_PHILOX);
+  luaT_pushudata(L, gen, torch_Generator);
+  return 1;
+}
+
+static int torch_Generator_factory(lua_State *L)
 {
   THGenerator *gen = THGenerator_new();
   luaT_pushudata(L, gen, torch_Generator);
@@ -27,24 +40,68 @@ static int torch_Generator_read(lua_State *L)
 {
   THGenerator *gen = luaT_checkudata(L, 1, torch_Generator);
   THFile *file = luaT_checkudata(L, 2, "torch.File");
+  /* before version 2, only the Mersenne Twister fields were written */
+  int version = (int)luaL_optinteger(L, 3, TORCH_GENERATOR_VERSION);
+  size_t size = (version < 2 ? THGenerator_mt19937StateSize() : sizeof(THGenerator));
+  THGenerator state;
 
-  THFile_readByteRaw(file, (unsigned char *)gen, sizeof(THGenerator));
+  THFile_readByteRaw(file, (unsigned char *)&state, size);
+  THGenerator_copyState(gen, &state, size);
   return 0;
 }
 
 
+static int torch_Generator_algorithm(lua_State *L)
+{
+  THGenerator *gen = luaT_checkudata(L, 1, torch_Generator);
+  lua_pushstring(L, torch_Generator_algorithms[THGenerator_type(gen) == TH_GENERATOR_PHILOX ? 1 : 0]);
+  return 1;
+}
+
+static int torch_Generator_jump(lua_State *L)
+{
+  THGenerator *gen = luaT_checkudata(L, 1, torch_Generator);
+  int log2Steps = (int)luaL_checkinteger(L, 2);
+  THRandom_jump(gen, log2Steps);
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int torch_Generator_split(lua_State *L)
+{
+  THGenerator *gen = luaT_checkudata(L, 1, torch_Generator);
+  int nStreams = (int)luaL_checkinteger(L, 2);
+  THGenerator **streams;
+  int i;
+
+  luaL_argcheck(L, nStreams > 0, 2, "number of streams must be positive");
+  streams = THAlloc(sizeof(THGenerator*)*nStreams);
+  THGenerator_split(gen, nStreams, streams);
+  lua_createtable(L, nStreams, 0);
+  for(i = 0; i < nStreams; i++)
+  {
+    luaT_pushudata(L, streams[i], torch_Generator);
+    lua_rawseti(L, -2, i+1);
+  }
+  THFree(streams);
+  return 1;
+}
+
 static const struct luaL_Reg torch_Generator_table_ [] = {
+  {"algorithm", torch_Generator_algorithm},
+  {"jump", torch_Generator_jump},
+  {"split", torch_Generator_split},
   {"write", torch_Generator_write},
   {"read", torch_Generator_read},
   {NULL, NULL}
 };
 
-#define torch_Generator_factory torch_Generator_new
-
 void torch_Generator_init(lua_State *L)
 {
   luaT_newmetatable(L, torch_Generator, NULL,
                     torch_Generator_new, torch_Generator_free, torch_Generator_factory);
   luaT_setfuncs(L, torch_Generator_table_, 0);
+  lua_pushnumber(L, TORCH_GENERATOR_VERSION);
+  lua_setfield(L, -2, "__version");
   lua_pop(L, 1);
 }
@@ -9,7 +9,10 @@ static int torch_MemoryFile_new(lua_State *L)
   if(storage)
   {
     mode = luaL_optstring(L, 2, "rw");
-    self = THMemoryFile_newWithStorage(storage, mode);
+    if(luaT_optboolean(L, 3, 0))
+      self = THMemoryFile_newWithRawStorage(storage, mode);
+    else
+      self = THMemoryFile_newWithStorage(storage, mode);
   }
   else
   {
@@ -29,6 +32,23 @@ static int torch_MemoryFile_storage(lua_State *L)
   return 1;
 }
 
+/* each piece becomes a string on the stack, concatenated at the end */
+static void torch_MemoryFile_pushPiece(void *state, const char *data, size_t size)
+{
+  lua_State *L = state;
+  luaL_checkstack(L, 1, "too many pieces in memory file");
+  lua_pushlstring(L, data, size);
+}
+
+static int torch_MemoryFile_drain(lua_State *L)
+{
+  THFile *self = luaT_checkudata(L, 1, "torch.MemoryFile");
+  lua_settop(L, 1);
+  THMemoryFile_drain(self, torch_MemoryFile_pushPiece, L);
+  lua_concat(L, lua_gettop(L)-1);
+  return 1;
+}
+
 static int torch_longSize(lua_State *L)
 {
   THFile *self = luaT_checkudata(L, 1, "torch.MemoryFile");
@@ -56,6 +76,7 @@ static int torch_MemoryFile___tostring__(lua_State *L)
 
 static const struct luaL_Reg torch_MemoryFile__ [] = {
   {"storage", torch_MemoryFile_storage},
+  {"drain", torch_MemoryFile_drain},
   {"longSize", torch_longSize},
   {"__tostring__", torch_MemoryFile___tostring__},
   {NULL, NULL}
@@ -0,0 +1,121 @@
+#include "general.h"
+
+static int torch_SharedPool_new(lua_State *L)
+{
+  const char *name = luaL_checkstring(L, 1);
+  THSharedPool *pool;
+
+  if(lua_gettop(L) > 1)
+  {
+    size_t blockSize = (size_t)luaL_checknumber(L, 2);
+    long nBlocks = (long)luaL_checkinteger(L, 3);
+    pool = THSharedPool_new(name, blockSize, nBlocks);
+  }
+  else
+    pool = THSharedPool_open(name);
+
+  luaT_pushudata(L, pool, "torch.SharedPool");
+  return 1;
+}
+
+static int torch_SharedPool_free(lua_State *L)
+{
+  THSharedPool *pool = luaT_checkudata(L, 1, "torch.SharedPool");
+  THSharedPool_free(pool);
+  return 0;
+}
+
+static int torch_SharedPool_name(lua_State *L)
+{
+  THSharedPool *pool = luaT_checkudata(L, 1, "torch.SharedPool");
+  lua_pushstring(L, THSharedPool_name(pool));
+  return 1;
+}
+
+static int torch_SharedPool_blockSize(lua_State *L)
+{
+  THSharedPool *pool = luaT_checkudata(L, 1, "torch.SharedPool");
+  lua_pushnumber(L, THSharedPool_blockSize(pool));
+  return 1;
+}
+
+static int torch_SharedPool_size(lua_State *L)
+{
+  THSharedPool *pool = luaT_checkudata(L, 1, "torch.SharedPool");
+  lua_pushnumber(L, THSharedPool_nBlocks(pool));
+  return 1;
+}
+
+static int torch_SharedPool_nFree(lua_State *L)
+{
+  THSharedPool *pool = luaT_checkudata(L, 1, "torch.SharedPool");
+  lua_pushnumber(L, THSharedPool_nFreeBlocks(pool));
+  return 1;
+}
+
+#define TORCH_SHARED_POOL_STORAGE(TYPEC)                                 \
+  else if( (storage = luaT_toudata(L, 2, "torch." #TYPEC "Storage")) )  \
+  {                                                                     \
+    TH##TYPEC##Storage *s = storage;                                    \
+    data = s->data;                                                     \
+    isInPool = (s->allocator == &THSharedPoolAllocator && s->allocatorContext == pool); \
+  }
+
+/* returns the block of a storage allocated in the pool, with an extra
+   reference which is handed over to the storage created from this block
+   (in any process) */
+static int torch_SharedPool_share(lua_State *L)
+{
+  THSharedPool *pool = luaT_checkudata(L, 1, "torch.SharedPool");
+  void *storage;
+  void *data = NULL;
+  int isInPool = 0;
+  long block;
+
+  if(0) {}
+  TORCH_SHARED_POOL_STORAGE(Byte)
+  TORCH_SHARED_POOL_STORAGE(Char)
+  TORCH_SHARED_POOL_STORAGE(Short)
+  TORCH_SHARED_POOL_STORAGE(Int)
+  TORCH_SHARED_POOL_STORAGE(Long)
+  TORCH_SHARED_POOL_STORAGE(Float)
+  TORCH_SHARED_POOL_STORAGE(Double)
+  TORCH_SHARED_POOL_STORAGE(Half)
+  else
+    luaL_typerror(L, 2, "torch.*Storage");
+
+  luaL_argcheck(L, isInPool, 2, "storage is not allocated in this pool");
+  block = THSharedPool_block(pool, data);
+  THSharedPool_incref(pool, block);
+  lua_pushnumber(L, block+1);
+  return 1;
+}
+
+static int torch_SharedPool___tostring__(lua_State *L)
+{
+  THSharedPool *pool = luaT_checkudata(L, 1, "torch.SharedPool");
+  lua_pushfstring(L, "torch.SharedPool <%s> [%d blocks of %d bytes, %d free]",
+                  THSharedPool_name(pool),
+                  (int)THSharedPool_nBlocks(pool),
+                  (int)THSharedPool_blockSize(pool),
+                  (int)THSharedPool_nFreeBlocks(pool));
+  return 1;
+}
+
+static const struct luaL_Reg torch_SharedPool__ [] = {
+  {"name", torch_SharedPool_name},
+  {"blockSize", torch_SharedPool_blockSize},
+  {"size", torch_SharedPool_size},
+  {"nFree", torch_SharedPool_nFree},
+  {"share", torch_SharedPool_share},
+  {"__tostring__", torch_SharedPool___tostring__},
+  {NULL, NULL}
+};
+
+void torch_SharedPool_init(lua_State *L)
+{
+  luaT_newmetatable(L, "torch.SharedPool", NULL,
+                    torch_SharedPool_new, torch_SharedPool_free, NULL);
+  luaT_setfuncs(L, torch_SharedPool__, 0);
+  lua_pop(L, 1);
+}
@@ -0,0 +1,211 @@
+#include "general.h"
+
+static int torch_SharedQueue_new(lua_State *L)
+{
+  const char *name = luaL_checkstring(L, 1);
+  THSharedQueue *queue;
+
+  if(lua_gettop(L) > 1)
+  {
+    THSharedPool *pool = luaT_checkudata(L, 2, "torch.SharedPool");
+    long capacity = (long)luaL_checkinteger(L, 3);
+    queue = THSharedQueue_new(name, pool, capacity);
+  }
+  else
+    queue = THSharedQueue_open(name);
+
+  luaT_pushudata(L, queue, "torch.SharedQueue");
+  return 1;
+}
+
+static int torch_SharedQueue_free(lua_State *L)
+{
+  THSharedQueue *queue = luaT_checkudata(L, 1, "torch.SharedQueue");
+  THSharedQueue_free(queue);
+  return 0;
+}
+
+static int torch_SharedQueue_name(lua_State *L)
+{
+  THSharedQueue *queue = luaT_checkudata(L, 1, "torch.SharedQueue");
+  lua_pushstring(L, THSharedQueue_name(queue));
+  return 1;
+}
+
+static int torch_SharedQueue_pool(lua_State *L)
+{
+  THSharedQueue *queue = luaT_checkudata(L, 1, "torch.SharedQueue");
+  THSharedPool *pool = THSharedQueue_pool(queue);
+  THSharedPool_retain(pool);
+  luaT_pushudata(L, pool, "torch.SharedPool");
+  return 1;
+}
+
+static int torch_SharedQueue_capacity(lua_State *L)
+{
+  THSharedQueue *queue = luaT_checkudata(L, 1, "torch.SharedQueue");
+  lua_pushnumber(L, THSharedQueue_capacity(queue));
+  return 1;
+}
+
+static int torch_SharedQueue_size(lua_State *L)
+{
+  THSharedQueue *queue = luaT_checkudata(L, 1, "torch.SharedQueue");
+  lua_pushnumber(L, THSharedQueue_size(queue));
+  return 1;
+}
+
+/* items only record the sizes of a tensor, and the block of its storage */
+#define TORCH_SHARED_QUEUE_ITEM(TYPEC, TYPECODE)                         \
+  else if( (tensor = luaT_toudata(L, 2, "torch." #TYPEC "Tensor")) )    \
+  {                                                                     \
+    TH##TYPEC##Tensor *t = tensor;                                      \
+    luaL_argcheck(L, TH##TYPEC##Tensor_isContiguous(t), 2, "tensor must be contiguous"); \
+    luaL_argcheck(L, t->nDimension <= TH_SHARED_QUEUE_MAX_DIMENSION, 2, "too many dimensions"); \
+    luaL_argcheck(L, t->storage && t->storage->allocator == &THSharedPoolAllocator && \
+                  t->storage->allocatorContext == pool, 2,              \
+                  "tensor storage is not allocated in the queue pool"); \
+    item.block = THSharedPool_block(pool, t->storage->data);            \
+    item.type = TYPECODE;                                               \
+    item.nDimension = t->nDimension;                                    \
+    item.storageOffset = t->storageOffset;                              \
+    for(i = 0; i < t->nDimension; i++)                                  \
+      item.size[i] = t->size[i];                                        \
+  }
+
+static int torch_SharedQueue_push_(lua_State *L, int wait)
+{
+  THSharedQueue *queue = luaT_checkudata(L, 1, "torch.SharedQueue");
+  THSharedPool *pool = THSharedQueue_pool(queue);
+  THSharedQueueItem item;
+  void *tensor;
+  int i;
+
+  if(0) {}
+  TORCH_SHARED_QUEUE_ITEM(Byte, 1)
+  TORCH_SHARED_QUEUE_ITEM(Char, 2)
+  TORCH_SHARED_QUEUE_ITEM(Short, 3)
+  TORCH_SHARED_QUEUE_ITEM(Int, 4)
+  TORCH_SHARED_QUEUE_ITEM(Long, 5)
+  TORCH_SHARED_QUEUE_ITEM(Float, 6)
+  TORCH_SHARED_QUEUE_ITEM(Double, 7)
+  TORCH_SHARED_QUEUE_ITEM(Half, 8)
+  else
+    luaL_typerror(L, 2, "torch.*Tensor");
+
+  /* the queued item holds a reference on the block, taken over by the
+     tensor returned by pop() */
+  THSharedPool_incref(pool, item.block);
+  if(wait)
+    THSharedQueue_push(queue, &item);
+  else if(!THSharedQueue_tryPush(queue, &item))
+  {
+    THSharedPool_decref(pool, item.block);
+    lua_pushboolean(L, 0);
+    return 1;
+  }
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+#define TORCH_SHARED_QUEUE_TENSOR(TYPEC, TYPECODE)                       \
+  case TYPECODE:                                                        \
+  {                                                                     \
+    TH##TYPEC##Storage *storage;                                        \
+    TH##TYPEC##Tensor *tensor;                                          \
+    THSharedPool_retain(pool);                                          \
+    storage = TH##TYPEC##Storage_newWithDataAndAllocator(               \
+      THSharedPool_data(pool, item.block),                              \
+      (ptrdiff_t)(THSharedPool_blockSize(pool)/sizeof(*storage->data)), \
+      &THSharedPoolAllocator, pool);                                    \
+    tensor = TH##TYPEC##Tensor_newWithStorage(storage, item.storageOffset, size, NULL); \
+    TH##TYPEC##Storage_free(storage);                                   \
+    luaT_pushudata(L, tensor, "torch." #TYPEC "Tensor");                \
+    break;                                                              \
+  }
+
+static int torch_SharedQueue_pop_(lua_State *L, int wait)
+{
+  THSharedQueue *queue = luaT_checkudata(L, 1, "torch.SharedQueue");
+  THSharedPool *pool = THSharedQueue_pool(queue);
+  THSharedQueueItem item;
+  THLongStorage *size;
+
+  if(wait)
+    THSharedQueue_pop(queue, &item);
+  else if(!THSharedQueue_tryPop(queue, &item))
+    return 0;
+
+  size = THLongStorage_newWithSize(item.nDimension);
+  memcpy(size->data, item.size, item.nDimension*sizeof(long));
+  /* the tensor storage takes over the reference of the item on its block */
+  switch(item.type)
+  {
+    TORCH_SHARED_QUEUE_TENSOR(Byte, 1)
+    TORCH_SHARED_QUEUE_TENSOR(Char, 2)
+    TORCH_SHARED_QUEUE_TENSOR(Short, 3)
+    TORCH_SHARED_QUEUE_TENSOR(Int, 4)
+    TORCH_SHARED_QUEUE_TENSOR(Long, 5)
+    TORCH_SHARED_QUEUE_TENSOR(Float, 6)
+    TORCH_SHARED_QUEUE_TENSOR(Double, 7)
+    TORCH_SHARED_QUEUE_TENSOR(Half, 8)
+    default:
+      THLongStorage_free(size);
+      THSharedPool_decref(pool, item.block);
+      luaL_error(L, "invalid item in shared queue <%s>", THSharedQueue_name(queue));
+  }
+  THLongStorage_free(size);
+  return 1;
+}
+
+static int torch_SharedQueue_push(lua_State *L)
+{
+  return torch_SharedQueue_push_(L, 1);
+}
+
+static int torch_SharedQueue_tryPush(lua_State *L)
+{
+  return torch_SharedQueue_push_(L, 0);
+}
+
+static int torch_SharedQueue_pop(lua_State *L)
+{
+  return torch_SharedQueue_pop_(L, 1);
+}
+
+static int torch_SharedQueue_tryPop(lua_State *L)
+{
+  return torch_SharedQueue_pop_(L, 0);
+}
+
+static int torch_SharedQueue___tostring__(lua_State *L)
+{
+  THSharedQueue *queue = luaT_checkudata(L, 1, "torch.SharedQueue");
+  lua_pushfstring(L, "torch.SharedQueue <%s> [%d/%d items, pool <%s>]",
+                  THSharedQueue_name(queue),
+                  (int)THSharedQueue_size(queue),
+                  (int)THSharedQueue_capacity(queue),
+                  THSharedPool_name(THSharedQueue_pool(queue)));
+  return 1;
+}
+
+static const struct luaL_Reg torch_SharedQueue__ [] = {
+  {"name", torch_SharedQueue_name},
+  {"pool", torch_SharedQueue_pool},
+  {"capacity", torch_SharedQueue_capacity},
+  {"size", torch_SharedQueue_size},
+  {"push", torch_SharedQueue_push},
+  {"tryPush", torch_SharedQueue_tryPush},
+  {"pop", torch_SharedQueue_pop},
+  {"tryPop", torch_SharedQueue_tryPop},
+  {"__tostring__", torch_SharedQueue___tostring__},
+  {NULL, NULL}
+};
+
+void torch_SharedQueue_init(lua_State *L)
+{
+  luaT_newmetatable(L, "torch.SharedQueue", NULL,
+                    torch_SharedQueue_new, torch_SharedQueue_free, NULL);
+  luaT_setfuncs(L, torch_SharedQueue__, 0);
+  lua_pop(L, 1);
+}
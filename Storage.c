@@ -5,6 +5,34 @@
 #define THFile_writeRealRaw TH_CONCAT_3(THFile_write, Real, Raw)
 #define torch_Storage TH_CONCAT_STRING_3(torch.,Real,Storage)
 
+/* access hints of a mapped storage, given as a string of space-separated
+   words among populate, willneed, sequential and random */
+static int torch_Storage_mappingHints(lua_State *L, int index)
+{
+  const char *str = luaL_optstring(L, index, "");
+  int hints = 0;
+
+  while(*str)
+  {
+    size_t len = strcspn(str, " ");
+    if(len == 8 && !strncmp(str, "populate", len))
+      hints |= TH_ALLOCATOR_MAPPED_POPULATE;
+    else if(len == 8 && !strncmp(str, "willneed", len))
+      hints |= TH_ALLOCATOR_MAPPED_WILLNEED;
+    else if(len == 10 && !strncmp(str, "sequential", len))
+      hints |= TH_ALLOCATOR_MAPPED_SEQUENTIAL;
+    else if(len == 6 && !strncmp(str, "random", len))
+      hints |= TH_ALLOCATOR_MAPPED_RANDOM;
+    else if(len > 0)
+      luaL_argerror(L, index, "populate, willneed, sequential or random expected");
+    str += len;
+    str += strspn(str, " ");
+  }
+  luaL_argcheck(L, !((hints & TH_ALLOCATOR_MAPPED_SEQUENTIAL) && (hints & TH_ALLOCATOR_MAPPED_RANDOM)),
+                index, "sequential and random hints are exclusive");
+  return hints;
+}
+
 #include "generic/Storage.c"
 #include "THGenerateAllTypes.h"
 
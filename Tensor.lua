@@ -105,6 +105,21 @@ for _,type in ipairs(types) do
    end
 end
 
+-- receives a storage sent with storage:send(socket), sharing its memory
+-- with the sender; returns nil when the sender closed the socket
+function torch.receiveStorage(socket)
+   local fd, message = torch.receivefd(socket)
+   if not fd then
+      return nil
+   end
+   local typename, size = message:match('^(torch%.%a+Storage) (%d+)$')
+   local constructor = typename and torch.getconstructortable(typename)
+   if not constructor then
+      error('invalid storage message <' .. message .. '>')
+   end
+   return constructor(tonumber(size), 'fd', fd)
+end
+
 local function Tensor__printMatrix(self, indent)
    local format,scale,sz = Storage__printformat(self:storage())
    if format:sub(2,4) == 'nan' then format = '%f' end
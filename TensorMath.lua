@@ -706,6 +706,58 @@ for _,Tensor in ipairs({"ByteTensor", "CharTensor",
          {name="index", default=lastdim(3)},
          {name="boolean", default=0}})
 
+   wrap("stableSort",
+        cname("stableSort"),
+        {{name=Tensor, default=true, returned=true},
+         {name="IndexTensor", default=true, returned=true, noreadadd=true},
+         {name=Tensor},
+         {name="index", default=lastdim(3)},
+         {name="boolean", default=0}})
+
+   wrap("sortValues",
+        cname("sortValues"),
+        {{name=Tensor, default=true, returned=true},
+         {name=Tensor},
+         {name="index", default=lastdim(2)},
+         {name="boolean", default=0}})
+
+   wrap("unique",
+        cname("unique"),
+        {{name=Tensor, default=true, returned=true},
+         {name="IndexTensor", default=true, returned=true, noreadadd=true,
+          postcall=function(arg)
+                      -- only the inverse indices, when asked for, are converted
+                      return table.concat(
+                         {
+                            string.format("if(%s)", arg.args[5]:carg()),
+                            "{",
+                            arg.__metatable.postcall(arg),
+                            "}"
+                         }, '\n')
+                   end},
+         {name="LongTensor", default=true, returned=true},
+         {name=Tensor},
+         {name="boolean", default=0},
+         {name="boolean", default=0}})
+
+   wrap("bincount_",
+        cname("bincount"),
+        {{name=Tensor, default=true, returned=true},
+         {name="IndexTensor", noreadadd=true},
+         {name="long", default=0}},
+        cname("bincountWeighted"),
+        {{name=Tensor, default=true, returned=true},
+         {name="IndexTensor", noreadadd=true},
+         {name=Tensor},
+         {name="long", default=0}})
+
+   wrap("searchsorted",
+        cname("searchsorted"),
+        {{name="IndexTensor", default=true, returned=true, noreadadd=true},
+         {name=Tensor},
+         {name=Tensor},
+         {name="boolean", default=0}})
+
 wrap("topk",
      cname("topk"),
      {{name=Tensor, default=true, returned=true},
@@ -786,13 +838,13 @@ static long THRandom_random1__(THGenerator *gen, long b)
 static void THTensor_random2__(THTensor *self, THGenerator *gen, long a, long b)
 {
   THArgCheck(b >= a, 2, "upper bound must be larger than lower bound");
-  TH_TENSOR_APPLY(real, self, *self_data = ((THRandom_random(gen) % (b+1-a)) + a);)
+  THTensor_clampedRandom(self, gen, a, b+1);
 }
 
 static void THTensor_random1__(THTensor *self, THGenerator *gen, long b)
 {
   THArgCheck(b > 0, 1, "upper bound must be strictly positive");
-  TH_TENSOR_APPLY(real, self, *self_data = (THRandom_random(gen) % b + 1);)
+  THTensor_clampedRandom(self, gen, 1, b+1);
 }
 ]], 'Tensor', Tensor):gsub('real', real))
 
@@ -987,6 +1039,17 @@ static void THTensor_random1__(THTensor *self, THGenerator *gen, long b)
          {name=real, default=1, invisible=true},
          {name=real, default=1, invisible=true},
          {name='charoption', values={'V', 'F'}, default='V'},
+         {name='charoption', default="C", invisible=true}},
+        cname("conv3Dmm"),
+        {{name=Tensor, default=true, returned=true},
+         {name=real, default=0, invisible=true},
+         {name=real, default=1, invisible=true},
+         {name=Tensor, dim=5},
+         {name=Tensor, dim=5},
+         {name=real, default=1, invisible=true},
+         {name=real, default=1, invisible=true},
+         {name=real, default=1, invisible=true},
+         {name='charoption', values={'V', 'F'}, default='V'},
          {name='charoption', default="C", invisible=true}}
      )
 
@@ -1023,6 +1086,17 @@ static void THTensor_random1__(THTensor *self, THGenerator *gen, long b)
          {name=real, default=1, invisible=true},
          {name=real, default=1, invisible=true},
          {name='charoption', values={'V', 'F'}, default='V'},
+         {name='charoption', default="X", invisible=true}},
+        cname("conv3Dmm"),
+        {{name=Tensor, default=true, returned=true},
+         {name=real, default=0, invisible=true},
+         {name=real, default=1, invisible=true},
+         {name=Tensor, dim=5},
+         {name=Tensor, dim=5},
+         {name=real, default=1, invisible=true},
+         {name=real, default=1, invisible=true},
+         {name=real, default=1, invisible=true},
+         {name='charoption', values={'V', 'F'}, default='V'},
          {name='charoption', default="X", invisible=true}}
      )
 
@@ -1289,6 +1363,20 @@ static void THTensor_random1__(THTensor *self, THGenerator *gen, long b)
               {name="IndexTensor"},
               {name=Tensor}
               })
+
+      wrap("multinomialAliasSetupBatch_",
+           cname("multinomialAliasSetupBatch"),
+           {{name=Tensor},
+              {name="IndexTensor", default=true, returned=true, method={default='nil'}},
+              {name=Tensor, default=true, returned=true, method={default='nil'}}})
+
+      wrap("multinomialAliasBatch_",
+           cname("multinomialAliasDrawBatch"),
+           {{name="IndexTensor", default=true, returned=true, method={default='nil'}},
+              {name='Generator', default=true},
+              {name="IndexTensor"},
+              {name=Tensor}
+              })
       
       for _,f in ipairs({{name='uniform', a=0, b=1},
             {name='normal', a=0, b=1},
@@ -0,0 +1,171 @@
+local TensorWriter = torch.class('torch.TensorWriter')
+
+-- On-disk layout: a fixed-size header followed by the raw contiguous data,
+-- so that a finalized file can be mapped with torch.Storage(filename, shared)
+-- and viewed as a tensor without copying anything.
+local MAGIC = 'T7TENSOR'
+local VERSION = 1
+local HEADER_SIZE = 512
+local MAX_DIMENSION = 32
+local MAX_TYPENAME = 64
+
+local function writeHeader(file, header)
+   file:seek(1)
+   file:writeString(MAGIC)
+   file:writeInt(VERSION)
+   file:writeInt(header.finalized and 1 or 0)
+   file:writeInt(header.elementSize)
+   file:writeInt(#header.size)
+   for i = 1, #header.size do
+      file:writeLong(header.size[i])
+   end
+   file:writeInt(#header.tensorType)
+   file:writeString(header.tensorType)
+end
+
+local function readHeader(file)
+   file:seek(1)
+   file:quiet()
+   local magic = file:readChar(#MAGIC):string()
+   file:pedantic()
+   if magic ~= MAGIC then
+      error('not a TensorWriter file')
+   end
+   local header = {}
+   local version = file:readInt()
+   if version ~= VERSION then
+      error(string.format('unsupported TensorWriter file version <%d>', version))
+   end
+   header.finalized = (file:readInt() == 1)
+   header.elementSize = file:readInt()
+   header.size = {}
+   for i = 1, file:readInt() do
+      header.size[i] = file:readLong()
+   end
+   header.tensorType = file:readChar(file:readInt()):string()
+   return header
+end
+
+function TensorWriter:__init(filename, tensorType, rowSize, extentSize)
+   assert(type(filename) == 'string', 'filename expected')
+   tensorType = tensorType or torch.getdefaulttensortype()
+   local typeName = tensorType:match('^torch%.(%a+)Tensor$')
+   assert(typeName and typeName ~= 'Half' and torch.getconstructortable(tensorType),
+          'invalid tensor type <' .. tostring(tensorType) .. '>')
+   assert(#tensorType <= MAX_TYPENAME, 'tensor type name is too long')
+
+   if torch.typename(rowSize) == 'torch.LongStorage' then
+      rowSize = rowSize:totable()
+   end
+   rowSize = rowSize or {}
+   assert(type(rowSize) == 'table', 'row size must be a LongStorage or a table')
+   assert(#rowSize < MAX_DIMENSION, 'too many dimensions')
+
+   self.filename = filename
+   self.tensorType = tensorType
+   self.writeMethod = 'write' .. typeName
+   self.storageType = torch.getconstructortable('torch.' .. typeName .. 'Storage')
+   self.elementSize = torch.getconstructortable(tensorType)():elementSize()
+   self.rowSize = rowSize
+   self.rowElements = 1
+   for i = 1, #rowSize do
+      self.rowElements = self.rowElements * rowSize[i]
+   end
+   self.nRows = 0
+   self.extentSize = extentSize or 64*1024*1024
+   self.reserved = 0
+
+   self.file = torch.DiskFile(filename, 'w'):binary()
+   self:_reserve(HEADER_SIZE)
+   writeHeader(self.file, self:_header(false))
+end
+
+function TensorWriter:_header(finalized)
+   local size = {self.nRows}
+   for i = 1, #self.rowSize do
+      size[i+1] = self.rowSize[i]
+   end
+   return {finalized = finalized, elementSize = self.elementSize,
+           size = size, tensorType = self.tensorType}
+end
+
+-- grow the file by whole extents, so that appending does not fragment it
+function TensorWriter:_reserve(size)
+   if size > self.reserved then
+      self.reserved = math.ceil(size/self.extentSize)*self.extentSize
+      self.file:reserve(self.reserved)
+   end
+end
+
+-- appends one row (a tensor of the row size) or several rows (a tensor with
+-- an extra leading dimension)
+function TensorWriter:append(tensor)
+   assert(self.file, 'attempt to use a closed TensorWriter')
+   assert(torch.typename(tensor) == self.tensorType,
+          string.format('%s expected, got %s', self.tensorType, torch.type(tensor)))
+
+   local nDimension = #self.rowSize
+   local nRows
+   if tensor:dim() == nDimension and nDimension > 0 then
+      nRows = 1
+   elseif tensor:dim() == nDimension + 1 then
+      nRows = tensor:size(1)
+   else
+      error('tensor does not match the row size')
+   end
+   for i = 1, nDimension do
+      assert(tensor:size(tensor:dim()-nDimension+i) == self.rowSize[i], 'tensor does not match the row size')
+   end
+   if nRows == 0 then
+      return self
+   end
+
+   tensor = tensor:contiguous()
+   local offset = HEADER_SIZE + self.nRows*self.rowElements*self.elementSize
+   local nElement = nRows*self.rowElements
+   self:_reserve(offset + nElement*self.elementSize)
+   self.file:seek(offset+1)
+   -- a storage view avoids copying the tensor data
+   self.file[self.writeMethod](self.file, self.storageType(tensor:storage(), tensor:storageOffset(), nElement))
+   self.nRows = self.nRows + nRows
+   return self
+end
+
+function TensorWriter:size()
+   return self.nRows
+end
+
+-- writes the final header and trims the file to its actual size
+function TensorWriter:close()
+   assert(self.file, 'attempt to use a closed TensorWriter')
+   self.file:truncate(HEADER_SIZE + self.nRows*self.rowElements*self.elementSize)
+   writeHeader(self.file, self:_header(true))
+   self.file:close()
+   self.file = nil
+end
+
+-- maps a file written by a TensorWriter, without copying its content
+function torch.mapTensorFile(filename, shared, hints)
+   local file = torch.DiskFile(filename, 'r'):binary()
+   local header = readHeader(file)
+   file:close()
+   if not header.finalized then
+      error(string.format('file <%s> was not closed by its TensorWriter', filename))
+   end
+
+   local tensorClass = torch.getconstructortable(header.tensorType)
+   local nElement = 1
+   local size = torch.LongStorage(header.size)
+   for i = 1, #header.size do
+      nElement = nElement * header.size[i]
+   end
+   if nElement == 0 then
+      return tensorClass()
+   end
+
+   local storageType = header.tensorType:gsub('Tensor$', 'Storage')
+   local storage = torch.getconstructortable(storageType)(filename, shared or false,
+                                                          HEADER_SIZE/header.elementSize + nElement,
+                                                          false, hints)
+   return tensorClass(storage, HEADER_SIZE/header.elementSize + 1, size)
+end
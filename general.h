@@ -16,6 +16,10 @@
 
 #endif
 
+/* storage:send() passes the storage type and size along with its file
+   descriptor, in a message of fixed size */
+#define TORCH_STORAGE_FD_MESSAGE_SIZE 64
+
 #if LUA_VERSION_NUM >= 503
 /* one can simply enable LUA_COMPAT_5_2 to be backward compatible.
 However, this does not work when we are trying to use system-installed lua,
@@ -9,9 +9,30 @@ static int torch_Storage_(new)(lua_State *L)
   int index = 1;
   THStorage *storage;
   THAllocator *allocator = luaT_toudata(L, index, "torch.Allocator");
+  THSharedPool *pool;
   if (allocator) index++;
+  pool = luaT_toudata(L, index, "torch.SharedPool");
 
-  if(lua_type(L, index) == LUA_TSTRING)
+  if(pool)
+  {
+    ptrdiff_t size = luaL_optinteger(L, index + 1, 0);
+    luaL_argcheck(L, !allocator, 1, "passing an allocator is not supported with a shared pool");
+    if(lua_isnoneornil(L, index + 2))
+      storage = THStorage_(newWithAllocator)(size, &THSharedPoolAllocator, pool);
+    else
+    {
+      /* takes over the reference returned by pool:share() */
+      long block = (long)luaL_checkinteger(L, index + 2) - 1;
+      real *data;
+      luaL_argcheck(L, size >= 0 && size*sizeof(real) <= THSharedPool_blockSize(pool), index + 1,
+                    "size exceeds the pool block size");
+      luaL_argcheck(L, block >= 0 && block < THSharedPool_nBlocks(pool), index + 2, "invalid block");
+      data = (real*)THSharedPool_data(pool, block);
+      THSharedPool_retain(pool);
+      storage = THStorage_(newWithDataAndAllocator)(data, size, &THSharedPoolAllocator, pool);
+    }
+  }
+  else if(lua_type(L, index) == LUA_TSTRING)
   {
     if (allocator)
       THError("Passing allocator not supported when using file mapping");
@@ -23,7 +44,7 @@ static int torch_Storage_(new)(lua_State *L)
     ptrdiff_t size = luaL_optinteger(L, index + 2, 0);
     if (isShared && luaT_optboolean(L, index + 3, 0))
       isShared = TH_ALLOCATOR_MAPPED_SHAREDMEM;
-    storage = THStorage_(newWithMapping)(fileName, size, isShared);
+    storage = THStorage_(newWithMapping)(fileName, size, isShared | torch_Storage_mappingHints(L, index + 4));
   }
   else if(lua_type(L, index) == LUA_TTABLE)
   {
@@ -65,6 +86,28 @@ static int torch_Storage_(new)(lua_State *L)
     storage->view = src;
     THStorage_(retain)(storage->view);
   }
+  else if(lua_type(L, index) == LUA_TNUMBER && lua_type(L, index + 1) == LUA_TSTRING)
+  {
+    ptrdiff_t size = luaL_checkinteger(L, index);
+    const char *source = lua_tostring(L, index + 1);
+    if (allocator)
+      THError("Passing allocator not supported when using file mapping");
+
+    if(!strcmp(source, "memfd"))
+    {
+      luaL_argcheck(L, size > 0, index, "memory file size must be positive");
+      storage = THStorage_(newWithMapping)(torch_Storage, size,
+                                           TH_ALLOCATOR_MAPPED_MEMFD | TH_ALLOCATOR_MAPPED_KEEPFD);
+    }
+    else if(!strcmp(source, "fd"))
+    {
+      /* the storage closes the descriptor when freed */
+      int fd = luaL_checkint(L, index + 2);
+      storage = THStorage_(newWithFd)(fd, size, TH_ALLOCATOR_MAPPED_SHARED);
+    }
+    else
+      return luaL_argerror(L, index + 1, "'memfd' or 'fd' expected");
+  }
   else if(lua_type(L, index + 1) == LUA_TNUMBER)
   {
     ptrdiff_t size = luaL_optinteger(L, index, 0);
@@ -148,6 +191,15 @@ static int torch_Storage_(fill)(lua_State *L)
   return 1;
 }
 
+static int torch_Storage_(hash)(lua_State *L)
+{
+  THStorage *storage = luaT_checkudata(L, 1, torch_Storage);
+  char hash[17];
+  snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)THStorage_(hash)(storage));
+  lua_pushstring(L, hash);
+  return 1;
+}
+
 static int torch_Storage_(elementSize)(lua_State *L)
 {
   luaT_pushinteger(L, THStorage_(elementSize)());
@@ -260,6 +312,72 @@ static int torch_Storage_(read)(lua_State *L)
   return 0;
 }
 
+/* like read, but points into the memory file storage when the data is aligned */
+static int torch_Storage_(readView)(lua_State *L)
+{
+  THStorage *storage = luaT_checkudata(L, 1, torch_Storage);
+  THFile *file = luaT_checkudata(L, 2, "torch.MemoryFile");
+  ptrdiff_t size = THFile_readLongScalar(file);
+  THCharStorage *source;
+  real *data = (real*)THMemoryFile_readView(file, size*sizeof(real), sizeof(real), &source);
+
+  if(data)
+  {
+    THStorage *view;
+    THCharStorage_retain(source);
+    view = THStorage_(newWithDataAndAllocator)(data, size, &THCharStorageViewAllocator, source);
+    THStorage_(clearFlag)(view, TH_STORAGE_RESIZABLE);
+    THStorage_(swap)(storage, view);
+    THStorage_(free)(view);
+  }
+  else
+  {
+    THStorage_(resize)(storage, size);
+    THFile_readRealRaw(file, storage->data, storage->size);
+  }
+
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int torch_Storage_(prefetch)(lua_State *L)
+{
+  THStorage *storage = luaT_checkudata(L, 1, torch_Storage);
+  ptrdiff_t offset = luaL_optinteger(L, 2, 1) - 1;
+  ptrdiff_t size = luaL_optinteger(L, 3, storage->size - offset);
+  THStorage_(prefetch)(storage, offset, size);
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int torch_Storage_(fd)(lua_State *L)
+{
+  THStorage *storage = luaT_checkudata(L, 1, torch_Storage);
+  int fd = THStorage_(fd)(storage);
+  if(fd < 0)
+    return 0;
+  lua_pushinteger(L, fd);
+  return 1;
+}
+
+/* sends the file descriptor of the storage on a Unix domain socket; see
+   torch.receiveStorage() */
+static int torch_Storage_(send)(lua_State *L)
+{
+  THStorage *storage = luaT_checkudata(L, 1, torch_Storage);
+  int socket = luaL_checkint(L, 2);
+  int fd = THStorage_(fd)(storage);
+  char message[TORCH_STORAGE_FD_MESSAGE_SIZE];
+
+  luaL_argcheck(L, fd >= 0, 1, "storage has no file descriptor");
+  memset(message, 0, sizeof(message));
+  snprintf(message, sizeof(message), "%s %ld", torch_Storage, (long)storage->size);
+  THMapAllocator_sendFd(socket, fd, message, sizeof(message));
+
+  lua_settop(L, 1);
+  return 1;
+}
+
 static const struct luaL_Reg torch_Storage_(_) [] = {
   {"retain", torch_Storage_(retain)},
   {"free", torch_Storage_(free)},
@@ -270,10 +388,15 @@ static const struct luaL_Reg torch_Storage_(_) [] = {
   {"__index__", torch_Storage_(__index__)},
   {"resize", torch_Storage_(resize)},
   {"fill", torch_Storage_(fill)},
+  {"hash", torch_Storage_(hash)},
   {"copy", torch_Storage_(copy)},
   {"totable", torch_Storage_(totable)},
   {"write", torch_Storage_(write)},
   {"read", torch_Storage_(read)},
+  {"readView", torch_Storage_(readView)},
+  {"prefetch", torch_Storage_(prefetch)},
+  {"fd", torch_Storage_(fd)},
+  {"send", torch_Storage_(send)},
 #if defined(TH_REAL_IS_CHAR) || defined(TH_REAL_IS_BYTE)
   {"string", torch_Storage_(string)},
 #endif
@@ -7,6 +7,9 @@ extern void torch_File_init(lua_State *L);
 extern void torch_DiskFile_init(lua_State *L);
 extern void torch_MemoryFile_init(lua_State *L);
 extern void torch_PipeFile_init(lua_State *L);
+extern void torch_AsyncFile_init(lua_State *L);
+extern void torch_SharedPool_init(lua_State *L);
+extern void torch_SharedQueue_init(lua_State *L);
 extern void torch_Timer_init(lua_State *L);
 
 extern void torch_ByteStorage_init(lua_State *L);
@@ -81,6 +84,9 @@ int luaopen_libtorch(lua_State *L)
   torch_DiskFile_init(L);
   torch_PipeFile_init(L);
   torch_MemoryFile_init(L);
+  torch_AsyncFile_init(L);
+  torch_SharedPool_init(L);
+  torch_SharedQueue_init(L);
 
   torch_TensorMath_init(L);
 
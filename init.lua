@@ -154,6 +154,7 @@ torch.setdefaulttensortype('torch.DoubleTensor')
 
 require('torch.Tensor')
 require('torch.File')
+require('torch.TensorWriter')
 require('torch.CmdLine')
 require('torch.FFInterface')
 require('torch.Tester')
@@ -189,17 +190,34 @@ torch.Tensor.isTensor = torch.isTensor
 torch.setheaptracking(true)
 
 function torch.multinomialAliasSetup(probs, state)
+   -- one alias table per row of a 2D probs
+   local setup = probs:dim() == 2 and torch.multinomialAliasSetupBatch_ or torch.multinomialAliasSetup_
    if torch.type(state) == 'table' then 
-      state[1], state[2] = torch.multinomialAliasSetup_(probs, state[1], state[2])
+      state[1], state[2] = setup(probs, state[1], state[2])
    else
       state = {}
-      state[1], state[2] = torch.multinomialAliasSetup_(probs)
+      state[1], state[2] = setup(probs)
    end
    return state
 end
 
+-- counts of the non-negative integers of x, or sums of their weights
+function torch.bincount(x, weights, minlength)
+   if type(weights) == 'number' then
+      weights, minlength = nil, weights
+   end
+   if weights then
+      return torch.bincount_(weights.new(), x, weights, minlength or 0)
+   end
+   return torch.bincount_(x.new(), x, minlength or 0)
+end
+
 function torch.multinomialAlias(output, state)
-   torch.DoubleTensor.multinomialAlias_(output, state[1], state[2])
+   if state[1]:dim() == 2 then
+      torch.DoubleTensor.multinomialAliasBatch_(output, state[1], state[2])
+   else
+      torch.DoubleTensor.multinomialAlias_(output, state[1], state[2])
+   end
    return output
 end
 
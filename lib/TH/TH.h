@@ -12,6 +12,7 @@
 #include "THVector.h"
 #include "THLogAdd.h"
 #include "THRandom.h"
+#include "THFFT.h"
 #include "THSize.h"
 #include "THStorage.h"
 #include "THTensor.h"
@@ -20,6 +21,9 @@
 
 #include "THFile.h"
 #include "THDiskFile.h"
+#include "THAsyncFile.h"
+#include "THSharedPool.h"
+#include "THSharedQueue.h"
 #include "THMemoryFile.h"
 
 #endif
@@ -1,3 +1,8 @@
+/* memfd_create is a GNU extension */
+#if defined(HAVE_MEMFD_CREATE) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "THAllocator.h"
 #include "THAtomic.h"
 
@@ -12,6 +17,12 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
 #endif
 /* end of stuff for mapped files */
 
@@ -38,6 +49,7 @@ THAllocator THDefaultAllocator = {
 struct THMapAllocatorContext_ {
   char *filename; /* file name */
   int flags;
+  int hints; /* TH_ALLOCATOR_MAPPED_HINTS flags */
   ptrdiff_t size; /* mapped size */
   int fd;
 };
@@ -53,7 +65,9 @@ char * unknown_filename = "filename not specified";
 THMapAllocatorContext *THMapAllocatorContext_new(const char *filename, int flags)
 {
   THMapAllocatorContext *ctx = THAlloc(sizeof(THMapAllocatorContext));
+  int hints = flags & TH_ALLOCATOR_MAPPED_HINTS;
 
+  flags &= ~TH_ALLOCATOR_MAPPED_HINTS;
   if (!(flags & TH_ALLOCATOR_MAPPED_SHARED) && !(flags & TH_ALLOCATOR_MAPPED_SHAREDMEM))
     flags &= ~TH_ALLOCATOR_MAPPED_NOCREATE;
   if ((flags ^ TH_ALLOCATOR_MAPPED_EXCLUSIVE) == 0)
@@ -67,6 +81,7 @@ THMapAllocatorContext *THMapAllocatorContext_new(const char *filename, int flags
     ctx->filename = unknown_filename;
   }
   ctx->flags = flags;
+  ctx->hints = hints;
   ctx->size = 0;
   ctx->fd = -1;
 
@@ -122,6 +137,8 @@ static void *_map_alloc(void* ctx_, ptrdiff_t size)
       THError("TH_ALLOCATOR_MAPPED_KEEPFD not supported on Windows");
     if (ctx->flags & TH_ALLOCATOR_MAPPED_FROMFD)
       THError("TH_ALLOCATOR_MAPPED_FROMFD not supported on Windows");
+    if (ctx->flags & TH_ALLOCATOR_MAPPED_MEMFD)
+      THError("TH_ALLOCATOR_MAPPED_MEMFD not supported on Windows");
 
     /* open file */
     /* FILE_FLAG_RANDOM_ACCESS ? */
@@ -201,6 +218,8 @@ static void *_map_alloc(void* ctx_, ptrdiff_t size)
     /* open file */
     int fd;
     int flags;
+    int mapFlags = 0;
+    int hints = ctx->hints;
     struct stat file_stat;
 
     if (ctx->flags & (TH_ALLOCATOR_MAPPED_SHARED | TH_ALLOCATOR_MAPPED_SHAREDMEM))
@@ -213,7 +232,16 @@ static void *_map_alloc(void* ctx_, ptrdiff_t size)
     if (ctx->flags & TH_ALLOCATOR_MAPPED_NOCREATE)
       flags &= ~O_CREAT;
 
-    if (!(ctx->flags & TH_ALLOCATOR_MAPPED_FROMFD)) {
+    if (ctx->flags & TH_ALLOCATOR_MAPPED_FROMFD) {
+      fd = ctx->fd;
+    } else if (ctx->flags & TH_ALLOCATOR_MAPPED_MEMFD) {
+#ifdef HAVE_MEMFD_CREATE
+      if((fd = memfd_create(ctx->filename, MFD_CLOEXEC)) == -1)
+        THError("unable to create memory file <%s>", ctx->filename);
+#else
+      THError("unable to create memory file <%s>, memfd_create unavailable on this platform", ctx->filename);
+#endif
+    } else {
       if(ctx->flags & TH_ALLOCATOR_MAPPED_SHARED)
       {
         if((fd = open(ctx->filename, flags, (mode_t)0600)) == -1)
@@ -233,8 +261,6 @@ static void *_map_alloc(void* ctx_, ptrdiff_t size)
         if((fd = open(ctx->filename, O_RDONLY)) == -1)
           THError("unable to open file <%s> in read-only mode", ctx->filename);
       }
-    } else {
-      fd = ctx->fd;
     }
 
     if(fstat(fd, &file_stat) == -1)
@@ -281,10 +307,17 @@ static void *_map_alloc(void* ctx_, ptrdiff_t size)
     ctx->size = size; /* if we are here, it must be the right size */
 
     /* map it */
-    if (ctx->flags & (TH_ALLOCATOR_MAPPED_SHARED | TH_ALLOCATOR_MAPPED_SHAREDMEM))
-      data = mmap(NULL, ctx->size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+#ifdef MAP_POPULATE
+    if (hints & TH_ALLOCATOR_MAPPED_POPULATE)
+      mapFlags |= MAP_POPULATE;
+#else
+    if (hints & TH_ALLOCATOR_MAPPED_POPULATE)
+      hints |= TH_ALLOCATOR_MAPPED_WILLNEED;
+#endif
+    if (ctx->flags & (TH_ALLOCATOR_MAPPED_SHARED | TH_ALLOCATOR_MAPPED_SHAREDMEM | TH_ALLOCATOR_MAPPED_MEMFD))
+      data = mmap(NULL, ctx->size, PROT_READ|PROT_WRITE, MAP_SHARED | mapFlags, fd, 0);
     else
-      data = mmap(NULL, ctx->size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+      data = mmap(NULL, ctx->size, PROT_READ|PROT_WRITE, MAP_PRIVATE | mapFlags, fd, 0);
 
     if (ctx->flags & TH_ALLOCATOR_MAPPED_KEEPFD) {
       ctx->fd = fd;
@@ -316,6 +349,10 @@ static void *_map_alloc(void* ctx_, ptrdiff_t size)
       data = NULL; /* let's be sure it is NULL */
       THError("$ Torch: unable to mmap memory: you tried to mmap %dGB.", ctx->size/1073741824);
     }
+
+    /* the access pattern applies before WILLNEED starts reading ahead */
+    THMapAllocator_advise(data, ctx->size, hints & (TH_ALLOCATOR_MAPPED_SEQUENTIAL | TH_ALLOCATOR_MAPPED_RANDOM));
+    THMapAllocator_advise(data, ctx->size, hints & TH_ALLOCATOR_MAPPED_WILLNEED);
   }
 #endif
 
@@ -401,6 +438,8 @@ static void * THRefcountedMapAllocator_alloc(void *_ctx, ptrdiff_t size) {
     THError("THRefcountedMapAllocator doesn't support TH_ALLOCATOR_MAPPED_KEEPFD flag");
   if (ctx->flags & TH_ALLOCATOR_MAPPED_UNLINK)
     THError("THRefcountedMapAllocator doesn't support TH_ALLOCATOR_MAPPED_UNLINK flag");
+  if (ctx->flags & TH_ALLOCATOR_MAPPED_MEMFD)
+    THError("THRefcountedMapAllocator doesn't support TH_ALLOCATOR_MAPPED_MEMFD flag");
   if (!(ctx->flags & TH_ALLOCATOR_MAPPED_SHAREDMEM))
     THError("THRefcountedMapAllocator requires TH_ALLOCATOR_MAPPED_SHAREDMEM flag");
 
@@ -487,6 +526,172 @@ int THRefcountedMapAllocator_decref(THMapAllocatorContext *ctx, void *data)
 
 #endif
 
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+
+void THMapAllocator_advise(void *data, ptrdiff_t size, int hints)
+{
+  long pageSize = sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t)data / pageSize * pageSize;
+  size_t length = (uintptr_t)data + size - start;
+
+  if (size <= 0)
+    return;
+  /* hints are only advisory: failures are ignored */
+#ifdef MADV_SEQUENTIAL
+  if (hints & TH_ALLOCATOR_MAPPED_SEQUENTIAL)
+    madvise((void*)start, length, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_RANDOM
+  if (hints & TH_ALLOCATOR_MAPPED_RANDOM)
+    madvise((void*)start, length, MADV_RANDOM);
+#endif
+#ifdef MADV_WILLNEED
+  if (hints & TH_ALLOCATOR_MAPPED_WILLNEED)
+    madvise((void*)start, length, MADV_WILLNEED);
+#endif
+}
+
+#else
+
+/* no hints on Windows */
+void THMapAllocator_advise(void *data, ptrdiff_t size, int hints)
+{
+}
+
+#endif
+
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+
+void THMapAllocator_sendFd(int socket, int fd, const void *message, size_t size)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union {
+    struct cmsghdr align;
+    char buffer[CMSG_SPACE(sizeof(int))];
+  } control;
+  ssize_t nSent;
+
+  THArgCheck(size > 0, 4, "message cannot be empty");
+  memset(&msg, 0, sizeof(msg));
+  memset(&control, 0, sizeof(control));
+  iov.iov_base = (void*)message;
+  iov.iov_len = size;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buffer;
+  msg.msg_controllen = sizeof(control.buffer);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  /* the descriptor goes with the first byte, the rest of a stream can follow */
+  while((nSent = sendmsg(socket, &msg, 0)) == -1 && errno == EINTR);
+  if(nSent == -1)
+    THError("unable to send file descriptor %d on socket %d", fd, socket);
+  while((size_t)nSent < size)
+  {
+    ssize_t n = send(socket, (const char*)message + nSent, size - nSent, 0);
+    if(n == -1 && errno == EINTR)
+      continue;
+    if(n <= 0)
+      THError("unable to send file descriptor %d on socket %d", fd, socket);
+    nSent += n;
+  }
+}
+
+int THMapAllocator_receiveFd(int socket, void *message, size_t size)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  /* room for a few descriptors, so that unexpected ones are received (and
+     closed) rather than truncating the message */
+  union {
+    struct cmsghdr align;
+    char buffer[CMSG_SPACE(8*sizeof(int))];
+  } control;
+  ssize_t nReceived;
+  int flags = 0;
+  int fd = -1;
+
+  THArgCheck(size > 0, 3, "message cannot be empty");
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = message;
+  iov.iov_len = size;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buffer;
+  msg.msg_controllen = sizeof(control.buffer);
+#ifdef MSG_CMSG_CLOEXEC
+  flags = MSG_CMSG_CLOEXEC;
+#endif
+
+  while((nReceived = recvmsg(socket, &msg, flags)) == -1 && errno == EINTR);
+  if(nReceived == 0)
+    return -1;
+  if(nReceived == -1)
+    THError("unable to receive a file descriptor on socket %d", socket);
+
+  /* keeps the first descriptor, and closes any other one the sender added */
+  for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    {
+      size_t nFds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      size_t i;
+      for(i = 0; i < nFds; i++)
+      {
+        int received;
+        memcpy(&received, CMSG_DATA(cmsg) + i*sizeof(int), sizeof(int));
+        if(fd == -1)
+          fd = received;
+        else
+          close(received);
+      }
+    }
+  }
+  if(fd == -1)
+    THError("no file descriptor received on socket %d", socket);
+  if(msg.msg_flags & MSG_CTRUNC)
+  {
+    close(fd);
+    THError("truncated file descriptor message on socket %d", socket);
+  }
+
+  while((size_t)nReceived < size)
+  {
+    ssize_t n = recv(socket, (char*)message + nReceived, size - nReceived, 0);
+    if(n == -1 && errno == EINTR)
+      continue;
+    if(n <= 0)
+    {
+      close(fd);
+      THError("incomplete file descriptor message on socket %d", socket);
+    }
+    nReceived += n;
+  }
+  return fd;
+}
+
+#else
+
+void THMapAllocator_sendFd(int socket, int fd, const void *message, size_t size)
+{
+  THError("file descriptor passing not supported on your system");
+}
+
+int THMapAllocator_receiveFd(int socket, void *message, size_t size)
+{
+  THError("file descriptor passing not supported on your system");
+  return -1;
+}
+
+#endif
+
 THAllocator THMapAllocator = {
   &THMapAllocator_alloc,
   &THMapAllocator_realloc,
@@ -10,6 +10,16 @@
 #define TH_ALLOCATOR_MAPPED_KEEPFD 16
 #define TH_ALLOCATOR_MAPPED_FROMFD 32
 #define TH_ALLOCATOR_MAPPED_UNLINK 64
+/* anonymous memory file (memfd_create), the file name is only a label */
+#define TH_ALLOCATOR_MAPPED_MEMFD 128
+/* access hints for the mapping: fault all pages in at creation (falls back
+   to WILLNEED), start reading ahead, expect sequential or random accesses */
+#define TH_ALLOCATOR_MAPPED_POPULATE 256
+#define TH_ALLOCATOR_MAPPED_WILLNEED 512
+#define TH_ALLOCATOR_MAPPED_SEQUENTIAL 1024
+#define TH_ALLOCATOR_MAPPED_RANDOM 2048
+#define TH_ALLOCATOR_MAPPED_HINTS (TH_ALLOCATOR_MAPPED_POPULATE | TH_ALLOCATOR_MAPPED_WILLNEED | \
+                                   TH_ALLOCATOR_MAPPED_SEQUENTIAL | TH_ALLOCATOR_MAPPED_RANDOM)
 
 /* Custom allocator
  */
@@ -37,6 +47,17 @@ TH_API void THMapAllocatorContext_free(THMapAllocatorContext *ctx);
 TH_API void THRefcountedMapAllocator_incref(THMapAllocatorContext *ctx, void *data);
 TH_API int THRefcountedMapAllocator_decref(THMapAllocatorContext *ctx, void *data);
 
+/* applies WILLNEED, SEQUENTIAL or RANDOM hints to the pages spanning
+   [data, data+size) of a mapping; WILLNEED returns immediately, the pages
+   being read ahead in the background */
+TH_API void THMapAllocator_advise(void *data, ptrdiff_t size, int hints);
+
+/* pass a file descriptor over a Unix domain socket (SCM_RIGHTS), along with
+   a message of the given size; receiveFd returns -1 when the peer closed
+   the socket */
+TH_API void THMapAllocator_sendFd(int socket, int fd, const void *message, size_t size);
+TH_API int THMapAllocator_receiveFd(int socket, void *message, size_t size);
+
 extern THAllocator THMapAllocator;
 extern THAllocator THRefcountedMapAllocator;
 
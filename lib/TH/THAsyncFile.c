@@ -0,0 +1,506 @@
+#include "THGeneral.h"
+#include "THAsyncFile.h"
+#include "THFilePrivate.h"
+
+#ifndef _WIN32
+
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+typedef struct THAsyncFileBuffer__
+{
+    char *data;
+    size_t size;    /* number of valid bytes */
+    int hasError;
+
+} THAsyncFileBuffer;
+
+typedef struct THAsyncFile__
+{
+    THFile file;
+
+    int fd;
+    char *name;
+
+    size_t bufferSize;
+    int nBuffers;
+    THAsyncFileBuffer *buffers;
+
+    /* consumer side */
+    int head;          /* buffer being consumed */
+    size_t headPos;    /* read position inside the head buffer */
+    size_t position;   /* logical file position */
+
+    /* shared with the prefetching thread, protected by mutex */
+    int nFilled;       /* number of filled buffers, starting at head */
+    size_t readOffset; /* file offset of the next prefetch */
+    int reachedEnd;    /* the thread hit the end of file */
+    int generation;    /* bumped on seek, invalidates in-flight reads */
+    int stop;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+
+} THAsyncFile;
+
+static ssize_t THAsyncFile_pread(int fd, char *data, size_t n, size_t offset)
+{
+  size_t total = 0;
+  while(total < n)
+  {
+    ssize_t r = pread(fd, data+total, n-total, (off_t)(offset+total));
+    if(r < 0)
+    {
+      if(errno == EINTR)
+        continue;
+      return -1;
+    }
+    if(r == 0)
+      break;
+    total += r;
+  }
+  return total;
+}
+
+static void *THAsyncFile_prefetch(void *arg)
+{
+  THAsyncFile *afself = (THAsyncFile*)arg;
+
+  pthread_mutex_lock(&afself->mutex);
+  for(;;)
+  {
+    int slot, generation;
+    size_t offset;
+    ssize_t nread;
+
+    while(!afself->stop && (afself->nFilled == afself->nBuffers || afself->reachedEnd))
+      pthread_cond_wait(&afself->notFull, &afself->mutex);
+    if(afself->stop)
+      break;
+
+    slot = (afself->head + afself->nFilled) % afself->nBuffers;
+    generation = afself->generation;
+    offset = afself->readOffset;
+    pthread_mutex_unlock(&afself->mutex);
+
+    /* the consumer never looks at a slot which is not filled yet */
+    nread = THAsyncFile_pread(afself->fd, afself->buffers[slot].data, afself->bufferSize, offset);
+
+    pthread_mutex_lock(&afself->mutex);
+    if(generation != afself->generation) /* a seek happened meanwhile */
+      continue;
+
+    afself->buffers[slot].hasError = (nread < 0);
+    afself->buffers[slot].size = (nread < 0 ? 0 : (size_t)nread);
+    afself->readOffset += afself->buffers[slot].size;
+    if(afself->buffers[slot].size < afself->bufferSize)
+      afself->reachedEnd = 1;
+    afself->nFilled++;
+    pthread_cond_signal(&afself->notEmpty);
+  }
+  pthread_mutex_unlock(&afself->mutex);
+
+  return NULL;
+}
+
+/* Waits for the head buffer and returns the number of bytes available in it
+   (0 means end of file). */
+static size_t THAsyncFile_acquire(THAsyncFile *afself, char **data)
+{
+  THAsyncFileBuffer *buffer;
+
+  pthread_mutex_lock(&afself->mutex);
+  while(afself->nFilled == 0)
+    pthread_cond_wait(&afself->notEmpty, &afself->mutex);
+  pthread_mutex_unlock(&afself->mutex);
+
+  buffer = &afself->buffers[afself->head];
+  if(buffer->hasError)
+  {
+    *data = NULL;
+    return 0;
+  }
+  *data = buffer->data + afself->headPos;
+  return buffer->size - afself->headPos;
+}
+
+static void THAsyncFile_consume(THAsyncFile *afself, size_t n)
+{
+  THAsyncFileBuffer *buffer = &afself->buffers[afself->head];
+
+  afself->headPos += n;
+  afself->position += n;
+
+  /* a short buffer marks the end of file: we keep it around */
+  if(afself->headPos == buffer->size && buffer->size == afself->bufferSize)
+  {
+    pthread_mutex_lock(&afself->mutex);
+    afself->head = (afself->head + 1) % afself->nBuffers;
+    afself->headPos = 0;
+    afself->nFilled--;
+    pthread_cond_signal(&afself->notFull);
+    pthread_mutex_unlock(&afself->mutex);
+  }
+}
+
+static size_t THAsyncFile_readBytes(THAsyncFile *afself, char *data, size_t n)
+{
+  size_t nread = 0;
+
+  while(nread < n)
+  {
+    char *src;
+    size_t avail = THAsyncFile_acquire(afself, &src);
+    size_t ncopy;
+
+    if(avail == 0)
+    {
+      if(!src)
+      {
+        afself->file.hasError = 1;
+        if(!afself->file.isQuiet)
+          THError("read error: unable to read file <%s>", afself->name);
+      }
+      break;
+    }
+
+    ncopy = THMin(avail, n-nread);
+    memcpy(data+nread, src, ncopy);
+    nread += ncopy;
+    THAsyncFile_consume(afself, ncopy);
+  }
+
+  return nread;
+}
+
+static int THAsyncFile_isOpened(THFile *self)
+{
+  THAsyncFile *afself = (THAsyncFile*)self;
+  return (afself->fd >= 0);
+}
+
+const char *THAsyncFile_name(THFile *self)
+{
+  THAsyncFile *afself = (THAsyncFile*)self;
+  return afself->name;
+}
+
+#define READ_WRITE_METHODS(TYPE, TYPEC)                                 \
+  static size_t THAsyncFile_read##TYPEC(THFile *self, TYPE *data, size_t n) \
+  {                                                                     \
+    THAsyncFile *afself = (THAsyncFile*)(self);                         \
+    size_t nread;                                                       \
+                                                                        \
+    THArgCheck(afself->fd >= 0, 1, "attempt to use a closed file");    \
+    THArgCheck(afself->file.isBinary, 1, "AsyncFile only supports binary mode"); \
+                                                                        \
+    nread = THAsyncFile_readBytes(afself, (char*)data, sizeof(TYPE)*n)/sizeof(TYPE); \
+                                                                        \
+    if(nread != n)                                                      \
+    {                                                                   \
+      afself->file.hasError = 1;                                        \
+      if(!afself->file.isQuiet)                                         \
+        THError("read error: read %d blocks instead of %d", nread, n);  \
+    }                                                                   \
+                                                                        \
+    return nread;                                                       \
+  }                                                                     \
+                                                                        \
+  static size_t THAsyncFile_write##TYPEC(THFile *self, TYPE *data, size_t n) \
+  {                                                                     \
+    THArgCheck(0, 1, "attempt to write in a read-only file");          \
+    return 0;                                                           \
+  }
+
+READ_WRITE_METHODS(unsigned char, Byte)
+READ_WRITE_METHODS(char, Char)
+READ_WRITE_METHODS(short, Short)
+READ_WRITE_METHODS(int, Int)
+READ_WRITE_METHODS(long, Long)
+READ_WRITE_METHODS(float, Float)
+READ_WRITE_METHODS(double, Double)
+READ_WRITE_METHODS(THHalf, Half)
+
+static size_t THAsyncFile_readString(THFile *self, const char *format, char **str_)
+{
+  THAsyncFile *afself = (THAsyncFile*)(self);
+  size_t total = 1024;
+  size_t pos = 0;
+  char *p;
+
+  THArgCheck(afself->fd >= 0, 1, "attempt to use a closed file");
+  THArgCheck((strlen(format) >= 2 ? (format[0] == '*') && (format[1] == 'a' || format[1] == 'l') : 0), 2, "format must be '*a' or '*l'");
+
+  p = THAlloc(total);
+  for(;;)
+  {
+    char *src;
+    size_t avail = THAsyncFile_acquire(afself, &src);
+    size_t ncopy = avail;
+    char *eol = NULL;
+
+    if(avail == 0) /* eof? */
+      break;
+
+    if(format[1] == 'l' && (eol = memchr(src, '\n', avail)))
+      ncopy = eol-src;
+
+    if(pos+ncopy > total)
+    {
+      total = THMax(pos+ncopy, total + total/2);
+      p = THRealloc(p, total);
+    }
+    memcpy(p+pos, src, ncopy);
+    pos += ncopy;
+
+    if(eol)
+    {
+      THAsyncFile_consume(afself, ncopy+1); /* do not include `eol' */
+      *str_ = p;
+      return pos;
+    }
+    THAsyncFile_consume(afself, ncopy);
+  }
+
+  if(pos == 0)
+  {
+    THFree(p);
+    afself->file.hasError = 1;
+    if(!afself->file.isQuiet)
+      THError("read error: read 0 blocks instead of 1");
+
+    *str_ = NULL;
+    return 0;
+  }
+
+  *str_ = p;
+  return pos;
+}
+
+static size_t THAsyncFile_writeString(THFile *self, const char *str, size_t size)
+{
+  THArgCheck(0, 1, "attempt to write in a read-only file");
+  return 0;
+}
+
+static void THAsyncFile_synchronize(THFile *self)
+{
+  THAsyncFile *afself = (THAsyncFile*)(self);
+  THArgCheck(afself->fd >= 0, 1, "attempt to use a closed file");
+}
+
+static void THAsyncFile_seek(THFile *self, size_t position)
+{
+  THAsyncFile *afself = (THAsyncFile*)(self);
+  THAsyncFileBuffer *buffer;
+
+  THArgCheck(afself->fd >= 0, 1, "attempt to use a closed file");
+
+  pthread_mutex_lock(&afself->mutex);
+
+  /* cheap case: the position is inside the head buffer */
+  buffer = &afself->buffers[afself->head];
+  if(afself->nFilled > 0 && !buffer->hasError &&
+     position + afself->headPos >= afself->position &&
+     (position + afself->headPos < afself->position + buffer->size ||
+      (position + afself->headPos == afself->position + buffer->size && buffer->size < afself->bufferSize)))
+  {
+    afself->headPos = position + afself->headPos - afself->position;
+    afself->position = position;
+    pthread_mutex_unlock(&afself->mutex);
+    return;
+  }
+
+  afself->generation++;
+  afself->nFilled = 0;
+  afself->headPos = 0;
+  afself->readOffset = position;
+  afself->reachedEnd = 0;
+  afself->position = position;
+  pthread_cond_signal(&afself->notFull);
+  pthread_mutex_unlock(&afself->mutex);
+}
+
+static void THAsyncFile_seekEnd(THFile *self)
+{
+  THAsyncFile *afself = (THAsyncFile*)(self);
+  struct stat file_stat;
+
+  THArgCheck(afself->fd >= 0, 1, "attempt to use a closed file");
+
+  if(fstat(afself->fd, &file_stat) == -1)
+  {
+    afself->file.hasError = 1;
+    if(!afself->file.isQuiet)
+      THError("unable to seek at end of file");
+    return;
+  }
+  THAsyncFile_seek(self, (size_t)file_stat.st_size);
+}
+
+static size_t THAsyncFile_position(THFile *self)
+{
+  THAsyncFile *afself = (THAsyncFile*)(self);
+  THArgCheck(afself->fd >= 0, 1, "attempt to use a closed file");
+  return afself->position;
+}
+
+static void THAsyncFile_stop(THAsyncFile *afself)
+{
+  pthread_mutex_lock(&afself->mutex);
+  afself->stop = 1;
+  pthread_cond_signal(&afself->notFull);
+  pthread_mutex_unlock(&afself->mutex);
+  pthread_join(afself->thread, NULL);
+
+  close(afself->fd);
+  afself->fd = -1;
+}
+
+static void THAsyncFile_close(THFile *self)
+{
+  THAsyncFile *afself = (THAsyncFile*)(self);
+  THArgCheck(afself->fd >= 0, 1, "attempt to use a closed file");
+  THAsyncFile_stop(afself);
+}
+
+static void THAsyncFile_free(THFile *self)
+{
+  THAsyncFile *afself = (THAsyncFile*)(self);
+  int i;
+
+  if(afself->fd >= 0)
+    THAsyncFile_stop(afself);
+
+  pthread_mutex_destroy(&afself->mutex);
+  pthread_cond_destroy(&afself->notEmpty);
+  pthread_cond_destroy(&afself->notFull);
+
+  for(i = 0; i < afself->nBuffers; i++)
+    THFree(afself->buffers[i].data);
+  THFree(afself->buffers);
+  THFree(afself->name);
+  THFree(afself);
+}
+
+THFile *THAsyncFile_new(const char *name, size_t bufferSize, int nBuffers, int isQuiet)
+{
+  static struct THFileVTable vtable = {
+    THAsyncFile_isOpened,
+
+    THAsyncFile_readByte,
+    THAsyncFile_readChar,
+    THAsyncFile_readShort,
+    THAsyncFile_readInt,
+    THAsyncFile_readLong,
+    THAsyncFile_readFloat,
+    THAsyncFile_readDouble,
+    THAsyncFile_readHalf,
+    THAsyncFile_readString,
+
+    THAsyncFile_writeByte,
+    THAsyncFile_writeChar,
+    THAsyncFile_writeShort,
+    THAsyncFile_writeInt,
+    THAsyncFile_writeLong,
+    THAsyncFile_writeFloat,
+    THAsyncFile_writeDouble,
+    THAsyncFile_writeHalf,
+    THAsyncFile_writeString,
+
+    THAsyncFile_synchronize,
+    THAsyncFile_seek,
+    THAsyncFile_seekEnd,
+    THAsyncFile_position,
+    THAsyncFile_close,
+    THAsyncFile_free
+  };
+
+  THAsyncFile *self;
+  int fd;
+  int i;
+
+  THArgCheck(bufferSize > 0, 2, "buffer size must be positive");
+  THArgCheck(nBuffers >= 2, 3, "at least two buffers are required");
+
+  fd = open(name, O_RDONLY);
+  if(fd < 0)
+  {
+    if(isQuiet)
+      return 0;
+    else
+      THError("cannot open <%s> in mode r ", name);
+  }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  self = THAlloc(sizeof(THAsyncFile));
+
+  self->fd = fd;
+  self->name = THAlloc(strlen(name)+1);
+  strcpy(self->name, name);
+
+  self->bufferSize = bufferSize;
+  self->nBuffers = nBuffers;
+  self->buffers = THAlloc(sizeof(THAsyncFileBuffer)*nBuffers);
+  for(i = 0; i < nBuffers; i++)
+  {
+    self->buffers[i].data = THAlloc(bufferSize);
+    self->buffers[i].size = 0;
+    self->buffers[i].hasError = 0;
+  }
+
+  self->head = 0;
+  self->headPos = 0;
+  self->position = 0;
+  self->nFilled = 0;
+  self->readOffset = 0;
+  self->reachedEnd = 0;
+  self->generation = 0;
+  self->stop = 0;
+
+  self->file.vtable = &vtable;
+  self->file.isQuiet = isQuiet;
+  self->file.isReadable = 1;
+  self->file.isWritable = 0;
+  self->file.isBinary = 1;
+  self->file.isAutoSpacing = 0;
+  self->file.hasError = 0;
+
+  pthread_mutex_init(&self->mutex, NULL);
+  pthread_cond_init(&self->notEmpty, NULL);
+  pthread_cond_init(&self->notFull, NULL);
+  if(pthread_create(&self->thread, NULL, THAsyncFile_prefetch, self) != 0)
+  {
+    close(fd);
+    self->fd = -1;
+    THAsyncFile_free((THFile*)self);
+    THError("unable to start the prefetching thread for <%s>", name);
+  }
+
+  return (THFile*)self;
+}
+
+#else
+
+THFile *THAsyncFile_new(const char *name, size_t bufferSize, int nBuffers, int isQuiet)
+{
+  THError("AsyncFile is not supported on Windows");
+  return NULL;
+}
+
+const char *THAsyncFile_name(THFile *self)
+{
+  THError("AsyncFile is not supported on Windows");
+  return NULL;
+}
+
+#endif
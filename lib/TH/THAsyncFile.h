@@ -0,0 +1,12 @@
+#ifndef TH_ASYNC_FILE_INC
+#define TH_ASYNC_FILE_INC
+
+#include "THFile.h"
+
+/* Read-only binary file whose content is prefetched by a background thread
+   into a ring of nBuffers buffers of bufferSize bytes each. */
+TH_API THFile *THAsyncFile_new(const char *name, size_t bufferSize, int nBuffers, int isQuiet);
+
+TH_API const char *THAsyncFile_name(THFile *self);
+
+#endif
@@ -3,6 +3,14 @@
 #include "THFilePrivate.h"
 
 #include <stdint.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
 #ifndef LLONG_MAX
 #define LLONG_MAX 9223372036854775807LL
 #endif
@@ -320,6 +328,49 @@ void THDiskFile_noBuffer(THFile *self)
   }
 }
 
+void THDiskFile_reserve(THFile *self, size_t size)
+{
+  THDiskFile *dfself = (THDiskFile*)(self);
+  THArgCheck(dfself->handle != NULL, 1, "attempt to use a closed file");
+  THArgCheck(dfself->file.isWritable, 1, "attempt to write in a read-only file");
+
+  fflush(dfself->handle);
+#if defined(_WIN32)
+  if(_filelengthi64(_fileno(dfself->handle)) < (__int64)size &&
+     _chsize_s(_fileno(dfself->handle), (__int64)size) != 0)
+#elif defined(HAVE_POSIX_FALLOCATE)
+  if(posix_fallocate(fileno(dfself->handle), 0, (off_t)size) != 0)
+#else
+  struct stat file_stat;
+  if(fstat(fileno(dfself->handle), &file_stat) == -1 ||
+     (file_stat.st_size < (off_t)size && ftruncate(fileno(dfself->handle), (off_t)size) == -1))
+#endif
+  {
+    dfself->file.hasError = 1;
+    if(!dfself->file.isQuiet)
+      THError("unable to reserve %zu bytes for file <%s>", size, dfself->name);
+  }
+}
+
+void THDiskFile_truncate(THFile *self, size_t size)
+{
+  THDiskFile *dfself = (THDiskFile*)(self);
+  THArgCheck(dfself->handle != NULL, 1, "attempt to use a closed file");
+  THArgCheck(dfself->file.isWritable, 1, "attempt to write in a read-only file");
+
+  fflush(dfself->handle);
+#if defined(_WIN32)
+  if(_chsize_s(_fileno(dfself->handle), (__int64)size) != 0)
+#else
+  if(ftruncate(fileno(dfself->handle), (off_t)size) == -1)
+#endif
+  {
+    dfself->file.hasError = 1;
+    if(!dfself->file.isQuiet)
+      THError("unable to truncate file <%s> to %zu bytes", dfself->name, size);
+  }
+}
+
 static void THDiskFile_free(THFile *self)
 {
   THDiskFile *dfself = (THDiskFile*)(self);
@@ -609,7 +660,7 @@ static size_t THDiskFile_writeString(THFile *self, const char *str, size_t size)
   return nwrite;
 }
 
-THFile *THDiskFile_new(const char *name, const char *mode, int isQuiet)
+static THFile *THDiskFile_newWithHandle(FILE *handle, const char *name, int isReadable, int isWritable, int isQuiet)
 {
   static struct THFileVTable vtable = {
     THDiskFile_isOpened,
@@ -642,10 +693,30 @@ THFile *THDiskFile_new(const char *name, const char *mode, int isQuiet)
     THDiskFile_free
   };
 
+  THDiskFile *self = THAlloc(sizeof(THDiskFile));
+
+  self->handle = handle;
+  self->name = THAlloc(strlen(name)+1);
+  strcpy(self->name, name);
+  self->isNativeEncoding = 1;
+  self->longSize = 0;
+
+  self->file.vtable = &vtable;
+  self->file.isQuiet = isQuiet;
+  self->file.isReadable = isReadable;
+  self->file.isWritable = isWritable;
+  self->file.isBinary = 0;
+  self->file.isAutoSpacing = 1;
+  self->file.hasError = 0;
+
+  return (THFile*)self;
+}
+
+THFile *THDiskFile_new(const char *name, const char *mode, int isQuiet)
+{
   int isReadable;
   int isWritable;
   FILE *handle;
-  THDiskFile *self;
 
   THArgCheck(THDiskFile_mode(mode, &isReadable, &isWritable), 2, "file mode should be 'r','w' or 'rw'");
 
@@ -673,23 +744,34 @@ THFile *THDiskFile_new(const char *name, const char *mode, int isQuiet)
       THError("cannot open <%s> in mode %c%c", name, (isReadable ? 'r' : ' '), (isWritable ? 'w' : ' '));
   }
 
-  self = THAlloc(sizeof(THDiskFile));
+  return THDiskFile_newWithHandle(handle, name, isReadable, isWritable, isQuiet);
+}
 
-  self->handle = handle;
-  self->name = THAlloc(strlen(name)+1);
-  strcpy(self->name, name);
-  self->isNativeEncoding = 1;
-  self->longSize = 0;
+THFile *THDiskFile_newWithFd(int fd, const char *mode, int isQuiet)
+{
+  int isReadable;
+  int isWritable;
+  FILE *handle;
+  char name[32];
 
-  self->file.vtable = &vtable;
-  self->file.isQuiet = isQuiet;
-  self->file.isReadable = isReadable;
-  self->file.isWritable = isWritable;
-  self->file.isBinary = 0;
-  self->file.isAutoSpacing = 1;
-  self->file.hasError = 0;
+  THArgCheck(THDiskFile_mode(mode, &isReadable, &isWritable), 2, "file mode should be 'r','w' or 'rw'");
 
-  return (THFile*)self;
+#ifdef _WIN32
+  handle = _fdopen(fd, (isReadable && isWritable ? "r+b" : (isReadable ? "rb" : "wb")));
+#else
+  handle = fdopen(fd, (isReadable && isWritable ? "r+b" : (isReadable ? "rb" : "wb")));
+#endif
+
+  if(!handle)
+  {
+    if(isQuiet)
+      return 0;
+    else
+      THError("cannot open file descriptor %d in mode %c%c", fd, (isReadable ? 'r' : ' '), (isWritable ? 'w' : ' '));
+  }
+
+  snprintf(name, sizeof(name), "<fd %d>", fd);
+  return THDiskFile_newWithHandle(handle, name, isReadable, isWritable, isQuiet);
 }
 
 /* PipeFile */
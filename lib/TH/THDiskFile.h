@@ -5,6 +5,8 @@
 
 TH_API THFile *THDiskFile_new(const char *name, const char *mode, int isQuiet);
 TH_API THFile *THPipeFile_new(const char *name, const char *mode, int isQuiet);
+/* the file owns fd, which is closed with it */
+TH_API THFile *THDiskFile_newWithFd(int fd, const char *mode, int isQuiet);
 
 TH_API const char *THDiskFile_name(THFile *self);
 
@@ -15,5 +17,7 @@ TH_API void THDiskFile_littleEndianEncoding(THFile *self);
 TH_API void THDiskFile_bigEndianEncoding(THFile *self);
 TH_API void THDiskFile_longSize(THFile *self, int size);
 TH_API void THDiskFile_noBuffer(THFile *self);
+TH_API void THDiskFile_reserve(THFile *self, size_t size);
+TH_API void THDiskFile_truncate(THFile *self, size_t size);
 
 #endif
@@ -0,0 +1,338 @@
+#include "THFFT.h"
+
+#include <math.h>
+
+#define TH_FFT_MAX_FACTORS 64
+#define TH_FFT_CACHE_SIZE 8
+
+/* Stockham autosort FFT: each stage of radix r splits the sequences of the
+   current length in r, without a final bit reversal. Stage s holds the
+   twiddles w^k, for w = exp(-2i pi p/len) and 1 <= k < r, of each p < len/r. */
+struct THFFTPlan_ {
+  long n;
+  int nFactors;
+  long factors[TH_FFT_MAX_FACTORS];
+  double *twiddles;
+  /* exp(-i pi k/n), for 0 <= k <= n, of the real transforms of size 2n */
+  double *realTwiddles;
+};
+
+THFFTPlan *THFFTPlan_new(long n)
+{
+  THFFTPlan *plan;
+  long left = n, len, nTwiddles = 0, p, k;
+  double *tw;
+  int s;
+
+  THArgCheck(n > 0, 1, "FFT size must be positive");
+  plan = THAlloc(sizeof(THFFTPlan));
+  plan->n = n;
+  plan->nFactors = 0;
+
+  /* radix 4 first, then the remaining primes in increasing order */
+  while(left % 4 == 0)
+  {
+    plan->factors[plan->nFactors++] = 4;
+    left /= 4;
+  }
+  for(k = 2; left > 1; k++)
+  {
+    while(left % k == 0)
+    {
+      plan->factors[plan->nFactors++] = k;
+      left /= k;
+    }
+    if(k*k > left && left > 1)
+    {
+      plan->factors[plan->nFactors++] = left;
+      left = 1;
+    }
+  }
+
+  len = n;
+  for(s = 0; s < plan->nFactors; s++)
+  {
+    nTwiddles += (len/plan->factors[s])*(plan->factors[s]-1);
+    len /= plan->factors[s];
+  }
+  plan->twiddles = THAlloc((nTwiddles > 0 ? nTwiddles : 1)*2*sizeof(double));
+
+  tw = plan->twiddles;
+  len = n;
+  for(s = 0; s < plan->nFactors; s++)
+  {
+    long r = plan->factors[s], m = len/r;
+    for(p = 0; p < m; p++)
+    {
+      for(k = 1; k < r; k++)
+      {
+        double theta = -2*M_PI*(double)(p*k)/(double)len;
+        *tw++ = cos(theta);
+        *tw++ = sin(theta);
+      }
+    }
+    len = m;
+  }
+
+  plan->realTwiddles = THAlloc((n+1)*2*sizeof(double));
+  for(k = 0; k <= n; k++)
+  {
+    double theta = -M_PI*(double)k/(double)n;
+    plan->realTwiddles[2*k] = cos(theta);
+    plan->realTwiddles[2*k+1] = sin(theta);
+  }
+  return plan;
+}
+
+void THFFTPlan_free(THFFTPlan *plan)
+{
+  if(!plan)
+    return;
+  THFree(plan->twiddles);
+  THFree(plan->realTwiddles);
+  THFree(plan);
+}
+
+long THFFTPlan_size(THFFTPlan *plan)
+{
+  return plan->n;
+}
+
+static TH_THREAD_LOCAL THFFTPlan *THFFTPlan_cache[TH_FFT_CACHE_SIZE];
+static TH_THREAD_LOCAL int THFFTPlan_cacheNext = 0;
+
+THFFTPlan *THFFTPlan_get(long n)
+{
+  int i;
+  for(i = 0; i < TH_FFT_CACHE_SIZE; i++)
+  {
+    if(THFFTPlan_cache[i] && THFFTPlan_cache[i]->n == n)
+      return THFFTPlan_cache[i];
+  }
+  /* replaces the oldest plan */
+  i = THFFTPlan_cacheNext;
+  THFFTPlan_cacheNext = (i + 1) % TH_FFT_CACHE_SIZE;
+  THFFTPlan_free(THFFTPlan_cache[i]);
+  THFFTPlan_cache[i] = THFFTPlan_new(n);
+  return THFFTPlan_cache[i];
+}
+
+long THFFT_goodSize(long n, int even)
+{
+  long best = -1, p2, p3, p5;
+  if(n <= 1)
+    return even ? 2 : 1;
+  for(p5 = 1; ; p5 *= 5)
+  {
+    for(p3 = p5; ; p3 *= 3)
+    {
+      p2 = p3;
+      if(even && p2 % 2)
+        p2 *= 2;
+      while(p2 < n)
+        p2 *= 2;
+      if(best < 0 || p2 < best)
+        best = p2;
+      if(p3 >= n)
+        break;
+    }
+    if(p5 >= n)
+      break;
+  }
+  return best;
+}
+
+/* one stage of radix r: x holds sequences of length len = r*m, stride s */
+static void THFFT_stage(long r, long m, long s, const double *tw, const double *x, double *y)
+{
+  long p, q, j, k;
+
+  if(r == 2)
+  {
+    for(p = 0; p < m; p++)
+    {
+      double wr = tw[2*p], wi = tw[2*p+1];
+      const double *x0 = x + 2*s*p, *x1 = x + 2*s*(p+m);
+      double *y0 = y + 2*s*(2*p), *y1 = y + 2*s*(2*p+1);
+      for(q = 0; q < s; q++)
+      {
+        double ar = x0[2*q], ai = x0[2*q+1], br = x1[2*q], bi = x1[2*q+1];
+        double dr = ar - br, di = ai - bi;
+        y0[2*q] = ar + br;
+        y0[2*q+1] = ai + bi;
+        y1[2*q] = dr*wr - di*wi;
+        y1[2*q+1] = dr*wi + di*wr;
+      }
+    }
+  }
+  else if(r == 3)
+  {
+    const double s3 = 0.86602540378443864676;
+    for(p = 0; p < m; p++)
+    {
+      const double *w = tw + 4*p;
+      const double *x0 = x + 2*s*p, *x1 = x + 2*s*(p+m), *x2 = x + 2*s*(p+2*m);
+      double *y0 = y + 2*s*(3*p), *y1 = y0 + 2*s, *y2 = y1 + 2*s;
+      for(q = 0; q < s; q++)
+      {
+        double tr = x1[2*q] + x2[2*q], ti = x1[2*q+1] + x2[2*q+1];
+        double ur = x0[2*q] - 0.5*tr, ui = x0[2*q+1] - 0.5*ti;
+        /* -i*s3*(x1 - x2) */
+        double vr = s3*(x1[2*q+1] - x2[2*q+1]), vi = -s3*(x1[2*q] - x2[2*q]);
+        double b1r = ur + vr, b1i = ui + vi, b2r = ur - vr, b2i = ui - vi;
+        y0[2*q] = x0[2*q] + tr;
+        y0[2*q+1] = x0[2*q+1] + ti;
+        y1[2*q] = b1r*w[0] - b1i*w[1];
+        y1[2*q+1] = b1r*w[1] + b1i*w[0];
+        y2[2*q] = b2r*w[2] - b2i*w[3];
+        y2[2*q+1] = b2r*w[3] + b2i*w[2];
+      }
+    }
+  }
+  else if(r == 4)
+  {
+    for(p = 0; p < m; p++)
+    {
+      const double *w = tw + 6*p;
+      const double *x0 = x + 2*s*p, *x1 = x + 2*s*(p+m), *x2 = x + 2*s*(p+2*m), *x3 = x + 2*s*(p+3*m);
+      double *y0 = y + 2*s*(4*p), *y1 = y0 + 2*s, *y2 = y1 + 2*s, *y3 = y2 + 2*s;
+      for(q = 0; q < s; q++)
+      {
+        double s02r = x0[2*q] + x2[2*q], s02i = x0[2*q+1] + x2[2*q+1];
+        double d02r = x0[2*q] - x2[2*q], d02i = x0[2*q+1] - x2[2*q+1];
+        double s13r = x1[2*q] + x3[2*q], s13i = x1[2*q+1] + x3[2*q+1];
+        /* -i*(x1 - x3) */
+        double d13r = x1[2*q+1] - x3[2*q+1], d13i = x3[2*q] - x1[2*q];
+        double b1r = d02r + d13r, b1i = d02i + d13i;
+        double b2r = s02r - s13r, b2i = s02i - s13i;
+        double b3r = d02r - d13r, b3i = d02i - d13i;
+        y0[2*q] = s02r + s13r;
+        y0[2*q+1] = s02i + s13i;
+        y1[2*q] = b1r*w[0] - b1i*w[1];
+        y1[2*q+1] = b1r*w[1] + b1i*w[0];
+        y2[2*q] = b2r*w[2] - b2i*w[3];
+        y2[2*q+1] = b2r*w[3] + b2i*w[2];
+        y3[2*q] = b3r*w[4] - b3i*w[5];
+        y3[2*q+1] = b3r*w[5] + b3i*w[4];
+      }
+    }
+  }
+  else
+  {
+    /* direct DFT of size r */
+    double *roots = THAlloc(2*r*sizeof(double));
+    double *a = THAlloc(2*r*sizeof(double));
+    for(k = 0; k < r; k++)
+    {
+      roots[2*k] = cos(-2*M_PI*(double)k/(double)r);
+      roots[2*k+1] = sin(-2*M_PI*(double)k/(double)r);
+    }
+    for(p = 0; p < m; p++)
+    {
+      const double *w = tw + 2*(r-1)*p;
+      for(q = 0; q < s; q++)
+      {
+        for(j = 0; j < r; j++)
+        {
+          a[2*j] = x[2*(q + s*(p + j*m))];
+          a[2*j+1] = x[2*(q + s*(p + j*m))+1];
+        }
+        for(k = 0; k < r; k++)
+        {
+          double br = 0, bi = 0;
+          double *yk = y + 2*(q + s*(r*p + k));
+          for(j = 0; j < r; j++)
+          {
+            long jk = (j*k) % r;
+            br += a[2*j]*roots[2*jk] - a[2*j+1]*roots[2*jk+1];
+            bi += a[2*j]*roots[2*jk+1] + a[2*j+1]*roots[2*jk];
+          }
+          if(k == 0)
+          {
+            yk[0] = br;
+            yk[1] = bi;
+          }
+          else
+          {
+            yk[0] = br*w[2*(k-1)] - bi*w[2*(k-1)+1];
+            yk[1] = br*w[2*(k-1)+1] + bi*w[2*(k-1)];
+          }
+        }
+      }
+    }
+    THFree(roots);
+    THFree(a);
+  }
+}
+
+void THFFT_forward(THFFTPlan *plan, double *x, double *work, long batch)
+{
+  double *src = x, *dst = work, *tmp;
+  const double *tw = plan->twiddles;
+  long len = plan->n, s = batch;
+  int i;
+
+  for(i = 0; i < plan->nFactors; i++)
+  {
+    long r = plan->factors[i], m = len/r;
+    THFFT_stage(r, m, s, tw, src, dst);
+    tw += 2*m*(r-1);
+    len = m;
+    s *= r;
+    tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  if(src != x)
+    memcpy(x, src, 2*plan->n*batch*sizeof(double));
+}
+
+void THFFT_inverse(THFFTPlan *plan, double *x, double *work, long batch)
+{
+  long i, size = plan->n*batch;
+  for(i = 0; i < size; i++)
+    x[2*i+1] = -x[2*i+1];
+  THFFT_forward(plan, x, work, batch);
+  for(i = 0; i < size; i++)
+    x[2*i+1] = -x[2*i+1];
+}
+
+/* the n reals are transformed as n/2 complex numbers z = x[2j] + i x[2j+1],
+   whose spectrum Z gives the spectra of the even and odd samples */
+void THFFT_realForward(THFFTPlan *plan, const double *x, double *y, double *work)
+{
+  long h = plan->n, k;
+  const double *tw = plan->realTwiddles;
+
+  memcpy(y, x, 2*h*sizeof(double));
+  THFFT_forward(plan, y, work, 1);
+  memcpy(work, y, 2*h*sizeof(double));
+  for(k = 0; k <= h; k++)
+  {
+    long k0 = k % h, k1 = (h - k) % h;
+    double zr = work[2*k0], zi = work[2*k0+1], cr = work[2*k1], ci = -work[2*k1+1];
+    /* even = (Z[k] + conj(Z[h-k]))/2, odd = -i (Z[k] - conj(Z[h-k]))/2 */
+    double er = 0.5*(zr + cr), ei = 0.5*(zi + ci);
+    double or = 0.5*(zi - ci), oi = -0.5*(zr - cr);
+    y[2*k] = er + tw[2*k]*or - tw[2*k+1]*oi;
+    y[2*k+1] = ei + tw[2*k]*oi + tw[2*k+1]*or;
+  }
+}
+
+void THFFT_realInverse(THFFTPlan *plan, const double *y, double *x, double *work)
+{
+  long h = plan->n, k;
+  const double *tw = plan->realTwiddles;
+
+  for(k = 0; k < h; k++)
+  {
+    double ar = y[2*k], ai = y[2*k+1], cr = y[2*(h-k)], ci = -y[2*(h-k)+1];
+    double sr = ar + cr, si = ai + ci, dr = ar - cr, di = ai - ci;
+    /* i * conj(w^k) * d */
+    double wr = tw[2*k], wi = -tw[2*k+1];
+    double tr = dr*wr - di*wi, ti = dr*wi + di*wr;
+    x[2*k] = sr - ti;
+    x[2*k+1] = si + tr;
+  }
+  THFFT_inverse(plan, x, work, 1);
+}
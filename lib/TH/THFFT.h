@@ -0,0 +1,31 @@
+#ifndef TH_FFT_INC
+#define TH_FFT_INC
+
+#include "THGeneral.h"
+
+/* Mixed-radix complex FFTs in double precision. Sizes are best made of
+   factors 2, 3 and 5 (see THFFT_goodSize); other prime factors go through a
+   slower generic butterfly. Complex numbers are interleaved (re, im) pairs. */
+typedef struct THFFTPlan_ THFFTPlan;
+
+TH_API THFFTPlan *THFFTPlan_new(long n);
+/* plan of size n cached by the calling thread, which must not free it */
+TH_API THFFTPlan *THFFTPlan_get(long n);
+TH_API void THFFTPlan_free(THFFTPlan *plan);
+TH_API long THFFTPlan_size(THFFTPlan *plan);
+
+/* smallest size >= n with no prime factor but 2, 3 and 5, and even if asked */
+TH_API long THFFT_goodSize(long n, int even);
+
+/* unnormalized transforms, in place, of batch interleaved sequences: element
+   j of sequence q is x[q + batch*j]; work holds 2*n*batch doubles */
+TH_API void THFFT_forward(THFFTPlan *plan, double *x, double *work, long batch);
+TH_API void THFFT_inverse(THFFTPlan *plan, double *x, double *work, long batch);
+
+/* transform of n = 2*THFFTPlan_size(plan) reals x into the n/2+1 first
+   complex numbers y of their spectrum, and back to n times x; work holds n
+   doubles */
+TH_API void THFFT_realForward(THFFTPlan *plan, const double *x, double *y, double *work);
+TH_API void THFFT_realInverse(THFFTPlan *plan, const double *y, double *x, double *work);
+
+#endif
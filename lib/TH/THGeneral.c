@@ -5,12 +5,6 @@
 #include <omp.h>
 #endif
 
-#ifndef TH_HAVE_THREAD
-#define __thread
-#elif _MSC_VER
-#define __thread __declspec( thread )
-#endif
-
 #if (defined(__unix) || defined(_WIN32))
   #if defined(__FreeBSD__)
     #include <malloc_np.h>
@@ -30,8 +24,8 @@ static void defaultErrorHandlerFunction(const char *msg, void *data)
 
 static THErrorHandlerFunction defaultErrorHandler = defaultErrorHandlerFunction;
 static void *defaultErrorHandlerData;
-static __thread THErrorHandlerFunction threadErrorHandler = NULL;
-static __thread void *threadErrorHandlerData;
+static TH_THREAD_LOCAL THErrorHandlerFunction threadErrorHandler = NULL;
+static TH_THREAD_LOCAL void *threadErrorHandlerData;
 
 void _THError(const char *file, const int line, const char *fmt, ...)
 {
@@ -90,8 +84,8 @@ static void defaultArgErrorHandlerFunction(int argNumber, const char *msg, void
 
 static THArgErrorHandlerFunction defaultArgErrorHandler = defaultArgErrorHandlerFunction;
 static void *defaultArgErrorHandlerData;
-static __thread THArgErrorHandlerFunction threadArgErrorHandler = NULL;
-static __thread void *threadArgErrorHandlerData;
+static TH_THREAD_LOCAL THArgErrorHandlerFunction threadArgErrorHandler = NULL;
+static TH_THREAD_LOCAL void *threadArgErrorHandlerData;
 
 void _THArgCheck(const char *file, int line, int condition, int argNumber, const char *fmt, ...)
 {
@@ -131,13 +125,13 @@ void THSetDefaultArgErrorHandler(THArgErrorHandlerFunction new_handler, void *da
   defaultArgErrorHandlerData = data;
 }
 
-static __thread void (*torchGCFunction)(void *data) = NULL;
-static __thread void *torchGCData;
+static TH_THREAD_LOCAL void (*torchGCFunction)(void *data) = NULL;
+static TH_THREAD_LOCAL void *torchGCData;
 static ptrdiff_t heapSize = 0;
-static __thread ptrdiff_t heapDelta = 0;
+static TH_THREAD_LOCAL ptrdiff_t heapDelta = 0;
 static const ptrdiff_t heapMaxDelta = (ptrdiff_t)1e6; // limit to +/- 1MB before updating heapSize
 static const ptrdiff_t heapMinDelta = (ptrdiff_t)-1e6;
-static __thread ptrdiff_t heapSoftmax = (ptrdiff_t)3e8; // 300MB, adjusted upward dynamically
+static TH_THREAD_LOCAL ptrdiff_t heapSoftmax = (ptrdiff_t)3e8; // 300MB, adjusted upward dynamically
 static const double heapSoftmaxGrowthThresh = 0.8; // grow softmax if >80% max after GC
 static const double heapSoftmaxGrowthFactor = 1.4; // grow softmax by 40%
 
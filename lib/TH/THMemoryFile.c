@@ -2,6 +2,15 @@
 #include "THFilePrivate.h"
 #include "stdint.h"
 
+/* binary data appended past the end of the storage, see THMemoryFile_writeBinary */
+typedef struct THMemoryFileChunk__
+{
+    struct THMemoryFileChunk__ *next;
+    size_t size;
+    size_t capacity;
+    char data[1];
+} THMemoryFileChunk;
+
 typedef struct THMemoryFile__
 {
     THFile file;
@@ -9,6 +18,9 @@ typedef struct THMemoryFile__
     size_t size;
     size_t position;
 	int longSize;
+    THMemoryFileChunk *chunks;
+    THMemoryFileChunk *lastChunk;
+    size_t chunkedSize;
 
 } THMemoryFile;
 
@@ -64,6 +76,112 @@ static void THMemoryFile_grow(THMemoryFile *self, size_t size)
                                        : self->storage->size + missingSpace));
 }
 
+static void THMemoryFile_freeChunks(THMemoryFile *self)
+{
+  THMemoryFileChunk *chunk = self->chunks;
+  while(chunk)
+  {
+    THMemoryFileChunk *next = chunk->next;
+    THFree(chunk);
+    chunk = next;
+  }
+  self->chunks = NULL;
+  self->lastChunk = NULL;
+  self->chunkedSize = 0;
+}
+
+/* moves the chunks at the end of the storage, freeing them as we go */
+static void THMemoryFile_flatten(THMemoryFile *self)
+{
+  THMemoryFileChunk *chunk = self->chunks;
+  size_t offset;
+
+  if(!chunk)
+    return;
+
+  offset = self->size - self->chunkedSize;
+  THCharStorage_resize(self->storage, self->size+1);
+  while(chunk)
+  {
+    THMemoryFileChunk *next = chunk->next;
+    memcpy(self->storage->data+offset, chunk->data, chunk->size);
+    offset += chunk->size;
+    THFree(chunk);
+    chunk = next;
+  }
+  self->storage->data[self->size] = '\0';
+  self->chunks = NULL;
+  self->lastChunk = NULL;
+  self->chunkedSize = 0;
+}
+
+/* ascii reads rely on a '\0' after the content, which a storage given by
+   the user (for binary reading) may not have */
+static void THMemoryFile_terminate(THMemoryFile *self)
+{
+  THMemoryFile_flatten(self);
+  if(self->storage->size == self->size)
+  {
+    THCharStorage_resize(self->storage, self->size+1);
+    self->storage->data[self->size] = '\0';
+  }
+}
+
+/* Binary writes at the end of the file which do not fit in the storage are
+   kept in a list of chunks instead of reallocating the storage: the data is
+   copied only once, when it is needed contiguously. */
+static void THMemoryFile_writeBinary(THMemoryFile *self, const void *data, size_t nByte)
+{
+  if(self->position == self->size && (self->chunks || self->size+nByte >= self->storage->size))
+  {
+    const char *src = data;
+    THMemoryFileChunk *chunk = self->lastChunk;
+
+    if(chunk && chunk->size < chunk->capacity)
+    {
+      size_t n = (chunk->capacity-chunk->size < nByte ? chunk->capacity-chunk->size : nByte);
+      memcpy(chunk->data+chunk->size, src, n);
+      chunk->size += n;
+      src += n;
+      nByte -= n;
+      self->chunkedSize += n;
+      self->size += n;
+    }
+
+    if(nByte > 0)
+    {
+      size_t capacity = (self->size/2 > nByte ? self->size/2 : nByte);
+      if(capacity < 4096)
+        capacity = 4096;
+      chunk = THAlloc(offsetof(THMemoryFileChunk, data) + capacity);
+      chunk->next = NULL;
+      chunk->size = nByte;
+      chunk->capacity = capacity;
+      memcpy(chunk->data, src, nByte);
+      if(self->lastChunk)
+        self->lastChunk->next = chunk;
+      else
+        self->chunks = chunk;
+      self->lastChunk = chunk;
+      self->chunkedSize += nByte;
+      self->size += nByte;
+    }
+    self->position = self->size;
+  }
+  else
+  {
+    THMemoryFile_flatten(self);
+    THMemoryFile_grow(self, self->position+nByte);
+    memmove(self->storage->data+self->position, data, nByte);
+    self->position += nByte;
+    if(self->position > self->size)
+    {
+      self->size = self->position;
+      self->storage->data[self->size] = '\0';
+    }
+  }
+}
+
 static int THMemoryFile_mode(const char *mode, int *isReadable, int *isWritable)
 {
   *isReadable = 0;
@@ -107,6 +225,7 @@ static int THMemoryFile_mode(const char *mode, int *isReadable, int *isWritable)
     if (n == 0)                                                         \
         return 0;                                                       \
                                                                         \
+    THMemoryFile_flatten(mfself);                                       \
     if(mfself->file.isBinary)                                           \
     {                                                                   \
       size_t nByte = sizeof(TYPE)*n;                                      \
@@ -118,6 +237,7 @@ static int THMemoryFile_mode(const char *mode, int *isReadable, int *isWritable)
     else                                                                \
     {                                                                   \
       size_t i;                                                           \
+      THMemoryFile_terminate(mfself);                                   \
       for(i = 0; i < n; i++)                                            \
       {                                                                 \
         size_t nByteRead = 0;                                             \
@@ -162,20 +282,11 @@ static int THMemoryFile_mode(const char *mode, int *isReadable, int *isWritable)
         return 0;                                                       \
                                                                         \
     if(mfself->file.isBinary)                                           \
-    {                                                                   \
-      size_t nByte = sizeof(TYPE)*n;                                      \
-      THMemoryFile_grow(mfself, mfself->position+nByte);                \
-      memmove(mfself->storage->data+mfself->position, data, nByte);     \
-      mfself->position += nByte;                                        \
-      if(mfself->position > mfself->size)                               \
-      {                                                                 \
-        mfself->size = mfself->position;                                \
-        mfself->storage->data[mfself->size] = '\0';                     \
-      }                                                                 \
-    }                                                                   \
+      THMemoryFile_writeBinary(mfself, data, sizeof(TYPE)*n);           \
     else                                                                \
     {                                                                   \
       size_t i;                                                           \
+      THMemoryFile_flatten(mfself);                                     \
       for(i = 0; i < n; i++)                                            \
       {                                                                 \
         ssize_t nByteWritten;                                           \
@@ -228,11 +339,36 @@ THCharStorage *THMemoryFile_storage(THFile *self)
   THMemoryFile *mfself = (THMemoryFile*)self;
   THArgCheck(mfself->storage != NULL, 1, "attempt to use a closed file");
 
+  THMemoryFile_flatten(mfself);
   THCharStorage_resize(mfself->storage, mfself->size+1);
+  mfself->storage->data[mfself->size] = '\0';
 
   return mfself->storage;
 }
 
+void THMemoryFile_drain(THFile *self, void (*write)(void *state, const char *data, size_t size), void *state)
+{
+  THMemoryFile *mfself = (THMemoryFile*)self;
+  THArgCheck(mfself->storage != NULL, 1, "attempt to use a closed file");
+
+  write(state, mfself->storage->data, mfself->size-mfself->chunkedSize);
+  while(mfself->chunks)
+  {
+    /* the chunk stays in the list if write raises an error, and is freed
+       with the file */
+    THMemoryFileChunk *chunk = mfself->chunks;
+    write(state, chunk->data, chunk->size);
+    mfself->chunks = chunk->next;
+    THFree(chunk);
+  }
+  mfself->lastChunk = NULL;
+  mfself->chunkedSize = 0;
+  mfself->size = 0;
+  mfself->position = 0;
+  if(mfself->storage->size > 0)
+    mfself->storage->data[0] = '\0';
+}
+
 static void THMemoryFile_synchronize(THFile *self)
 {
   THMemoryFile *mfself = (THMemoryFile*)self;
@@ -275,6 +411,7 @@ static void THMemoryFile_close(THFile *self)
 {
   THMemoryFile *mfself = (THMemoryFile*)self;
   THArgCheck(mfself->storage != NULL, 1, "attempt to use a closed file");
+  THMemoryFile_freeChunks(mfself);
   THCharStorage_free(mfself->storage);
   mfself->storage = NULL;
 }
@@ -283,6 +420,7 @@ static void THMemoryFile_free(THFile *self)
 {
   THMemoryFile *mfself = (THMemoryFile*)self;
 
+  THMemoryFile_freeChunks(mfself);
   if(mfself->storage)
     THCharStorage_free(mfself->storage);
 
@@ -362,6 +500,7 @@ static size_t THMemoryFile_readLong(THFile *self, long *data, size_t n)
   if (n == 0)
     return 0;
 
+  THMemoryFile_flatten(mfself);
   if(mfself->file.isBinary)
   {
     if(mfself->longSize == 0 || mfself->longSize == sizeof(long))
@@ -398,6 +537,7 @@ static size_t THMemoryFile_readLong(THFile *self, long *data, size_t n)
   else
   {
     size_t i;
+    THMemoryFile_terminate(mfself);
     for(i = 0; i < n; i++)
     {
       size_t nByteRead = 0;
@@ -445,11 +585,12 @@ static size_t THMemoryFile_writeLong(THFile *self, long *data, size_t n)
   {
     if(mfself->longSize == 0 || mfself->longSize == sizeof(long))
     {
-      size_t nByte = sizeof(long)*n;
-      THMemoryFile_grow(mfself, mfself->position+nByte);
-      memmove(mfself->storage->data+mfself->position, data, nByte);
-      mfself->position += nByte;
-    } else if(mfself->longSize == 4)
+      THMemoryFile_writeBinary(mfself, data, sizeof(long)*n);
+      return n;
+    }
+
+    THMemoryFile_flatten(mfself);
+    if(mfself->longSize == 4)
     {
       size_t nByte = 4*n;
       THMemoryFile_grow(mfself, mfself->position+nByte);
@@ -482,6 +623,7 @@ static size_t THMemoryFile_writeLong(THFile *self, long *data, size_t n)
   else
   {
     size_t i;
+    THMemoryFile_flatten(mfself);
     for(i = 0; i < n; i++)
     {
       ssize_t nByteWritten;
@@ -536,6 +678,8 @@ static size_t THMemoryFile_readString(THFile *self, const char *format, char **s
   THArgCheck(mfself->file.isReadable, 1, "attempt to read in a write-only file");
   THArgCheck((strlen(format) >= 2 ? (format[0] == '*') && (format[1] == 'a' || format[1] == 'l') : 0), 2, "format must be '*a' or '*l'");
 
+  THMemoryFile_flatten(mfself);
+
   if(mfself->position == mfself->size) /* eof ? */
   {
     mfself->file.hasError = 1;
@@ -599,19 +743,12 @@ static size_t THMemoryFile_writeString(THFile *self, const char *str, size_t siz
   THArgCheck(mfself->storage != NULL, 1, "attempt to use a closed file");
   THArgCheck(mfself->file.isWritable, 1, "attempt to write in a read-only file");
 
-  THMemoryFile_grow(mfself, mfself->position+size);
-  memmove(mfself->storage->data+mfself->position, str, size);
-  mfself->position += size;
-  if(mfself->position > mfself->size)
-  {
-    mfself->size = mfself->position;
-    mfself->storage->data[mfself->size] = '\0';
-  }
+  THMemoryFile_writeBinary(mfself, str, size);
 
   return size;
 }
 
-THFile *THMemoryFile_newWithStorage(THCharStorage *storage, const char *mode)
+static THFile *THMemoryFile_create(THCharStorage *storage, int isTerminated, const char *mode)
 {
   static struct THFileVTable vtable = {
     THMemoryFile_isOpened,
@@ -650,7 +787,8 @@ THFile *THMemoryFile_newWithStorage(THCharStorage *storage, const char *mode)
 
   if(storage)
   {
-    THArgCheck(storage->data[storage->size-1] == '\0', 1, "provided CharStorage must be terminated by 0");
+    if(isTerminated)
+      THArgCheck(storage->size > 0 && storage->data[storage->size-1] == '\0', 1, "provided CharStorage must be terminated by 0");
     THArgCheck(THMemoryFile_mode(mode, &isReadable, &isWritable), 2, "file mode should be 'r','w' or 'rw'");
     THCharStorage_retain(storage);
   }
@@ -664,9 +802,12 @@ THFile *THMemoryFile_newWithStorage(THCharStorage *storage, const char *mode)
   mfself = THAlloc(sizeof(THMemoryFile));
 
   mfself->storage = storage;
-  mfself->size = (storage ? storage->size-1 : 0);
+  mfself->size = (isTerminated ? storage->size-1 : storage->size);
   mfself->position = 0;
   mfself->longSize = 0;
+  mfself->chunks = NULL;
+  mfself->lastChunk = NULL;
+  mfself->chunkedSize = 0;
 
   mfself->file.vtable = &vtable;
   mfself->file.isQuiet = 0;
@@ -679,7 +820,45 @@ THFile *THMemoryFile_newWithStorage(THCharStorage *storage, const char *mode)
   return (THFile*)mfself;
 }
 
+THFile *THMemoryFile_newWithStorage(THCharStorage *storage, const char *mode)
+{
+  return THMemoryFile_create(storage, 1, mode);
+}
+
+THFile *THMemoryFile_newWithRawStorage(THCharStorage *storage, const char *mode)
+{
+  THArgCheck(storage != NULL, 1, "storage expected");
+  return THMemoryFile_create(storage, 0, mode);
+}
+
+char *THMemoryFile_readView(THFile *self, size_t size, size_t alignment, THCharStorage **storage)
+{
+  THMemoryFile *mfself = (THMemoryFile*)self;
+  char *data;
+
+  THArgCheck(mfself->storage != NULL, 1, "attempt to use a closed file");
+  THArgCheck(mfself->file.isReadable, 1, "attempt to read in a write-only file");
+  THArgCheck(!mfself->file.isWritable, 1, "views require a read-only file");
+  THArgCheck(mfself->file.isBinary, 1, "views require a binary file");
+
+  if(mfself->position + size > mfself->size)
+  {
+    mfself->file.hasError = 1;
+    if(!mfself->file.isQuiet)
+      THError("read error: cannot view %zu bytes at position %zu", size, mfself->position);
+    return NULL;
+  }
+
+  data = mfself->storage->data + mfself->position;
+  if(alignment > 1 && ((uintptr_t)data) % alignment != 0)
+    return NULL;
+
+  mfself->position += size;
+  *storage = mfself->storage;
+  return data;
+}
+
 THFile *THMemoryFile_new(const char *mode)
 {
-  return THMemoryFile_newWithStorage(NULL, mode);
+  return THMemoryFile_create(NULL, 1, mode);
 }
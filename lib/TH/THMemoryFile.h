@@ -6,8 +6,20 @@
 
 TH_API THFile *THMemoryFile_newWithStorage(THCharStorage *storage, const char *mode);
 TH_API THFile *THMemoryFile_new(const char *mode);
+/* the content is the whole storage, which does not need to be terminated by 0 */
+TH_API THFile *THMemoryFile_newWithRawStorage(THCharStorage *storage, const char *mode);
 
 TH_API THCharStorage *THMemoryFile_storage(THFile *self);
 TH_API void THMemoryFile_longSize(THFile *self, int size);
 
+/* Passes the content of the file to write(), in pieces and in order, and
+   empties the file. Chunks are freed as soon as they are passed, so that the
+   content is never held twice by the file. */
+TH_API void THMemoryFile_drain(THFile *self, void (*write)(void *state, const char *data, size_t size), void *state);
+
+/* Returns the address of the next size bytes of a read-only binary file and
+   skips them, or NULL if they are not aligned on alignment bytes. The bytes
+   belong to *storage, which must be retained to keep them valid. */
+TH_API char *THMemoryFile_readView(THFile *self, size_t size, size_t alignment, THCharStorage **storage);
+
 #endif
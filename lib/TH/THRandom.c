@@ -1,5 +1,6 @@
 #include "THGeneral.h"
 #include "THRandom.h"
+#include "THAtomic.h"
 
 #ifndef _WIN32
 #include <fcntl.h>
@@ -24,7 +25,15 @@ static THGenerator* THGenerator_newUnseeded()
 /* Creates new generator and makes sure it is seeded*/
 THGenerator* THGenerator_new()
 {
-  THGenerator *self = THGenerator_newUnseeded();
+  return THGenerator_newWithType(TH_GENERATOR_MT19937);
+}
+
+THGenerator* THGenerator_newWithType(int type)
+{
+  THGenerator *self;
+  THArgCheck(type == TH_GENERATOR_MT19937 || type == TH_GENERATOR_PHILOX, 1, "unknown generator type");
+  self = THGenerator_newUnseeded();
+  self->type = type;
   THRandom_seed(self);
   return self;
 }
@@ -43,12 +52,50 @@ void THGenerator_free(THGenerator *self)
 int THGenerator_isValid(THGenerator *_generator)
 {
   if ((_generator->seeded == 1) &&
+    (_generator->type == TH_GENERATOR_MT19937 || _generator->type == TH_GENERATOR_PHILOX) &&
     (_generator->left > 0 && _generator->left <= n) && (_generator->next <= n))
     return 1;
 
   return 0;
 }
 
+int THGenerator_type(THGenerator *_generator)
+{
+  return _generator->type;
+}
+
+/* layout of the generators before Philox ones, a prefix of THGenerator */
+typedef struct THGeneratorMT19937State {
+  unsigned long the_initial_seed;
+  int left;
+  int seeded;
+  unsigned long next;
+  unsigned long state[_MERSENNE_STATE_N];
+  double normal_x;
+  double normal_y;
+  double normal_rho;
+  int normal_is_valid;
+} THGeneratorMT19937State;
+
+size_t THGenerator_mt19937StateSize(void)
+{
+  return sizeof(THGeneratorMT19937State);
+}
+
+THGenerator* THGenerator_copyState(THGenerator *self, const void *state, size_t size)
+{
+  THArgCheck(size == sizeof(THGenerator) || size == sizeof(THGeneratorMT19937State), 3,
+             "RNG state is wrong size");
+  if (size == sizeof(THGenerator))
+    return THGenerator_copy(self, (THGenerator *)state);
+
+  /* the padding of the old state may overlap type, set afterwards */
+  memset(self, 0, sizeof(THGenerator));
+  memcpy(self, state, size);
+  self->type = TH_GENERATOR_MT19937;
+  return self;
+}
+
 #ifndef _WIN32
 static unsigned long readURandomLong()
 {
@@ -140,12 +187,14 @@ unsigned long THRandom_seed(THGenerator *_generator)
 void THRandom_manualSeed(THGenerator *_generator, unsigned long the_seed_)
 {
   int j;
+  int type = _generator->type;
 
   /* This ensures reseeding resets all of the state (i.e. state for Gaussian numbers) */
   THGenerator *blank = THGenerator_newUnseeded();
   THGenerator_copy(_generator, blank);
   THGenerator_free(blank);
 
+  _generator->type = type;
   _generator->the_initial_seed = the_seed_;
   _generator->state[0] = _generator->the_initial_seed & 0xffffffffUL;
   for(j = 1; j < n; j++)
@@ -183,10 +232,375 @@ void THRandom_nextState(THGenerator *_generator)
   *p = p[m-n] ^ TWIST(p[0], _generator->state[0]);
 }
 
+/* Philox4x32-10, from "Parallel Random Numbers: As Easy as 1, 2, 3"
+   (Salmon, Moraes, Dror and Shaw, 2011) */
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_ROUNDS 10
+
+void THRandom_philox(const uint32_t counter[4], const uint32_t key[2], uint32_t result[4])
+{
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  int r;
+
+  for(r = 0; r < PHILOX_ROUNDS; r++)
+  {
+    uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+    uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+    c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t)p1;
+    c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t)p0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  result[0] = c0;
+  result[1] = c1;
+  result[2] = c2;
+  result[3] = c3;
+}
+
+static void THRandom_philoxBlock(THGenerator *_generator, uint64_t block, uint32_t result[4])
+{
+  uint32_t counter[4], key[2];
+  uint64_t seed = _generator->the_initial_seed;
+  counter[0] = (uint32_t)block;
+  counter[1] = (uint32_t)(block >> 32);
+  counter[2] = (uint32_t)_generator->philox_stream;
+  counter[3] = (uint32_t)(_generator->philox_stream >> 32);
+  key[0] = (uint32_t)seed;
+  key[1] = (uint32_t)(seed >> 32);
+  THRandom_philox(counter, key, result);
+}
+
+uint64_t THRandom_offset(THGenerator *_generator)
+{
+  THArgCheck(_generator->type == TH_GENERATOR_PHILOX, 1, "counter-based generator expected");
+  return _generator->philox_offset;
+}
+
+void THRandom_randomAt(THGenerator *_generator, uint64_t offset, uint32_t *out, long size)
+{
+  uint32_t block[4];
+  long i = 0;
+
+  THArgCheck(_generator->type == TH_GENERATOR_PHILOX, 1, "counter-based generator expected");
+  if(offset & 3)
+  {
+    THRandom_philoxBlock(_generator, offset >> 2, block);
+    for(; i < size && ((offset + i) & 3); i++)
+      out[i] = block[(offset + i) & 3];
+  }
+  for(; i + 4 <= size; i += 4)
+    THRandom_philoxBlock(_generator, (offset + i) >> 2, out + i);
+  if(i < size)
+  {
+    THRandom_philoxBlock(_generator, (offset + i) >> 2, block);
+    for(; i < size; i++)
+      out[i] = block[(offset + i) & 3];
+  }
+}
+
+void THRandom_skip(THGenerator *_generator, uint64_t size)
+{
+  if(_generator->type == TH_GENERATOR_PHILOX)
+  {
+    _generator->philox_offset += size;
+    /* keeps the block of the current counter up to date */
+    if(_generator->philox_offset & 3)
+      THRandom_philoxBlock(_generator, _generator->philox_offset >> 2, _generator->philox_block);
+  }
+  else
+  {
+    uint64_t i;
+    for(i = 0; i < size; i++)
+      THRandom_random(_generator);
+  }
+}
+
+/* Jump-ahead of the Mersenne Twister, after "Efficient Jump Ahead for
+   F2-Linear Random Number Generators" (Haramoto, Matsumoto, Nishimura,
+   Panneton and L'Ecuyer, 2008). The state words w(k-n)..w(k-1) form a
+   window, moved one word ahead by w(k) = w(k-n+m) ^ TWIST(w(k-n), w(k-n+1)).
+   This step T has a characteristic polynomial P of degree 19937, found with
+   Berlekamp-Massey on a bit of the words. Jumping by J words applies
+   x^J mod P to the window, in T, with the Horner scheme. */
+#define MT_DEGREE 19937
+#define MT_POLY_WORDS ((2*MT_DEGREE+63)/64+2)
+
+typedef struct {
+  unsigned long w[n];
+  int i; /* oldest word of the window */
+} THMTWindow;
+
+static void THRandom_mtStep(THMTWindow *window)
+{
+  int i = window->i;
+  unsigned long *w = window->w;
+  w[i] = w[(i+m) % n] ^ TWIST(w[i], w[(i+1) % n]);
+  window->i = (i+1) % n;
+}
+
+/* a ^= b, for a window b starting at word 0 */
+static void THRandom_mtAdd(THMTWindow *a, const unsigned long *b)
+{
+  int head = n - a->i;
+  int j;
+  for(j = 0; j < head; j++)
+    a->w[a->i + j] ^= b[j];
+  for(j = head; j < n; j++)
+    a->w[j - head] ^= b[j];
+}
+
+#define POLY_GET(p, i) (((p)[(i) >> 6] >> ((i) & 63)) & 1)
+#define POLY_FLIP(p, i) ((p)[(i) >> 6] ^= (uint64_t)1 << ((i) & 63))
+
+/* p ^= x^shift * q, for q of degree below qBits */
+static void THRandom_polyAddShifted(uint64_t *p, const uint64_t *q, long qBits, long shift)
+{
+  long qWords = (qBits + 63) / 64;
+  long wordShift = shift / 64;
+  int bitShift = shift % 64;
+  long j;
+  for(j = 0; j < qWords; j++)
+  {
+    p[j + wordShift] ^= q[j] << bitShift;
+    if(bitShift)
+      p[j + wordShift + 1] ^= q[j] >> (64 - bitShift);
+  }
+}
+
+/* characteristic polynomial of the Mersenne Twister step, in P */
+static void THRandom_mtPolynomial(uint64_t *P)
+{
+  const long nBits = 2*MT_DEGREE;
+  const long nWords = (nBits + 63) / 64 + 2;
+  uint64_t *seq = THAlloc(sizeof(uint64_t)*nWords);
+  uint64_t *C = THAlloc(sizeof(uint64_t)*nWords);
+  uint64_t *B = THAlloc(sizeof(uint64_t)*nWords);
+  uint64_t *T = THAlloc(sizeof(uint64_t)*nWords);
+  THGenerator *gen = THGenerator_newUnseeded();
+  THMTWindow window;
+  long L = 0, shift = 1, k, i;
+
+  /* least significant bit of the words following the default seed; the
+     sequence is stored backwards for the discrepancies below */
+  THRandom_manualSeed(gen, 5489);
+  memcpy(window.w, gen->state, sizeof(window.w));
+  window.i = 0;
+  THGenerator_free(gen);
+  memset(seq, 0, sizeof(uint64_t)*nWords);
+  for(k = 0; k < nBits; k++)
+  {
+    THRandom_mtStep(&window);
+    if(window.w[(window.i + n - 1) % n] & 1)
+      POLY_FLIP(seq, nBits - 1 - k);
+  }
+
+  /* Berlekamp-Massey over GF(2): C is the connection polynomial */
+  memset(C, 0, sizeof(uint64_t)*nWords);
+  memset(B, 0, sizeof(uint64_t)*nWords);
+  C[0] = B[0] = 1;
+  for(k = 0; k < nBits; k++)
+  {
+    /* discrepancy: sum of C[i]*s[k-i], with s[k-i] at bit nBits-1-k+i of seq */
+    long offset = nBits - 1 - k;
+    long wordOffset = offset / 64;
+    int bitOffset = offset % 64;
+    uint64_t d = 0;
+    for(i = 0; i <= L / 64; i++)
+    {
+      uint64_t s = seq[wordOffset + i] >> bitOffset;
+      if(bitOffset && wordOffset + i + 1 < nWords)
+        s |= seq[wordOffset + i + 1] << (64 - bitOffset);
+      d ^= C[i] & s;
+    }
+    d ^= d >> 32;
+    d ^= d >> 16;
+    d ^= d >> 8;
+    d ^= d >> 4;
+    d ^= d >> 2;
+    d ^= d >> 1;
+    if(!(d & 1))
+      shift++;
+    else if(2*L <= k)
+    {
+      memcpy(T, C, sizeof(uint64_t)*nWords);
+      THRandom_polyAddShifted(C, B, L+1, shift);
+      L = k + 1 - L;
+      memcpy(B, T, sizeof(uint64_t)*nWords);
+      shift = 1;
+    }
+    else
+    {
+      THRandom_polyAddShifted(C, B, L+1, shift);
+      shift++;
+    }
+  }
+  if(L != MT_DEGREE)
+    THError("unexpected Mersenne Twister polynomial degree %ld", L);
+
+  /* P(x) = x^L C(1/x) */
+  memset(P, 0, sizeof(uint64_t)*MT_POLY_WORDS);
+  for(i = 0; i <= L; i++)
+  {
+    if(POLY_GET(C, i))
+      POLY_FLIP(P, L - i);
+  }
+
+  THFree(seq);
+  THFree(C);
+  THFree(B);
+  THFree(T);
+}
+
+/* x^(2^log2Steps) mod P, in q */
+static void THRandom_mtJumpPolynomial(uint64_t *q, const uint64_t *P, int log2Steps)
+{
+  uint64_t *square = THAlloc(sizeof(uint64_t)*MT_POLY_WORDS);
+  long i;
+  int k;
+
+  memset(q, 0, sizeof(uint64_t)*MT_POLY_WORDS);
+  POLY_FLIP(q, 1);
+  for(k = 0; k < log2Steps; k++)
+  {
+    /* squaring over GF(2) spreads the coefficients */
+    memset(square, 0, sizeof(uint64_t)*MT_POLY_WORDS);
+    for(i = 0; i < MT_DEGREE; i++)
+    {
+      if(POLY_GET(q, i))
+        POLY_FLIP(square, 2*i);
+    }
+    for(i = 2*MT_DEGREE-2; i >= MT_DEGREE; i--)
+    {
+      if(POLY_GET(square, i))
+        THRandom_polyAddShifted(square, P, MT_DEGREE+1, i - MT_DEGREE);
+    }
+    memcpy(q, square, sizeof(uint64_t)*MT_POLY_WORDS);
+  }
+  THFree(square);
+}
+
+static void THRandom_mtJump(THGenerator *_generator, const uint64_t *q)
+{
+  THMTWindow acc;
+  long i;
+
+  /* the state array is the window of the next words, whatever the number of
+     words already used: the position in the array stays the same */
+  memset(&acc, 0, sizeof(acc));
+  for(i = MT_DEGREE-1; i >= 0; i--)
+  {
+    THRandom_mtStep(&acc);
+    if(POLY_GET(q, i))
+      THRandom_mtAdd(&acc, _generator->state);
+  }
+  for(i = 0; i < n; i++)
+    _generator->state[i] = acc.w[(acc.i + i) % n];
+  _generator->normal_is_valid = 0;
+}
+
+static void THRandom_philoxJump(THGenerator *_generator, int log2Steps)
+{
+  /* the output number is philox_stream*2^64 + philox_offset */
+  if(log2Steps >= 64)
+    _generator->philox_stream += (uint64_t)1 << (log2Steps - 64);
+  else
+  {
+    uint64_t offset = _generator->philox_offset + ((uint64_t)1 << log2Steps);
+    if(offset < _generator->philox_offset)
+      _generator->philox_stream++;
+    _generator->philox_offset = offset;
+  }
+  if(_generator->philox_offset & 3)
+    THRandom_philoxBlock(_generator, _generator->philox_offset >> 2, _generator->philox_block);
+  _generator->normal_is_valid = 0;
+}
+
+/* characteristic polynomial of the Mersenne Twister step, computed once */
+static ptrdiff_t volatile mtCharPolynomial = 0;
+
+static const uint64_t *THRandom_mtCachedPolynomial(void)
+{
+  uint64_t *P = (uint64_t*)THAtomicGetPtrdiff(&mtCharPolynomial);
+  if(!P)
+  {
+    P = THAlloc(sizeof(uint64_t)*MT_POLY_WORDS);
+    THRandom_mtPolynomial(P);
+    /* another thread may have computed it first */
+    if(!THAtomicCompareAndSwapPtrdiff(&mtCharPolynomial, 0, (ptrdiff_t)P))
+    {
+      THFree(P);
+      P = (uint64_t*)THAtomicGetPtrdiff(&mtCharPolynomial);
+    }
+  }
+  return P;
+}
+
+void THRandom_jump(THGenerator *_generator, int log2Steps)
+{
+  THArgCheck(log2Steps >= 0 && log2Steps < 128, 2, "jump of 2^0 to 2^127 numbers expected");
+  if(_generator->type == TH_GENERATOR_PHILOX)
+    THRandom_philoxJump(_generator, log2Steps);
+  else
+  {
+    uint64_t *q = THAlloc(sizeof(uint64_t)*MT_POLY_WORDS);
+    THRandom_mtJumpPolynomial(q, THRandom_mtCachedPolynomial(), log2Steps);
+    THRandom_mtJump(_generator, q);
+    THFree(q);
+  }
+}
+
+/* x^(2^TH_GENERATOR_SPLIT_LOG2) mod P, computed once */
+static ptrdiff_t volatile mtSplitPolynomial = 0;
+
+void THGenerator_split(THGenerator *self, int nStreams, THGenerator **streams)
+{
+  uint64_t *q = NULL;
+  int i;
+
+  THArgCheck(nStreams > 0, 2, "number of streams must be positive");
+  if(self->type != TH_GENERATOR_PHILOX)
+  {
+    q = (uint64_t*)THAtomicGetPtrdiff(&mtSplitPolynomial);
+    if(!q)
+    {
+      q = THAlloc(sizeof(uint64_t)*MT_POLY_WORDS);
+      THRandom_mtJumpPolynomial(q, THRandom_mtCachedPolynomial(), TH_GENERATOR_SPLIT_LOG2);
+      /* another thread may have computed it first */
+      if(!THAtomicCompareAndSwapPtrdiff(&mtSplitPolynomial, 0, (ptrdiff_t)q))
+      {
+        THFree(q);
+        q = (uint64_t*)THAtomicGetPtrdiff(&mtSplitPolynomial);
+      }
+    }
+  }
+
+  for(i = 0; i < nStreams; i++)
+  {
+    streams[i] = THGenerator_copy(THGenerator_newUnseeded(), i == 0 ? self : streams[i-1]);
+    if(q)
+      THRandom_mtJump(streams[i], q);
+    else
+      THRandom_philoxJump(streams[i], TH_GENERATOR_SPLIT_LOG2);
+  }
+}
+
 unsigned long THRandom_random(THGenerator *_generator)
 {
   unsigned long y;
 
+  if (_generator->type == TH_GENERATOR_PHILOX)
+  {
+    if ((_generator->philox_offset & 3) == 0)
+      THRandom_philoxBlock(_generator, _generator->philox_offset >> 2, _generator->philox_block);
+    return _generator->philox_block[(_generator->philox_offset++) & 3];
+  }
+
   if (--(_generator->left) == 0)
     THRandom_nextState(_generator);
   y = *(_generator->state + (_generator->next)++);
@@ -200,6 +614,100 @@ unsigned long THRandom_random(THGenerator *_generator)
   return y;
 }
 
+void THRandom_randomFill(THGenerator *_generator, uint32_t *out, long size)
+{
+  if (_generator->type == TH_GENERATOR_PHILOX)
+  {
+    THRandom_randomAt(_generator, _generator->philox_offset, out, size);
+    THRandom_skip(_generator, size);
+    return;
+  }
+
+  /* tempers the state words left, twisting the state when it is used up;
+     left-1 words remain before the next twist, as in THRandom_random() */
+  while(size > 0)
+  {
+    const unsigned long *state;
+    long i, chunk;
+    if(_generator->left == 1)
+    {
+      THRandom_nextState(_generator);
+      _generator->left = n+1;
+    }
+    chunk = (size < _generator->left-1 ? size : _generator->left-1);
+    state = _generator->state + _generator->next;
+    /* no dependency between words: the compiler vectorizes this loop */
+    for(i = 0; i < chunk; i++)
+    {
+      unsigned long y = state[i];
+      y ^= (y >> 11);
+      y ^= (y << 7) & 0x9d2c5680UL;
+      y ^= (y << 15) & 0xefc60000UL;
+      y ^= (y >> 18);
+      out[i] = (uint32_t)y;
+    }
+    _generator->next += chunk;
+    _generator->left -= chunk;
+    out += chunk;
+    size -= chunk;
+  }
+}
+
+#define TH_RANDOM_FILL_CHUNK 512
+
+void THRandom_uniformFill(THGenerator *_generator, double *out, long size, double a, double b)
+{
+  uint32_t r[TH_RANDOM_FILL_CHUNK];
+  long start, i;
+
+  for(start = 0; start < size; start += TH_RANDOM_FILL_CHUNK)
+  {
+    long chunk = (size - start < TH_RANDOM_FILL_CHUNK ? size - start : TH_RANDOM_FILL_CHUNK);
+    THRandom_randomFill(_generator, r, chunk);
+    for(i = 0; i < chunk; i++)
+      out[start+i] = (double)r[i] * (1.0/4294967296.0) * (b - a) + a;
+  }
+}
+
+void THRandom_normalFill(THGenerator *_generator, double *out, long size, double mean, double stdv)
+{
+  uint32_t r[TH_RANDOM_FILL_CHUNK];
+  long i;
+
+  THArgCheck(stdv > 0, 4, "standard deviation must be strictly positive");
+  if(size <= 0)
+    return;
+
+  /* second value of a pair started by THRandom_normal() */
+  if(_generator->normal_is_valid)
+  {
+    *out++ = _generator->normal_rho*sin(2.*M_PI*_generator->normal_x)*stdv+mean;
+    _generator->normal_is_valid = 0;
+    size--;
+  }
+
+  /* Box-Muller on whole pairs, from two uniform numbers each */
+  while(size >= 2)
+  {
+    long nPairs = (size/2 < TH_RANDOM_FILL_CHUNK/2 ? size/2 : TH_RANDOM_FILL_CHUNK/2);
+    THRandom_randomFill(_generator, r, 2*nPairs);
+    for(i = 0; i < nPairs; i++)
+    {
+      double x = (double)r[2*i] * (1.0/4294967296.0);
+      double y = (double)r[2*i+1] * (1.0/4294967296.0);
+      double rho = sqrt(-2. * log(1.0-y));
+      out[2*i] = rho*cos(2.*M_PI*x)*stdv+mean;
+      out[2*i+1] = rho*sin(2.*M_PI*x)*stdv+mean;
+    }
+    out += 2*nPairs;
+    size -= 2*nPairs;
+  }
+
+  /* an odd count leaves the second value for the next call */
+  if(size == 1)
+    *out = THRandom_normal(_generator, mean, stdv);
+}
+
 /* generates a random number on [0,1)-double-interval */
 static double __uniform__(THGenerator *_generator)
 {
@@ -2,9 +2,15 @@
 #define TH_RANDOM_INC
 
 #include "THGeneral.h"
+#include <stdint.h>
 
 #define _MERSENNE_STATE_N 624
 #define _MERSENNE_STATE_M 397
+
+/* Algorithms of THGenerator */
+#define TH_GENERATOR_MT19937 0
+#define TH_GENERATOR_PHILOX 1
+
 /* A THGenerator contains all the state required for a single random number stream */
 typedef struct THGenerator {
   /* The initial seed. */
@@ -20,18 +26,60 @@ typedef struct THGenerator {
   double normal_y;
   double normal_rho;
   int normal_is_valid; /* = 0; */
+
+  int type; /* TH_GENERATOR_MT19937 or TH_GENERATOR_PHILOX */
+
+  /* Philox4x32-10, a counter-based generator: the key is the seed, and the
+     output number philox_offset is word philox_offset%4 of the block
+     computed from the counter {philox_offset/4, philox_stream}. */
+  uint64_t philox_offset;
+  uint64_t philox_stream;
+  uint32_t philox_block[4]; /* block of the current counter */
 } THGenerator;
 
 #define torch_Generator "torch.Generator"
 
 /* Manipulate THGenerator objects */
 TH_API THGenerator * THGenerator_new(void);
+TH_API THGenerator * THGenerator_newWithType(int type);
 TH_API THGenerator * THGenerator_copy(THGenerator *self, THGenerator *from);
 TH_API void THGenerator_free(THGenerator *gen);
 
 /* Checks if given generator is valid */
 TH_API int THGenerator_isValid(THGenerator *_generator);
 
+/* Returns TH_GENERATOR_MT19937 or TH_GENERATOR_PHILOX */
+TH_API int THGenerator_type(THGenerator *_generator);
+
+/* Size of the states saved before Philox generators were added, which only
+   hold the Mersenne Twister fields, up to normal_is_valid */
+TH_API size_t THGenerator_mt19937StateSize(void);
+
+/* Copies a saved state of sizeof(THGenerator) bytes, or of
+   THGenerator_mt19937StateSize() bytes into a Mersenne Twister generator */
+TH_API THGenerator * THGenerator_copyState(THGenerator *self, const void *state, size_t size);
+
+/* Computes the Philox4x32-10 block of a counter with a key */
+TH_API void THRandom_philox(const uint32_t counter[4], const uint32_t key[2], uint32_t result[4]);
+
+/* Counter space of Philox generators: outputs can be computed in any order,
+   in parallel, without changing the generator. randomAt fills out with the
+   n outputs from number offset, and skip moves the generator n outputs ahead. */
+TH_API uint64_t THRandom_offset(THGenerator *_generator);
+TH_API void THRandom_randomAt(THGenerator *_generator, uint64_t offset, uint32_t *out, long n);
+TH_API void THRandom_skip(THGenerator *_generator, uint64_t n);
+
+/* Moves the generator 2^log2Steps numbers ahead, in time linear in
+   log2Steps (polynomial jump-ahead for Mersenne Twister generators). */
+TH_API void THRandom_jump(THGenerator *_generator, int log2Steps);
+
+/* Distance between the streams of THGenerator_split, as a power of 2 */
+#define TH_GENERATOR_SPLIT_LOG2 96
+
+/* Creates nStreams new generators, where stream i starts (i+1)*2^96 numbers
+   after self: the streams do not overlap with each other or with self. */
+TH_API void THGenerator_split(THGenerator *self, int nStreams, THGenerator **streams);
+
 /* Initializes the random number generator from /dev/urandom (or on Windows
 platforms with the current time (granularity: seconds)) and returns the seed. */
 TH_API unsigned long THRandom_seed(THGenerator *_generator);
@@ -78,4 +126,10 @@ TH_API int THRandom_geometric(THGenerator *_generator, double p);
 
 /* Returns true with probability $p$ and false with probability $1-p$ (p > 0). */
 TH_API int THRandom_bernoulli(THGenerator *_generator, double p);
+
+/* Bulk versions of THRandom_random, THRandom_uniform and THRandom_normal:
+   fill out with the same n numbers as n calls, at a fraction of the cost. */
+TH_API void THRandom_randomFill(THGenerator *_generator, uint32_t *out, long n);
+TH_API void THRandom_uniformFill(THGenerator *_generator, double *out, long n, double a, double b);
+TH_API void THRandom_normalFill(THGenerator *_generator, double *out, long n, double mean, double stdv);
 #endif
@@ -0,0 +1,359 @@
+#include "THSharedPool.h"
+
+/* TH_ATOMIC_IPC_REFCOUNT tells whether C11 atomics are lock-free */
+#if defined(USE_C11_ATOMICS)
+#include <stdatomic.h>
+#endif
+#include "THAtomic.h"
+
+#if defined(HAVE_MMAP) && defined(HAVE_SHM_OPEN) && defined(TH_ATOMIC_IPC_REFCOUNT)
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define TH_SHARED_POOL_MAGIC 0x54485350
+#define TH_SHARED_POOL_ALIGNMENT 64
+
+/* The free list head packs the index+1 of the first free block (0 when the
+   list is empty) with a tag, incremented by each update, so that a
+   compare-and-swap fails if the head was popped and pushed back meanwhile. */
+#define TH_SHARED_POOL_INDEX_BITS (sizeof(long) == 8 ? 32 : 16)
+#define TH_SHARED_POOL_INDEX_MASK ((1UL << TH_SHARED_POOL_INDEX_BITS) - 1)
+
+typedef struct {
+  int magic;
+  long freeHead;
+  long blockSize;
+  long nBlocks;
+  long nFreeBlocks;
+} THSharedPoolHeader;
+
+typedef struct {
+  int refcount;
+  long next; /* index+1 of the next free block */
+} THSharedPoolBlockInfo;
+
+struct THSharedPool_ {
+  char *name;
+  int refcount;
+  int isOwner;
+  size_t mappedSize;
+  THSharedPoolHeader *header;
+  THSharedPoolBlockInfo *blocks;
+  char *data;
+};
+
+static size_t THSharedPool_align(size_t size)
+{
+  return (size + TH_SHARED_POOL_ALIGNMENT - 1) / TH_SHARED_POOL_ALIGNMENT * TH_SHARED_POOL_ALIGNMENT;
+}
+
+static size_t THSharedPool_dataOffset(long nBlocks)
+{
+  return THSharedPool_align(THSharedPool_align(sizeof(THSharedPoolHeader)) + nBlocks*sizeof(THSharedPoolBlockInfo));
+}
+
+static THSharedPool *THSharedPool_map(const char *name, int fd, size_t size, int isOwner)
+{
+  THSharedPool *pool;
+  void *ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(ptr == MAP_FAILED)
+  {
+    if(isOwner)
+      shm_unlink(name);
+    THError("unable to map shared pool <%s>", name);
+  }
+
+  pool = THAlloc(sizeof(THSharedPool));
+  pool->name = THAlloc(strlen(name)+1);
+  strcpy(pool->name, name);
+  pool->refcount = 1;
+  pool->isOwner = isOwner;
+  pool->mappedSize = size;
+  pool->header = ptr;
+  pool->blocks = (THSharedPoolBlockInfo*)((char*)ptr + THSharedPool_align(sizeof(THSharedPoolHeader)));
+  return pool;
+}
+
+static void THSharedPool_push(THSharedPool *pool, long block)
+{
+  unsigned long head, newHead;
+  do {
+    head = (unsigned long)THAtomicGetLong(&pool->header->freeHead);
+    pool->blocks[block].next = (long)(head & TH_SHARED_POOL_INDEX_MASK);
+    newHead = (((head >> TH_SHARED_POOL_INDEX_BITS) + 1) << TH_SHARED_POOL_INDEX_BITS) | (unsigned long)(block+1);
+  } while(!THAtomicCompareAndSwapLong(&pool->header->freeHead, (long)head, (long)newHead));
+  THAtomicAddLong(&pool->header->nFreeBlocks, 1);
+}
+
+static long THSharedPool_pop(THSharedPool *pool)
+{
+  unsigned long head, newHead, index;
+  do {
+    head = (unsigned long)THAtomicGetLong(&pool->header->freeHead);
+    index = head & TH_SHARED_POOL_INDEX_MASK;
+    if(index == 0)
+      return -1;
+    /* next may be stale if the block was popped meanwhile: the tag makes the swap fail then */
+    newHead = (((head >> TH_SHARED_POOL_INDEX_BITS) + 1) << TH_SHARED_POOL_INDEX_BITS) | (unsigned long)pool->blocks[index-1].next;
+  } while(!THAtomicCompareAndSwapLong(&pool->header->freeHead, (long)head, (long)newHead));
+  THAtomicAddLong(&pool->header->nFreeBlocks, -1);
+  return (long)index-1;
+}
+
+THSharedPool *THSharedPool_new(const char *name, size_t blockSize, long nBlocks)
+{
+  THSharedPool *pool;
+  size_t dataOffset, size;
+  long i;
+  int fd;
+
+  THArgCheck(blockSize > 0, 2, "block size must be positive");
+  THArgCheck(nBlocks > 0 && (unsigned long)nBlocks < TH_SHARED_POOL_INDEX_MASK, 3, "invalid number of blocks");
+
+  blockSize = THSharedPool_align(blockSize);
+  dataOffset = THSharedPool_dataOffset(nBlocks);
+  size = dataOffset + blockSize*nBlocks;
+
+  if((fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, (mode_t)0600)) == -1)
+    THError("unable to create shared pool <%s>", name);
+  if(ftruncate(fd, size) == -1)
+  {
+    close(fd);
+    shm_unlink(name);
+    THError("unable to resize shared pool <%s> to %zu bytes", name, size);
+  }
+
+  pool = THSharedPool_map(name, fd, size, 1);
+  pool->data = (char*)pool->header + dataOffset;
+  pool->header->blockSize = (long)blockSize;
+  pool->header->nBlocks = nBlocks;
+  pool->header->nFreeBlocks = 0;
+  pool->header->freeHead = 0;
+  for(i = nBlocks-1; i >= 0; i--)
+  {
+    pool->blocks[i].refcount = 0;
+    THSharedPool_push(pool, i);
+  }
+  /* the pool can be opened once the magic is set */
+  THAtomicSet(&pool->header->magic, TH_SHARED_POOL_MAGIC);
+  return pool;
+}
+
+THSharedPool *THSharedPool_open(const char *name)
+{
+  THSharedPool *pool;
+  struct stat file_stat;
+  int fd;
+
+  if((fd = shm_open(name, O_RDWR, (mode_t)0600)) == -1)
+    THError("unable to open shared pool <%s>", name);
+  if(fstat(fd, &file_stat) == -1 || file_stat.st_size < (off_t)sizeof(THSharedPoolHeader))
+  {
+    close(fd);
+    THError("<%s> is not a shared pool", name);
+  }
+
+  pool = THSharedPool_map(name, fd, file_stat.st_size, 0);
+  if(THAtomicGet(&pool->header->magic) != TH_SHARED_POOL_MAGIC ||
+     THSharedPool_dataOffset(pool->header->nBlocks) + pool->header->blockSize*pool->header->nBlocks > pool->mappedSize)
+  {
+    THSharedPool_free(pool);
+    THError("<%s> is not a shared pool", name);
+  }
+  pool->data = (char*)pool->header + THSharedPool_dataOffset(pool->header->nBlocks);
+  return pool;
+}
+
+void THSharedPool_retain(THSharedPool *pool)
+{
+  THAtomicIncrementRef(&pool->refcount);
+}
+
+void THSharedPool_free(THSharedPool *pool)
+{
+  if(!pool || !THAtomicDecrementRef(&pool->refcount))
+    return;
+  if(munmap(pool->header, pool->mappedSize))
+    THError("could not unmap shared pool <%s>", pool->name);
+  /* processes which opened the pool keep their mapping */
+  if(pool->isOwner && shm_unlink(pool->name) == -1)
+    THError("could not unlink shared pool <%s>", pool->name);
+  THFree(pool->name);
+  THFree(pool);
+}
+
+const char *THSharedPool_name(THSharedPool *pool)
+{
+  return pool->name;
+}
+
+size_t THSharedPool_blockSize(THSharedPool *pool)
+{
+  return (size_t)pool->header->blockSize;
+}
+
+long THSharedPool_nBlocks(THSharedPool *pool)
+{
+  return pool->header->nBlocks;
+}
+
+long THSharedPool_nFreeBlocks(THSharedPool *pool)
+{
+  return THAtomicGetLong(&pool->header->nFreeBlocks);
+}
+
+long THSharedPool_acquire(THSharedPool *pool)
+{
+  long block = THSharedPool_pop(pool);
+  if(block >= 0)
+    THAtomicSet(&pool->blocks[block].refcount, 1);
+  return block;
+}
+
+void THSharedPool_incref(THSharedPool *pool, long block)
+{
+  THArgCheck(block >= 0 && block < pool->header->nBlocks, 2, "invalid block");
+  THAtomicIncrementRef(&pool->blocks[block].refcount);
+}
+
+void THSharedPool_decref(THSharedPool *pool, long block)
+{
+  THArgCheck(block >= 0 && block < pool->header->nBlocks, 2, "invalid block");
+  if(THAtomicDecrementRef(&pool->blocks[block].refcount))
+    THSharedPool_push(pool, block);
+}
+
+void *THSharedPool_data(THSharedPool *pool, long block)
+{
+  THArgCheck(block >= 0 && block < pool->header->nBlocks, 2, "invalid block");
+  return pool->data + block*pool->header->blockSize;
+}
+
+long THSharedPool_block(THSharedPool *pool, void *data)
+{
+  char *ptr = data;
+  if(ptr < pool->data || ptr >= pool->data + pool->header->nBlocks*pool->header->blockSize)
+    return -1;
+  return (long)((ptr - pool->data) / pool->header->blockSize);
+}
+
+#else
+
+THSharedPool *THSharedPool_new(const char *name, size_t blockSize, long nBlocks)
+{
+  THError("shared pools are not supported on your system");
+  return NULL;
+}
+
+THSharedPool *THSharedPool_open(const char *name)
+{
+  THError("shared pools are not supported on your system");
+  return NULL;
+}
+
+void THSharedPool_retain(THSharedPool *pool)
+{
+  THError("shared pools are not supported on your system");
+}
+
+void THSharedPool_free(THSharedPool *pool)
+{
+  THError("shared pools are not supported on your system");
+}
+
+const char *THSharedPool_name(THSharedPool *pool)
+{
+  THError("shared pools are not supported on your system");
+  return NULL;
+}
+
+size_t THSharedPool_blockSize(THSharedPool *pool)
+{
+  THError("shared pools are not supported on your system");
+  return 0;
+}
+
+long THSharedPool_nBlocks(THSharedPool *pool)
+{
+  THError("shared pools are not supported on your system");
+  return 0;
+}
+
+long THSharedPool_nFreeBlocks(THSharedPool *pool)
+{
+  THError("shared pools are not supported on your system");
+  return 0;
+}
+
+long THSharedPool_acquire(THSharedPool *pool)
+{
+  THError("shared pools are not supported on your system");
+  return -1;
+}
+
+void THSharedPool_incref(THSharedPool *pool, long block)
+{
+  THError("shared pools are not supported on your system");
+}
+
+void THSharedPool_decref(THSharedPool *pool, long block)
+{
+  THError("shared pools are not supported on your system");
+}
+
+void *THSharedPool_data(THSharedPool *pool, long block)
+{
+  THError("shared pools are not supported on your system");
+  return NULL;
+}
+
+long THSharedPool_block(THSharedPool *pool, void *data)
+{
+  THError("shared pools are not supported on your system");
+  return -1;
+}
+
+#endif
+
+static void *THSharedPoolAllocator_alloc(void *ctx, ptrdiff_t size)
+{
+  THSharedPool *pool = ctx;
+  long block;
+
+  if((size_t)size > THSharedPool_blockSize(pool))
+    THError("cannot allocate %td bytes in shared pool <%s> of %zu bytes blocks",
+            size, THSharedPool_name(pool), THSharedPool_blockSize(pool));
+  block = THSharedPool_acquire(pool);
+  if(block < 0)
+    THError("shared pool <%s> is exhausted", THSharedPool_name(pool));
+  THSharedPool_retain(pool);
+  return THSharedPool_data(pool, block);
+}
+
+/* storages can be resized within their block */
+static void *THSharedPoolAllocator_realloc(void *ctx, void *ptr, ptrdiff_t size)
+{
+  THSharedPool *pool = ctx;
+  if((size_t)size > THSharedPool_blockSize(pool))
+    THError("cannot resize to %td bytes in shared pool <%s> of %zu bytes blocks",
+            size, THSharedPool_name(pool), THSharedPool_blockSize(pool));
+  return ptr;
+}
+
+static void THSharedPoolAllocator_free(void *ctx, void *ptr)
+{
+  THSharedPool *pool = ctx;
+  THSharedPool_decref(pool, THSharedPool_block(pool, ptr));
+  THSharedPool_free(pool);
+}
+
+THAllocator THSharedPoolAllocator = {
+  &THSharedPoolAllocator_alloc,
+  &THSharedPoolAllocator_realloc,
+  &THSharedPoolAllocator_free
+};
@@ -0,0 +1,37 @@
+#ifndef TH_SHARED_POOL_INC
+#define TH_SHARED_POOL_INC
+
+#include "THGeneral.h"
+#include "THAllocator.h"
+
+/* A pool of nBlocks fixed-size blocks in one named shared memory segment,
+   mapped once by every process using it. Blocks are refcounted across
+   processes, and go back to a lock-free free list when their last
+   reference is released. */
+typedef struct THSharedPool_ THSharedPool;
+
+/* creates the segment; the name is unlinked when the creator frees the pool */
+TH_API THSharedPool *THSharedPool_new(const char *name, size_t blockSize, long nBlocks);
+/* maps the segment of an existing pool */
+TH_API THSharedPool *THSharedPool_open(const char *name);
+TH_API void THSharedPool_retain(THSharedPool *pool);
+TH_API void THSharedPool_free(THSharedPool *pool);
+
+TH_API const char *THSharedPool_name(THSharedPool *pool);
+TH_API size_t THSharedPool_blockSize(THSharedPool *pool);
+TH_API long THSharedPool_nBlocks(THSharedPool *pool);
+TH_API long THSharedPool_nFreeBlocks(THSharedPool *pool);
+
+/* returns a block with a refcount of 1, or -1 if the pool is exhausted */
+TH_API long THSharedPool_acquire(THSharedPool *pool);
+TH_API void THSharedPool_incref(THSharedPool *pool, long block);
+TH_API void THSharedPool_decref(THSharedPool *pool, long block);
+TH_API void *THSharedPool_data(THSharedPool *pool, long block);
+/* block containing data, or -1 if data is not in the pool */
+TH_API long THSharedPool_block(THSharedPool *pool, void *data);
+
+/* allocates storages in a block of the pool given as context; each storage
+   holds a reference on its block and on the pool */
+extern THAllocator THSharedPoolAllocator;
+
+#endif
@@ -0,0 +1,337 @@
+#include "THSharedQueue.h"
+
+/* TH_ATOMIC_IPC_REFCOUNT tells whether C11 atomics are lock-free */
+#if defined(USE_C11_ATOMICS)
+#include <stdatomic.h>
+#endif
+#include "THAtomic.h"
+
+#if defined(HAVE_MMAP) && defined(HAVE_SHM_OPEN) && defined(TH_ATOMIC_IPC_REFCOUNT)
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+
+#define TH_SHARED_QUEUE_MAGIC 0x54485351
+#define TH_SHARED_QUEUE_MAX_NAME 256
+#define TH_SHARED_QUEUE_CACHE_LINE 64
+
+/* Bounded queue of Dmitry Vyukov: the sequence of a cell tells whether it is
+   free for the producer at position pos (sequence == pos) or holds the item
+   for the consumer at position pos (sequence == pos+1). Producers and
+   consumers claim positions with a compare-and-swap on their own counter,
+   which live on separate cache lines. */
+typedef struct {
+  int magic;
+  long capacity;
+  char poolName[TH_SHARED_QUEUE_MAX_NAME];
+  char pad0[TH_SHARED_QUEUE_CACHE_LINE];
+  long enqueuePos;
+  char pad1[TH_SHARED_QUEUE_CACHE_LINE];
+  long dequeuePos;
+  char pad2[TH_SHARED_QUEUE_CACHE_LINE];
+} THSharedQueueHeader;
+
+typedef struct {
+  long sequence;
+  THSharedQueueItem item;
+} THSharedQueueCell;
+
+struct THSharedQueue_ {
+  char *name;
+  int isOwner;
+  size_t mappedSize;
+  THSharedPool *pool;
+  THSharedQueueHeader *header;
+  THSharedQueueCell *cells;
+};
+
+static size_t THSharedQueue_mappedSize(long capacity)
+{
+  return sizeof(THSharedQueueHeader) + capacity*sizeof(THSharedQueueCell);
+}
+
+static THSharedQueue *THSharedQueue_map(const char *name, int fd, size_t size, int isOwner)
+{
+  THSharedQueue *queue;
+  void *ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(ptr == MAP_FAILED)
+  {
+    if(isOwner)
+      shm_unlink(name);
+    THError("unable to map shared queue <%s>", name);
+  }
+
+  queue = THAlloc(sizeof(THSharedQueue));
+  queue->name = THAlloc(strlen(name)+1);
+  strcpy(queue->name, name);
+  queue->isOwner = isOwner;
+  queue->mappedSize = size;
+  queue->pool = NULL;
+  queue->header = ptr;
+  queue->cells = (THSharedQueueCell*)((char*)ptr + sizeof(THSharedQueueHeader));
+  return queue;
+}
+
+THSharedQueue *THSharedQueue_new(const char *name, THSharedPool *pool, long capacity)
+{
+  THSharedQueue *queue;
+  long roundedCapacity = 1;
+  size_t size;
+  long i;
+  int fd;
+
+  THArgCheck(capacity > 0, 3, "capacity must be positive");
+  THArgCheck(strlen(THSharedPool_name(pool)) < TH_SHARED_QUEUE_MAX_NAME, 2, "pool name is too long");
+  while(roundedCapacity < capacity)
+    roundedCapacity *= 2;
+  size = THSharedQueue_mappedSize(roundedCapacity);
+
+  if((fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, (mode_t)0600)) == -1)
+    THError("unable to create shared queue <%s>", name);
+  if(ftruncate(fd, size) == -1)
+  {
+    close(fd);
+    shm_unlink(name);
+    THError("unable to resize shared queue <%s> to %zu bytes", name, size);
+  }
+
+  queue = THSharedQueue_map(name, fd, size, 1);
+  THSharedPool_retain(pool);
+  queue->pool = pool;
+  queue->header->capacity = roundedCapacity;
+  strcpy(queue->header->poolName, THSharedPool_name(pool));
+  queue->header->enqueuePos = 0;
+  queue->header->dequeuePos = 0;
+  for(i = 0; i < roundedCapacity; i++)
+    queue->cells[i].sequence = i;
+  /* the queue can be opened once the magic is set */
+  THAtomicSet(&queue->header->magic, TH_SHARED_QUEUE_MAGIC);
+  return queue;
+}
+
+THSharedQueue *THSharedQueue_open(const char *name)
+{
+  THSharedQueue *queue;
+  struct stat file_stat;
+  int fd;
+
+  if((fd = shm_open(name, O_RDWR, (mode_t)0600)) == -1)
+    THError("unable to open shared queue <%s>", name);
+  if(fstat(fd, &file_stat) == -1 || file_stat.st_size < (off_t)sizeof(THSharedQueueHeader))
+  {
+    close(fd);
+    THError("<%s> is not a shared queue", name);
+  }
+
+  queue = THSharedQueue_map(name, fd, file_stat.st_size, 0);
+  if(THAtomicGet(&queue->header->magic) != TH_SHARED_QUEUE_MAGIC ||
+     THSharedQueue_mappedSize(queue->header->capacity) > queue->mappedSize ||
+     memchr(queue->header->poolName, '\0', TH_SHARED_QUEUE_MAX_NAME) == NULL)
+  {
+    THSharedQueue_free(queue);
+    THError("<%s> is not a shared queue", name);
+  }
+  queue->pool = THSharedPool_open(queue->header->poolName);
+  return queue;
+}
+
+void THSharedQueue_free(THSharedQueue *queue)
+{
+  if(!queue)
+    return;
+  if(munmap(queue->header, queue->mappedSize))
+    THError("could not unmap shared queue <%s>", queue->name);
+  /* processes which opened the queue keep their mapping */
+  if(queue->isOwner && shm_unlink(queue->name) == -1)
+    THError("could not unlink shared queue <%s>", queue->name);
+  THSharedPool_free(queue->pool);
+  THFree(queue->name);
+  THFree(queue);
+}
+
+const char *THSharedQueue_name(THSharedQueue *queue)
+{
+  return queue->name;
+}
+
+THSharedPool *THSharedQueue_pool(THSharedQueue *queue)
+{
+  return queue->pool;
+}
+
+long THSharedQueue_capacity(THSharedQueue *queue)
+{
+  return queue->header->capacity;
+}
+
+long THSharedQueue_size(THSharedQueue *queue)
+{
+  long size = THAtomicGetLong(&queue->header->enqueuePos) - THAtomicGetLong(&queue->header->dequeuePos);
+  return size < 0 ? 0 : (size > queue->header->capacity ? queue->header->capacity : size);
+}
+
+int THSharedQueue_tryPush(THSharedQueue *queue, const THSharedQueueItem *item)
+{
+  long mask = queue->header->capacity - 1;
+  long pos = THAtomicGetLong(&queue->header->enqueuePos);
+  THSharedQueueCell *cell;
+
+  for(;;)
+  {
+    long diff;
+    cell = &queue->cells[pos & mask];
+    diff = THAtomicGetLong(&cell->sequence) - pos;
+    if(diff == 0)
+    {
+      if(THAtomicCompareAndSwapLong(&queue->header->enqueuePos, pos, pos+1))
+        break;
+      pos = THAtomicGetLong(&queue->header->enqueuePos);
+    }
+    else if(diff < 0)
+      return 0; /* the cell still holds the item of the previous round */
+    else
+      pos = THAtomicGetLong(&queue->header->enqueuePos);
+  }
+
+  memcpy(&cell->item, item, sizeof(THSharedQueueItem));
+  /* publishes the item to the consumer of this position */
+  THAtomicSetLong(&cell->sequence, pos+1);
+  return 1;
+}
+
+int THSharedQueue_tryPop(THSharedQueue *queue, THSharedQueueItem *item)
+{
+  long mask = queue->header->capacity - 1;
+  long pos = THAtomicGetLong(&queue->header->dequeuePos);
+  THSharedQueueCell *cell;
+
+  for(;;)
+  {
+    long diff;
+    cell = &queue->cells[pos & mask];
+    diff = THAtomicGetLong(&cell->sequence) - (pos+1);
+    if(diff == 0)
+    {
+      if(THAtomicCompareAndSwapLong(&queue->header->dequeuePos, pos, pos+1))
+        break;
+      pos = THAtomicGetLong(&queue->header->dequeuePos);
+    }
+    else if(diff < 0)
+      return 0; /* the item of this position is not published yet */
+    else
+      pos = THAtomicGetLong(&queue->header->dequeuePos);
+  }
+
+  memcpy(item, &cell->item, sizeof(THSharedQueueItem));
+  /* hands the cell over to the producer of the next round */
+  THAtomicSetLong(&cell->sequence, pos+mask+1);
+  return 1;
+}
+
+/* spins first, then yields, then sleeps up to a millisecond */
+static void THSharedQueue_backoff(int *nTries)
+{
+  if(*nTries < 64)
+    (*nTries)++;
+  else if(*nTries < 128)
+  {
+    (*nTries)++;
+    sched_yield();
+  }
+  else
+  {
+    struct timespec delay;
+    delay.tv_sec = 0;
+    delay.tv_nsec = 1000L * (*nTries < 1128 ? *nTries - 127 : 1000);
+    if(*nTries < 1128)
+      (*nTries)++;
+    nanosleep(&delay, NULL);
+  }
+}
+
+void THSharedQueue_push(THSharedQueue *queue, const THSharedQueueItem *item)
+{
+  int nTries = 0;
+  while(!THSharedQueue_tryPush(queue, item))
+    THSharedQueue_backoff(&nTries);
+}
+
+void THSharedQueue_pop(THSharedQueue *queue, THSharedQueueItem *item)
+{
+  int nTries = 0;
+  while(!THSharedQueue_tryPop(queue, item))
+    THSharedQueue_backoff(&nTries);
+}
+
+#else
+
+THSharedQueue *THSharedQueue_new(const char *name, THSharedPool *pool, long capacity)
+{
+  THError("shared queues are not supported on your system");
+  return NULL;
+}
+
+THSharedQueue *THSharedQueue_open(const char *name)
+{
+  THError("shared queues are not supported on your system");
+  return NULL;
+}
+
+void THSharedQueue_free(THSharedQueue *queue)
+{
+  THError("shared queues are not supported on your system");
+}
+
+const char *THSharedQueue_name(THSharedQueue *queue)
+{
+  THError("shared queues are not supported on your system");
+  return NULL;
+}
+
+THSharedPool *THSharedQueue_pool(THSharedQueue *queue)
+{
+  THError("shared queues are not supported on your system");
+  return NULL;
+}
+
+long THSharedQueue_capacity(THSharedQueue *queue)
+{
+  THError("shared queues are not supported on your system");
+  return 0;
+}
+
+long THSharedQueue_size(THSharedQueue *queue)
+{
+  THError("shared queues are not supported on your system");
+  return 0;
+}
+
+int THSharedQueue_tryPush(THSharedQueue *queue, const THSharedQueueItem *item)
+{
+  THError("shared queues are not supported on your system");
+  return 0;
+}
+
+int THSharedQueue_tryPop(THSharedQueue *queue, THSharedQueueItem *item)
+{
+  THError("shared queues are not supported on your system");
+  return 0;
+}
+
+void THSharedQueue_push(THSharedQueue *queue, const THSharedQueueItem *item)
+{
+  THError("shared queues are not supported on your system");
+}
+
+void THSharedQueue_pop(THSharedQueue *queue, THSharedQueueItem *item)
+{
+  THError("shared queues are not supported on your system");
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef TH_SHARED_QUEUE_INC
+#define TH_SHARED_QUEUE_INC
+
+#include "THGeneral.h"
+#include "THSharedPool.h"
+
+#define TH_SHARED_QUEUE_MAX_DIMENSION 16
+
+/* A tensor queued by reference: the storage lives in a block of a
+   THSharedPool, of which the item holds a reference. */
+typedef struct THSharedQueueItem
+{
+  long block;
+  int type;
+  int nDimension;
+  long storageOffset;
+  long size[TH_SHARED_QUEUE_MAX_DIMENSION];
+} THSharedQueueItem;
+
+/* A bounded multi-producer multi-consumer queue of items in a named shared
+   memory segment, lock-free (one compare-and-swap per operation). The queue
+   records the name of the pool holding the storages of its items. */
+typedef struct THSharedQueue_ THSharedQueue;
+
+/* capacity is rounded up to a power of 2; the name is unlinked when the
+   creator frees the queue */
+TH_API THSharedQueue *THSharedQueue_new(const char *name, THSharedPool *pool, long capacity);
+/* maps an existing queue, and opens its pool */
+TH_API THSharedQueue *THSharedQueue_open(const char *name);
+TH_API void THSharedQueue_free(THSharedQueue *queue);
+
+TH_API const char *THSharedQueue_name(THSharedQueue *queue);
+TH_API THSharedPool *THSharedQueue_pool(THSharedQueue *queue);
+TH_API long THSharedQueue_capacity(THSharedQueue *queue);
+/* approximate when other processes use the queue */
+TH_API long THSharedQueue_size(THSharedQueue *queue);
+
+/* return 0 if the queue is full (resp. empty) */
+TH_API int THSharedQueue_tryPush(THSharedQueue *queue, const THSharedQueueItem *item);
+TH_API int THSharedQueue_tryPop(THSharedQueue *queue, THSharedQueueItem *item);
+
+/* wait until there is room (resp. an item) */
+TH_API void THSharedQueue_push(THSharedQueue *queue, const THSharedQueueItem *item);
+TH_API void THSharedQueue_pop(THSharedQueue *queue, THSharedQueueItem *item);
+
+#endif
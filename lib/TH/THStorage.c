@@ -1,6 +1,94 @@
 #include "THAtomic.h"
 #include "THStorage.h"
 
+/* 64-bit content hash (the xxHash64 algorithm): four independent lanes
+   consume 32 bytes per step, so it runs close to memory bandwidth. It is
+   meant to detect changed storages, not to be cryptographically secure. */
+#define TH_HASH_PRIME1 11400714785074694791ULL
+#define TH_HASH_PRIME2 14029467366897019727ULL
+#define TH_HASH_PRIME3  1609587929392839161ULL
+#define TH_HASH_PRIME4  9650029242287828579ULL
+#define TH_HASH_PRIME5  2870177450012600261ULL
+#define TH_HASH_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t THStorage_hashRead64(const unsigned char *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t THStorage_hashRound(uint64_t acc, uint64_t input)
+{
+  acc += input * TH_HASH_PRIME2;
+  acc = TH_HASH_ROTL(acc, 31);
+  return acc * TH_HASH_PRIME1;
+}
+
+static uint64_t THStorage_hashMerge(uint64_t acc, uint64_t val)
+{
+  acc ^= THStorage_hashRound(0, val);
+  return acc * TH_HASH_PRIME1 + TH_HASH_PRIME4;
+}
+
+static uint64_t THStorage_hashBytes(const void *data, size_t size)
+{
+  const unsigned char *p = (const unsigned char*)data;
+  const unsigned char *end = p + size;
+  uint64_t h;
+
+  if(size >= 32)
+  {
+    const unsigned char *limit = end - 32;
+    uint64_t v1 = TH_HASH_PRIME1 + TH_HASH_PRIME2;
+    uint64_t v2 = TH_HASH_PRIME2;
+    uint64_t v3 = 0;
+    uint64_t v4 = -TH_HASH_PRIME1;
+    do {
+      v1 = THStorage_hashRound(v1, THStorage_hashRead64(p));
+      v2 = THStorage_hashRound(v2, THStorage_hashRead64(p+8));
+      v3 = THStorage_hashRound(v3, THStorage_hashRead64(p+16));
+      v4 = THStorage_hashRound(v4, THStorage_hashRead64(p+24));
+      p += 32;
+    } while(p <= limit);
+    h = TH_HASH_ROTL(v1, 1) + TH_HASH_ROTL(v2, 7) + TH_HASH_ROTL(v3, 12) + TH_HASH_ROTL(v4, 18);
+    h = THStorage_hashMerge(h, v1);
+    h = THStorage_hashMerge(h, v2);
+    h = THStorage_hashMerge(h, v3);
+    h = THStorage_hashMerge(h, v4);
+  }
+  else
+    h = TH_HASH_PRIME5;
+
+  h += (uint64_t)size;
+
+  for(; p + 8 <= end; p += 8)
+  {
+    h ^= THStorage_hashRound(0, THStorage_hashRead64(p));
+    h = TH_HASH_ROTL(h, 27) * TH_HASH_PRIME1 + TH_HASH_PRIME4;
+  }
+  if(p + 4 <= end)
+  {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    h ^= (uint64_t)v * TH_HASH_PRIME1;
+    h = TH_HASH_ROTL(h, 23) * TH_HASH_PRIME2 + TH_HASH_PRIME3;
+    p += 4;
+  }
+  for(; p < end; p++)
+  {
+    h ^= (*p) * TH_HASH_PRIME5;
+    h = TH_HASH_ROTL(h, 11) * TH_HASH_PRIME1;
+  }
+
+  h ^= h >> 33;
+  h *= TH_HASH_PRIME2;
+  h ^= h >> 29;
+  h *= TH_HASH_PRIME3;
+  h ^= h >> 32;
+  return h;
+}
+
 #include "generic/THStorage.c"
 #include "THGenerateAllTypes.h"
 
@@ -14,6 +102,29 @@
 #include "THGenerateHalfType.h"
 
 
+static void *THCharStorageView_malloc(void *ctx, ptrdiff_t size)
+{
+  THError("cannot allocate a view of a CharStorage");
+  return NULL;
+}
+
+static void *THCharStorageView_realloc(void *ctx, void *ptr, ptrdiff_t size)
+{
+  THError("cannot resize a view of a CharStorage");
+  return NULL;
+}
+
+static void THCharStorageView_free(void *ctx, void *ptr)
+{
+  THCharStorage_free((THCharStorage*)ctx);
+}
+
+THAllocator THCharStorageViewAllocator = {
+  THCharStorageView_malloc,
+  THCharStorageView_realloc,
+  THCharStorageView_free
+};
+
 THDescBuff THLongStorage_sizeDesc(const THLongStorage *size) {
   return _THSizeDesc(size->data, size->size);
 }
@@ -4,6 +4,8 @@
 #include "THGeneral.h"
 #include "THAllocator.h"
 
+#include <stdint.h>
+
 #define THStorage        TH_CONCAT_3(TH,Real,Storage)
 #define THStorage_(NAME) TH_CONCAT_4(TH,Real,Storage_,NAME)
 
@@ -23,6 +25,10 @@
 #include "generic/THStorageCopy.h"
 #include "THGenerateHalfType.h"
 
+/* allocator of storages whose data points into a CharStorage (the allocator
+   context, which must be retained, and is released when they are freed) */
+extern THAllocator THCharStorageViewAllocator;
+
 TH_API THDescBuff THLongStorage_sizeDesc(const THLongStorage *size);
 TH_API THLongStorage *THLongStorage_newInferSize(THLongStorage *size, ptrdiff_t nElement);
 
@@ -2,10 +2,12 @@
 #include "THTensor.h"
 #include "THVector.h"
 #include "generic/simd/simd.h"
+#include "generic/simd/convolve.h"
 
 #include "THBlas.h"
 #include "THLapack.h"
 #include "THRandom.h"
+#include "THFFT.h"
 #include "THTensorDimApply.h"
 #include "THMath.h"
 
@@ -27,6 +29,20 @@
 #include "generic/THTensorMath.c"
 #include "THGenerateAllTypes.h"
 
+static int THConvWinograd = TH_CONV_WINOGRAD_AUTO;
+
+void THSetConvWinograd(int tile)
+{
+  THArgCheck(tile == TH_CONV_WINOGRAD_AUTO || tile == 0 || tile == 2 || tile == 4, 1,
+             "Winograd tile size should be 0, 2 or 4");
+  THConvWinograd = tile;
+}
+
+int THGetConvWinograd(void)
+{
+  return THConvWinograd;
+}
+
 #include "generic/THTensorConv.c"
 #include "THGenerateAllTypes.h"
 
@@ -35,6 +35,13 @@
 #include "generic/THTensorConv.h"
 #include "THGenerateAllTypes.h"
 
+/* output tile size (2 or 4) of the Winograd convolutions of 3x3 kernels done
+   by conv2Dmv and conv2Dmm, 0 for none, or TH_CONV_WINOGRAD_AUTO (the
+   default) to use them for shapes where they pay off */
+#define TH_CONV_WINOGRAD_AUTO -1
+TH_API void THSetConvWinograd(int tile);
+TH_API int THGetConvWinograd(void);
+
 /* lapack support */
 #include "generic/THTensorLapack.h"
 #include "THGenerateFloatTypes.h"
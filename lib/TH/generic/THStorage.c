@@ -57,6 +57,42 @@ THStorage* THStorage_(newWithMapping)(const char *filename, ptrdiff_t size, int
   return storage;
 }
 
+THStorage* THStorage_(newWithFd)(int fd, ptrdiff_t size, int flags)
+{
+  THMapAllocatorContext *ctx = THMapAllocatorContext_newWithFd(NULL, fd,
+      flags | TH_ALLOCATOR_MAPPED_FROMFD | TH_ALLOCATOR_MAPPED_KEEPFD);
+
+  THStorage *storage = THStorage_(newWithAllocator)(size,
+                                                    &THMapAllocator,
+                                                    ctx);
+
+  if(size <= 0)
+    storage->size = THMapAllocatorContext_size(ctx)/sizeof(real);
+
+  THStorage_(clearFlag)(storage, TH_STORAGE_RESIZABLE);
+
+  return storage;
+}
+
+int THStorage_(fd)(const THStorage *storage)
+{
+  if(storage->allocator != &THMapAllocator)
+    return -1;
+  return THMapAllocatorContext_fd(storage->allocatorContext);
+}
+
+void THStorage_(prefetch)(THStorage *storage, ptrdiff_t offset, ptrdiff_t size)
+{
+  THStorage *mapped = storage;
+  THArgCheck(offset >= 0 && offset <= storage->size, 2, "offset out of bounds");
+  THArgCheck(size >= 0 && size <= storage->size - offset, 3, "size out of bounds");
+
+  while(mapped->flag & TH_STORAGE_VIEW)
+    mapped = mapped->view;
+  if(mapped->allocator == &THMapAllocator || mapped->allocator == &THRefcountedMapAllocator)
+    THMapAllocator_advise(storage->data + offset, size*sizeof(real), TH_ALLOCATOR_MAPPED_WILLNEED);
+}
+
 THStorage* THStorage_(newWithSize1)(real data0)
 {
   THStorage *self = THStorage_(newWithSize)(1);
@@ -191,6 +227,11 @@ void THStorage_(fill)(THStorage *storage, real value)
     storage->data[i] = value;
 }
 
+uint64_t THStorage_(hash)(const THStorage *storage)
+{
+  return THStorage_hashBytes(storage->data, storage->size*sizeof(real));
+}
+
 void THStorage_(set)(THStorage *self, ptrdiff_t idx, real value)
 {
   THArgCheck((idx >= 0) && (idx < self->size), 2, "out of bounds");
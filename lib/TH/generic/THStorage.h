@@ -47,6 +47,12 @@ TH_API THStorage* THStorage_(newWithSize2)(real, real);
 TH_API THStorage* THStorage_(newWithSize3)(real, real, real);
 TH_API THStorage* THStorage_(newWithSize4)(real, real, real, real);
 TH_API THStorage* THStorage_(newWithMapping)(const char *filename, ptrdiff_t size, int flags);
+/* maps a file descriptor, which the storage takes ownership of */
+TH_API THStorage* THStorage_(newWithFd)(int fd, ptrdiff_t size, int flags);
+/* file descriptor kept by a mapped storage, or -1 */
+TH_API int THStorage_(fd)(const THStorage *storage);
+/* starts reading ahead size elements from offset if the storage is mapped */
+TH_API void THStorage_(prefetch)(THStorage *storage, ptrdiff_t offset, ptrdiff_t size);
 
 /* takes ownership of data */
 TH_API THStorage* THStorage_(newWithData)(real *data, ptrdiff_t size);
@@ -68,4 +74,7 @@ TH_API void THStorage_(free)(THStorage *storage);
 TH_API void THStorage_(resize)(THStorage *storage, ptrdiff_t size);
 TH_API void THStorage_(fill)(THStorage *storage, real value);
 
+/* 64-bit hash of the storage content, to tell whether it has changed */
+TH_API uint64_t THStorage_(hash)(const THStorage *storage);
+
 #endif
@@ -16,6 +16,12 @@ void THTensor_(validXCorr2Dptr)(real *r_,
 
   long xx, yy, kx, ky;
 
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  /* kernels of up to CONVOLVE_MAX_COLS columns, with the SIMD kernels of the host */
+  if (sc == 1 && TH_CONCAT_2(convolve_valid_, real)(r_, alpha, t_, ir, ic, k_, kr, kc, sr))
+    return;
+#endif
+
   if ((sc != 1) || (oc < 4))  {
     /* regular convolution */
     for(yy = 0; yy < or; yy++) {
@@ -69,6 +75,19 @@ void THTensor_(validConv2Dptr)(real *r_,
 
   long xx, yy, kx, ky;
 
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  /* cross-correlation by the flipped kernel, with the SIMD kernels of the host */
+  if (sc == 1 && kc <= CONVOLVE_MAX_COLS && kr <= CONVOLVE_MAX_COLS)
+  {
+    real flipped[CONVOLVE_MAX_COLS*CONVOLVE_MAX_COLS];
+    long l;
+    for(l = 0; l < kr*kc; l++)
+      flipped[l] = k_[kr*kc-1-l];
+    if (TH_CONCAT_2(convolve_valid_, real)(r_, alpha, t_, ir, ic, flipped, kr, kc, sr))
+      return;
+  }
+#endif
+
   if ((sc != 1) || (oc < 4))  {
     /* regular convolution */
     for(yy = 0; yy < or; yy++) {
@@ -265,6 +284,8 @@ void THTensor_(validXCorr2DRevptr)(real *r_,
 }
 /*
   3D Input, 3D kernel  : convolve given volume with the given kernel.
+  Each output slice is a sum of 2D passes over the kt input slices it sees,
+  so that it stays in cache while they stream through the 2D kernels.
 */
 void THTensor_(validXCorr3Dptr)(real *r_,
                                        real alpha,
@@ -276,35 +297,16 @@ void THTensor_(validXCorr3Dptr)(real *r_,
   long or = (ir - kr) / sr + 1;
   long oc = (ic - kc) / sc + 1;
 
-  long zz, xx, yy;
+  long zz;
 
+#pragma omp parallel for if(ot*or*oc*kt*kr*kc > TH_OMP_OVERHEAD_THRESHOLD) private(zz)
   for (zz = 0; zz < ot; zz++)
   {
-    for(yy = 0; yy < or; yy++)
-    {
-      for(xx = 0; xx < oc; xx++)
-      {
-        /* Dot product in two dimensions... (between input image and the mask) */
-        real *pi_ = t_ + zz*st*ir*ic + yy*sr*ic + xx*sc;
-        real *pw_ = k_;
-        real sum = 0;
-        long kz, kx, ky;
-        for(kz = 0; kz < kt; kz++)
-        {
-          for(ky = 0; ky < kr; ky++)
-          {
-            for(kx = 0; kx < kc; kx++) {
-              sum += pi_[kx]*pw_[kx];
-            }
-            pi_ += ic; /* next input line */
-            pw_ += kc; /* next mask line */
-          }
-          pi_ += (ir-kr)*ic; /* next input slice */
-        }
-        /* Update output */
-        *r_++ += sum*alpha;
-      }
-    }
+    long kz;
+    for(kz = 0; kz < kt; kz++)
+      THTensor_(validXCorr2Dptr)(r_ + zz*or*oc, alpha,
+                                 t_ + (zz*st+kz)*ir*ic, ir, ic,
+                                 k_ + kz*kr*kc, kr, kc, sr, sc);
   }
 }
 
@@ -321,41 +323,23 @@ void THTensor_(validConv3Dptr)(real *r_,
   long or = (ir - kr) / sr + 1;
   long oc = (ic - kc) / sc + 1;
 
-  long zz, xx, yy;
+  long zz;
 
+#pragma omp parallel for if(ot*or*oc*kt*kr*kc > TH_OMP_OVERHEAD_THRESHOLD) private(zz)
   for(zz = 0; zz < ot; zz++)
   {
-    for(yy = 0; yy < or; yy++)
-    {
-      for(xx = 0; xx < oc; xx++)
-      {
-        /* Dot product in two dimensions... (between input image and the mask) */
-        real *pi_ = t_ + zz*st*ir*ic + yy*sr*ic + xx*sc;
-        real *pw_ = k_ + kt*kr*kc - 1;
-        real sum = 0;
-        long kz, kx, ky;
-        for(kz = 0; kz < kt; kz++)
-        {
-          for(ky = 0; ky < kr; ky++)
-          {
-            for(kx = 0; kx < kc; kx++) {
-              sum += pi_[kx]*pw_[-kx];
-            }
-            pi_ += ic; /* next input line */
-            pw_ -= kc; /* next mask line */
-          }
-          pi_ += (ir-kr)*ic; /* next input slice */
-        }
-        /* Update output */
-        *r_++ += alpha*sum;
-      }
-    }
+    long kz;
+    for(kz = 0; kz < kt; kz++)
+      THTensor_(validConv2Dptr)(r_ + zz*or*oc, alpha,
+                                t_ + (zz*st+kz)*ir*ic, ir, ic,
+                                k_ + (kt-1-kz)*kr*kc, kr, kc, sr, sc);
   }
 }
 
 
 /*
   3D Input, 3D kernel  : convolve given volume with the given kernel, full convolution.
+  Each output slice gathers the 2D passes of the input slices that reach it.
 */
 void THTensor_(fullConv3Dptr)(real *r_,
                                      real alpha,
@@ -363,41 +347,24 @@ void THTensor_(fullConv3Dptr)(real *r_,
                                      real *k_, long kt, long kr, long kc,
                                      long st, long sr, long sc)
 {
+  long ot = (it - 1) * st + kt;
   long or = (ir - 1) * sr + kr;
   long oc = (ic - 1) * sc + kc;
 
-  long zz, xx, yy;
+  long zz;
 
-  for(zz = 0; zz < it; zz++)
+#pragma omp parallel for if(it*ir*ic*kt*kr*kc > TH_OMP_OVERHEAD_THRESHOLD) private(zz)
+  for(zz = 0; zz < ot; zz++)
   {
-    for(yy = 0; yy < ir; yy++)
+    long kz;
+    for(kz = 0; kz < kt; kz++)
     {
-      for(xx = 0; xx < ic; xx++)
-      {
-        /* Outer product in two dimensions... (between input image and the mask) */
-        real *po_ = r_ + zz*st*or*oc + yy*sr*oc + xx*sc;
-        real *pw_ = k_;
-        long kz, kx, ky;
-        /* printf("Output Plane : %ld,%ld,%ld, input val=%g\n",zz,yy,xx,*t_); */
-        for(kz = 0; kz < kt; kz++)
-        {
-          for(ky = 0; ky < kr; ky++)
-          {
-            real z = *t_ * alpha;
-            for(kx = 0; kx < kc; kx++) {
-              /* printf("o=%g,k=%g," , po_[kx],pw_[kx]); */
-              po_[kx] += z * pw_[kx];
-              /* printf("o=%g " , po_[kx]); */
-            }
-            /* printf("\n"); */
-            po_ += oc; /* next input line */
-            pw_ += kc; /* next mask line */
-          }
-          po_ += (or-kr)*oc; /* next output slice */
-          /* printf("\n"); */
-        }
-        t_++;
-      }
+      long iz = zz - kz;
+      if (iz < 0 || iz % st != 0 || iz / st >= it)
+        continue;
+      THTensor_(fullConv2Dptr)(r_ + zz*or*oc, alpha,
+                               t_ + (iz/st)*ir*ic, ir, ic,
+                               k_ + kz*kr*kc, kr, kc, sr, sc);
     }
   }
 }
@@ -411,36 +378,24 @@ void THTensor_(fullXCorr3Dptr)(real *r_,
                                       real *k_, long kt, long kr, long kc,
                                       long st, long sr, long sc)
 {
+  long ot = (it - 1) * st + kt;
   long or = (ir - 1) * sr + kr;
   long oc = (ic - 1) * sc + kc;
 
-  long zz, xx, yy;
+  long zz;
 
-  for(zz = 0; zz < it; zz++)
+#pragma omp parallel for if(it*ir*ic*kt*kr*kc > TH_OMP_OVERHEAD_THRESHOLD) private(zz)
+  for(zz = 0; zz < ot; zz++)
   {
-    for(yy = 0; yy < ir; yy++)
+    long kz;
+    for(kz = 0; kz < kt; kz++)
     {
-      for(xx = 0; xx < ic; xx++)
-      {
-        /* Outer product in two dimensions... (between input image and the mask) */
-        real *po_ = r_ + zz*st*or*oc + yy*sr*oc + xx*sc;
-        real *pw_ = k_ + kt*kr*kc -1;
-        long kz, kx, ky;
-        for(kz = 0; kz < kt; kz++)
-        {
-          for(ky = 0; ky < kr; ky++)
-          {
-            real z = *t_ * alpha;
-            for(kx = 0; kx < kc; kx++) {
-              po_[kx] += z * pw_[-kx];
-            }
-            po_ += oc; /* next input line */
-            pw_ -= kc; /* next mask line */
-          }
-          po_ += (or-kr)*oc; /* next output slice */
-        }
-        t_++;
-      }
+      long iz = zz - kz;
+      if (iz < 0 || iz % st != 0 || iz / st >= it)
+        continue;
+      THTensor_(fullXCorr2Dptr)(r_ + zz*or*oc, alpha,
+                                t_ + (iz/st)*ir*ic, ir, ic,
+                                k_ + (kt-1-kz)*kr*kc, kr, kc, sr, sc);
     }
   }
 }
@@ -460,30 +415,16 @@ void THTensor_(validXCorr3DRevptr)(real *r_,
   long or = ir - (kr - 1) * sr;
   long oc = ic - (kc - 1) * sc;
 
-  long zz, xx, yy;
-  for(zz = 0; zz < kt; zz++)
+  long zz;
+
+#pragma omp parallel for if(ot*or*oc*kt*kr*kc > TH_OMP_OVERHEAD_THRESHOLD) private(zz)
+  for(zz = 0; zz < ot; zz++)
   {
-    for(yy = 0; yy < kr; yy++)
-    {
-      for(xx = 0; xx < kc; xx++)
-      {
-        real *po_ = r_;
-        real *pi_ = t_ + zz*st*ir*ic + yy*sr*ic + xx*sc;
-        real z = *k_++ * alpha;
-        long kz, kx, ky;
-        for(kz = 0; kz < ot; kz++)
-        {
-          for(ky = 0; ky < or; ky++)
-          {
-            for(kx = 0; kx < oc; kx++)
-              po_[kx] += z * pi_[kx];
-            pi_ += ic;
-            po_ += oc;
-          }
-          pi_ += (ir-or)*ic; /* next input slice */
-        }
-      }
-    }
+    long kz;
+    for(kz = 0; kz < kt; kz++)
+      THTensor_(validXCorr2DRevptr)(r_ + zz*or*oc, alpha,
+                                    t_ + (kz*st+zz)*ir*ic, ir, ic,
+                                    k_ + kz*kr*kc, kr, kc, sr, sc);
   }
 }
 
@@ -570,6 +511,561 @@ long THTensor_(convsize)(long x, long k, long s, const char* vf)
     return (x-1)*s + k;
 }
 
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+
+/*
+  Valid convolutions of many planes as matrix products: the input patches of
+  a band of output rows are unfolded in columns (im2col), and multiplied by
+  the matrix of the kernels with THBlas_(gemm). The direct loops read each
+  input plane once per output plane, the product keeps the band in cache.
+*/
+#define CONV_GEMM_MIN_PLANES 4
+#define CONV_GEMM_MIN_PRODUCT 64
+#define CONV_GEMM_BAND_SIZE (1 << 18)
+/* larger workspaces, for bands of a single very long row, are not kept */
+#define CONV_WORKSPACE_MAX_CACHED (1 << 20)
+
+#ifdef TH_HAVE_THREAD
+/* unfolded bands of the calling thread, kept between calls */
+static TH_THREAD_LOCAL real *THTensor_(convWorkspaceData) = NULL;
+static TH_THREAD_LOCAL ptrdiff_t THTensor_(convWorkspaceSize) = 0;
+#endif
+
+static real *THTensor_(convWorkspace)(ptrdiff_t size)
+{
+#ifdef TH_HAVE_THREAD
+  if(size > CONV_WORKSPACE_MAX_CACHED)
+    return THAlloc(size*sizeof(real));
+  if(size > THTensor_(convWorkspaceSize))
+  {
+    THFree(THTensor_(convWorkspaceData));
+    THTensor_(convWorkspaceData) = THAlloc(size*sizeof(real));
+    THTensor_(convWorkspaceSize) = size;
+  }
+  return THTensor_(convWorkspaceData);
+#else
+  return THAlloc(size*sizeof(real));
+#endif
+}
+
+static void THTensor_(convWorkspaceRelease)(real *workspace)
+{
+#ifdef TH_HAVE_THREAD
+  if(workspace != THTensor_(convWorkspaceData))
+    THFree(workspace);
+#else
+  THFree(workspace);
+#endif
+}
+
+/* whether a valid convolution of nInputPlane planes into nOutputPlane planes
+   goes through the unfolded product rather than the direct loops */
+static int THTensor_(convUseGemm)(long nInputPlane, long nOutputPlane, long kr, long kc, const char *vf)
+{
+  return *vf == 'V' && nOutputPlane >= CONV_GEMM_MIN_PLANES && kr*kc > 1
+    && nInputPlane*nOutputPlane*kr*kc >= CONV_GEMM_MIN_PRODUCT;
+}
+
+/*
+  Kernels of nOutputPlane x nInputPlane planes as a nOutputPlane x
+  (nInputPlane*kr*kc) matrix, flipped for convolutions. Contiguous kernels of
+  cross-correlations are used in place.
+*/
+static real *THTensor_(convPackKernels)(real *k_, long nOutputPlane, long nInputPlane, long kr, long kc,
+                                        long kstride0, long kstride1, const char *xc)
+{
+  long k;
+  real *w;
+
+  if(*xc == 'X' && kstride1 == kr*kc && kstride0 == nInputPlane*kr*kc)
+    return k_;
+
+  w = THAlloc(nOutputPlane*nInputPlane*kr*kc*sizeof(real));
+#pragma omp parallel for if(nOutputPlane*nInputPlane*kr*kc > TH_OMP_OVERHEAD_THRESHOLD) private(k)
+  for(k = 0; k < nOutputPlane; k++)
+  {
+    long i, l;
+    for(i = 0; i < nInputPlane; i++)
+    {
+      real *src = k_ + k*kstride0 + i*kstride1;
+      real *dst = w + (k*nInputPlane + i)*kr*kc;
+      if(*xc == 'X')
+        memcpy(dst, src, kr*kc*sizeof(real));
+      else
+        for(l = 0; l < kr*kc; l++)
+          dst[l] = src[kr*kc-1-l];
+    }
+  }
+  return w;
+}
+
+static void THTensor_(convReleaseKernels)(real *w, real *k_)
+{
+  if(w != k_)
+    THFree(w);
+}
+
+/*
+  Unfolds the input patches of output rows [row0, row0+nRows): row
+  (i*kr + ky)*kc + kx of cols holds input plane i, shifted by (ky, kx), at
+  each output pixel of the band.
+*/
+static void THTensor_(unfold2d)(real *cols, real *t_, long nInputPlane, long ir, long ic,
+                                long kr, long kc, long sr, long sc, long row0, long nRows, long oc)
+{
+  long l;
+
+  for(l = 0; l < nInputPlane*kr*kc; l++)
+  {
+    long i = l/(kr*kc), ky = (l/kc)%kr, kx = l%kc;
+    real *dst = cols + l*nRows*oc;
+    long yy, xx;
+    for(yy = 0; yy < nRows; yy++)
+    {
+      real *src = t_ + i*ir*ic + ((row0+yy)*sr + ky)*ic + kx;
+      if(sc == 1)
+        memcpy(dst, src, oc*sizeof(real));
+      else
+        for(xx = 0; xx < oc; xx++)
+          dst[xx] = src[xx*sc];
+      dst += oc;
+    }
+  }
+}
+
+/*
+  r_[k] += alpha * sum_i validXCorr2D(t_[i], w[k][i]) for the nOutputPlane
+  planes of r_, rstride0 apart, with the packed kernels w.
+*/
+static void THTensor_(unfoldGemm2d)(real *r_, long rstride0, real alpha,
+                                    real *t_, long nInputPlane, long ir, long ic,
+                                    real *w, long nOutputPlane, long kr, long kc,
+                                    long sr, long sc)
+{
+  long or = (ir - kr) / sr + 1;
+  long oc = (ic - kc) / sc + 1;
+  long m = nInputPlane*kr*kc;
+  long bandRows = THMax(1, THMin(or, CONV_GEMM_BAND_SIZE/(m*oc)));
+  real *cols = THTensor_(convWorkspace)((ptrdiff_t)m*bandRows*oc);
+  long row0;
+
+  for(row0 = 0; row0 < or; row0 += bandRows)
+  {
+    long nRows = THMin(bandRows, or - row0);
+    THTensor_(unfold2d)(cols, t_, nInputPlane, ir, ic, kr, kc, sr, sc, row0, nRows, oc);
+    /* column-major: (pixels x m) * (m x nOutputPlane) */
+    THBlas_(gemm)('n', 'n', nRows*oc, nOutputPlane, m,
+                  alpha, cols, nRows*oc, w, m,
+                  1, r_ + row0*oc, rstride0);
+  }
+  THTensor_(convWorkspaceRelease)(cols);
+}
+
+#endif
+
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+
+/*
+  Winograd convolutions F(m x m, 3 x 3): the m x m output tile at (y, x) is
+  A^T [(G g G^T) .* (B^T d B)] A, with d the (m+2) x (m+2) input tile at
+  (y, x). Summed over input planes, each of the (m+2)^2 points of the
+  transformed tiles is a matrix product of the transformed kernels by the
+  transformed input tiles, done with THBlas_(gemm): (m+2)^2 instead of 9 m^2
+  multiplications per tile and pair of planes.
+*/
+#define CONV_WINOGRAD_MIN_PLANES 32
+#define CONV_WINOGRAD_MIN_TILES 64
+#define CONV_WINOGRAD_BAND_SIZE (1 << 18)
+
+/* output tile size of the valid 3x3 convolution of nBatch images, 0 when
+   the kernel transforms and tile products would not pay off */
+static int THTensor_(convWinogradTile)(long nBatch, long nInputPlane, long nOutputPlane,
+                                       long nOutputRows, long nOutputCols,
+                                       long kr, long kc, long sr, long sc, const char *vf)
+{
+  int tile = THGetConvWinograd();
+
+  if(*vf != 'V' || kr != 3 || kc != 3 || sr != 1 || sc != 1)
+    return 0;
+  if(tile != TH_CONV_WINOGRAD_AUTO)
+    return tile;
+  if(nInputPlane < CONV_WINOGRAD_MIN_PLANES || nOutputPlane < CONV_WINOGRAD_MIN_PLANES
+     || nBatch*((nOutputRows+3)/4)*((nOutputCols+3)/4) < CONV_WINOGRAD_MIN_TILES)
+    return 0;
+  return 4;
+}
+
+/* 1D transforms of F(m, 3), m = 2 or 4, from elements d[l*ds] to o[l*os]:
+   B^T d of m+2 inputs, G g of the 3 kernel elements, A^T d of m+2 products */
+static inline void THTensor_(winogradInput1d)(real *o, long os, const real *d, long ds, int m)
+{
+  if(m == 2)
+  {
+    o[0]    = d[0]    - d[2*ds];
+    o[os]   = d[ds]   + d[2*ds];
+    o[2*os] = d[2*ds] - d[ds];
+    o[3*os] = d[ds]   - d[3*ds];
+  }
+  else
+  {
+    real d1 = d[ds], d2 = d[2*ds], d3 = d[3*ds], d4 = d[4*ds];
+    o[0]    = 4*d[0] - 5*d2 + d4;
+    o[os]   = d3 + d4 - 4*(d1 + d2);
+    o[2*os] = d4 - d3 + 4*(d1 - d2);
+    o[3*os] = d4 - d2 + 2*(d3 - d1);
+    o[4*os] = d4 - d2 + 2*(d1 - d3);
+    o[5*os] = 4*d1 - 5*d3 + d[5*ds];
+  }
+}
+
+static inline void THTensor_(winogradKernel1d)(real *o, long os, const real *g, long gs, int m)
+{
+  real g0 = g[0], g1 = g[gs], g2 = g[2*gs];
+  if(m == 2)
+  {
+    o[0]    = g0;
+    o[os]   = (g0 + g1 + g2)/2;
+    o[2*os] = (g0 - g1 + g2)/2;
+    o[3*os] = g2;
+  }
+  else
+  {
+    o[0]    = g0/4;
+    o[os]   = -(g0 + g1 + g2)/6;
+    o[2*os] = -(g0 - g1 + g2)/6;
+    o[3*os] = (g0/4 + g1/2 + g2)/6;
+    o[4*os] = (g0/4 - g1/2 + g2)/6;
+    o[5*os] = g2;
+  }
+}
+
+static inline void THTensor_(winogradOutput1d)(real *o, long os, const real *d, long ds, int m)
+{
+  if(m == 2)
+  {
+    o[0]  = d[0]  + d[ds] + d[2*ds];
+    o[os] = d[ds] - d[2*ds] - d[3*ds];
+  }
+  else
+  {
+    real s12 = d[ds] + d[2*ds], d12 = d[ds] - d[2*ds];
+    real s34 = d[3*ds] + d[4*ds], d34 = d[3*ds] - d[4*ds];
+    o[0]    = d[0] + s12 + s34;
+    o[os]   = d12 + 2*d34;
+    o[2*os] = s12 + 4*s34;
+    o[3*os] = d12 + 8*d34 + d[5*ds];
+  }
+}
+
+/*
+  Transformed kernels: point xy of kernel (k, i) at w[(xy*nOutputPlane + k)*nInputPlane + i].
+  Convolution kernels are flipped.
+*/
+static real *THTensor_(winogradKernels)(real *k_, long nOutputPlane, long nInputPlane,
+                                        long kstride0, long kstride1, int m, const char *xc)
+{
+  long a = m+2;
+  long stride = nOutputPlane*nInputPlane;
+  real *w = THAlloc(a*a*stride*sizeof(real));
+  long k;
+
+#pragma omp parallel for if(stride*a*a > TH_OMP_OVERHEAD_THRESHOLD) private(k)
+  for(k = 0; k < nOutputPlane; k++)
+  {
+    real g[9], tmp[18];
+    long i, l;
+    for(i = 0; i < nInputPlane; i++)
+    {
+      real *src = k_ + k*kstride0 + i*kstride1;
+      for(l = 0; l < 9; l++)
+        g[l] = (*xc == 'X' ? src[l] : src[8-l]);
+      for(l = 0; l < 3; l++)
+        THTensor_(winogradKernel1d)(tmp + l*a, 1, g + l*3, 1, m);
+      for(l = 0; l < a; l++)
+        THTensor_(winogradKernel1d)(w + l*stride + k*nInputPlane + i, a*stride, tmp + l, a, m);
+    }
+  }
+  return w;
+}
+
+/*
+  r_[k] += alpha * sum_i validXCorr2D(t_[i], g[k][i]) for the nOutputPlane
+  planes of r_, rstride0 apart, with the kernels g transformed in w, one
+  band of tile rows at a time.
+*/
+static void THTensor_(winograd2d)(real *r_, long rstride0, real alpha,
+                                  real *t_, long nInputPlane, long ir, long ic,
+                                  real *w, long nOutputPlane, int m)
+{
+  long a = m+2;
+  long or = ir - 2;
+  long oc = ic - 2;
+  long nTileRows = (or + m - 1) / m;
+  long nTileCols = (oc + m - 1) / m;
+  long bandRows = THMin(nTileRows, THMax((CONV_WINOGRAD_MIN_TILES + nTileCols - 1) / nTileCols,
+                                         CONV_WINOGRAD_BAND_SIZE/(a*a*nTileCols*(nInputPlane+nOutputPlane))));
+  real *v = THTensor_(convWorkspace)((ptrdiff_t)a*a*bandRows*nTileCols*(nInputPlane+nOutputPlane));
+  real *prod = v + a*a*bandRows*nTileCols*nInputPlane;
+  long row0;
+
+  for(row0 = 0; row0 < nTileRows; row0 += bandRows)
+  {
+    long nTiles = THMin(bandRows, nTileRows - row0)*nTileCols;
+    long stride = nInputPlane*nTiles;
+    long i, k, t, l;
+
+    /* transformed input tiles: point xy of tile t of plane i at
+       v[xy*stride + i*nTiles + t], zero past the input */
+    for(i = 0; i < nInputPlane; i++)
+      for(t = 0; t < nTiles; t++)
+      {
+        real d[36], tmp[36];
+        long y0 = (row0 + t/nTileCols)*m, x0 = (t%nTileCols)*m;
+        real *src = t_ + (i*ir + y0)*ic + x0;
+        long srcStride = ic;
+        if(y0 + a > ir || x0 + a > ic)
+        {
+          long y, x;
+          for(y = 0; y < a; y++)
+            for(x = 0; x < a; x++)
+              d[y*a+x] = (y0+y < ir && x0+x < ic ? src[y*ic+x] : 0);
+          src = d;
+          srcStride = a;
+        }
+        for(l = 0; l < a; l++)
+          THTensor_(winogradInput1d)(tmp + l*a, 1, src + l*srcStride, 1, m);
+        for(l = 0; l < a; l++)
+          THTensor_(winogradInput1d)(v + l*stride + i*nTiles + t, a*stride, tmp + l, a, m);
+      }
+
+    /* column-major: (tiles x nInputPlane) * (nInputPlane x nOutputPlane) */
+    for(l = 0; l < a*a; l++)
+      THBlas_(gemm)('n', 'n', nTiles, nOutputPlane, nInputPlane,
+                    1, v + l*stride, nTiles, w + l*nOutputPlane*nInputPlane, nInputPlane,
+                    0, prod + l*nOutputPlane*nTiles, nTiles);
+
+    for(k = 0; k < nOutputPlane; k++)
+      for(t = 0; t < nTiles; t++)
+      {
+        real tmp[24], out[16];
+        real *src = prod + k*nTiles + t;
+        long y0 = (row0 + t/nTileCols)*m, x0 = (t%nTileCols)*m;
+        long y, x;
+        for(l = 0; l < a; l++)
+          THTensor_(winogradOutput1d)(tmp + l*m, 1, src + l*a*nOutputPlane*nTiles, nOutputPlane*nTiles, m);
+        for(l = 0; l < m; l++)
+          THTensor_(winogradOutput1d)(out + l, m, tmp + l, m, m);
+        for(y = 0; y < m && y0+y < or; y++)
+          for(x = 0; x < m && x0+x < oc; x++)
+            r_[k*rstride0 + (y0+y)*oc + x0+x] += alpha*out[y*m+x];
+      }
+  }
+  THTensor_(convWorkspaceRelease)(v);
+}
+
+#endif
+
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+
+/*
+  Stride-1 convolutions with large kernels as products of spectra: the
+  O(N*K) loops become O(N log N) transforms, with real transforms along the
+  columns and complex ones along the rows and the depth. Valid convolutions
+  are circular ones over the input size, whose wrapped borders are dropped.
+  The spectra of the kernels are computed once per call, and reused for
+  every image of the batch. They are not kept between calls: tensors have
+  no version to tell that a kernel was updated in place since. Their size
+  is bounded by CONV_FFT_MAX_SPECTRA complex values (32MB), above which the
+  direct loops are used.
+*/
+#define CONV_FFT_MIN_KERNEL_SIZE 64
+#define CONV_FFT_MAX_SPECTRA (1 << 21)
+
+#ifdef _OPENMP
+#define CONV_FFT_THREAD omp_get_thread_num()
+#else
+#define CONV_FFT_THREAD 0
+#endif
+
+/* whether the transforms cost less than the direct loops */
+static int THTensor_(convUseFFT)(long nBatch, long nInputPlane, long nOutputPlane,
+                                 long id, long ir, long ic, long kd, long kr, long kc,
+                                 long sd, long sr, long sc, const char *vf)
+{
+  int full = *vf == 'F';
+  long nd, nr, nc;
+  double n, direct, transforms;
+
+  if(sd != 1 || sr != 1 || sc != 1 || kd*kr*kc < CONV_FFT_MIN_KERNEL_SIZE)
+    return 0;
+  nd = THFFT_goodSize(full ? id+kd-1 : id, 0);
+  nr = THFFT_goodSize(full ? ir+kr-1 : ir, 0);
+  nc = THFFT_goodSize(full ? ic+kc-1 : ic, 1);
+  n = (double)nd*nr*nc;
+  if((double)nOutputPlane*nInputPlane*nd*nr*(nc/2+1) > CONV_FFT_MAX_SPECTRA)
+    return 0;
+
+  direct = (double)nBatch*nInputPlane*nOutputPlane*kd*kr*kc
+    * (full ? (double)id*ir*ic : (double)(id-kd+1)*(ir-kr+1)*(ic-kc+1));
+  transforms = ((double)nInputPlane*nOutputPlane + (double)nBatch*(nInputPlane + nOutputPlane))
+    * 2.5*n*log2(n) + (double)nBatch*nInputPlane*nOutputPlane*2*n;
+  return transforms < direct;
+}
+
+/* spectrum of the d x r x c volume src (rows contiguous, sd apart in depth),
+   flipped if asked, zero-padded to nd x nr x nc */
+static void THTensor_(fftForward3d)(double *spec, real *src, long d, long r, long c, long sd, int flip,
+                                    long nd, long nr, long nc, THFFTPlan *pd, THFFTPlan *pr, THFFTPlan *pc,
+                                    double *row, double *work)
+{
+  long hc = nc/2 + 1, z, y, x;
+
+  for(z = 0; z < nd; z++)
+  {
+    for(y = 0; y < nr; y++)
+    {
+      double *dst = spec + 2*(z*nr + y)*hc;
+      if(z < d && y < r)
+      {
+        if(flip)
+        {
+          real *s = src + (d-1-z)*sd + (r-1-y)*c;
+          for(x = 0; x < c; x++)
+            row[x] = s[c-1-x];
+        }
+        else
+        {
+          real *s = src + z*sd + y*c;
+          for(x = 0; x < c; x++)
+            row[x] = s[x];
+        }
+        for(x = c; x < nc; x++)
+          row[x] = 0;
+        THFFT_realForward(pc, row, dst, work);
+      }
+      else
+        memset(dst, 0, 2*hc*sizeof(double));
+    }
+    if(nr > 1)
+      THFFT_forward(pr, spec + 2*z*nr*hc, work, hc);
+  }
+  if(nd > 1)
+    THFFT_forward(pd, spec, work, nr*hc);
+}
+
+/* r_ += scale * the od x or x oc block at (z0, y0, x0) of the inverse of spec */
+static void THTensor_(fftInverse3d)(real *r_, long od, long or, long oc, long z0, long y0, long x0, double scale,
+                                    double *spec, long nd, long nr, long nc,
+                                    THFFTPlan *pd, THFFTPlan *pr, THFFTPlan *pc, double *row, double *work)
+{
+  long hc = nc/2 + 1, z, y, x;
+
+  if(nd > 1)
+    THFFT_inverse(pd, spec, work, nr*hc);
+  for(z = 0; z < od; z++)
+  {
+    double *slice = spec + 2*(z0+z)*nr*hc;
+    if(nr > 1)
+      THFFT_inverse(pr, slice, work, hc);
+    for(y = 0; y < or; y++)
+    {
+      real *dst = r_ + (z*or + y)*oc;
+      THFFT_realInverse(pc, slice + 2*(y0+y)*hc, row, work);
+      for(x = 0; x < oc; x++)
+        dst[x] += (real)(scale*row[x0+x]);
+    }
+  }
+}
+
+/*
+  r_[p][k] += alpha * sum_i conv(t_[p][i], k_[k][i]) for nBatch images of
+  nInputPlane contiguous id x ir x ic planes, and nOutputPlane x nInputPlane
+  kernels whose rows are contiguous, kstride2 apart in depth.
+*/
+static void THTensor_(fftConv)(real *r_, long rstride0, long rstride1,
+                               real *t_, long tstride0, long tstride1, long nBatch, long nInputPlane,
+                               long id, long ir, long ic,
+                               real *k_, long kstride0, long kstride1, long kstride2, long nOutputPlane,
+                               long kd, long kr, long kc,
+                               real alpha, const char *vf, const char *xc)
+{
+  int full = *vf == 'F';
+  int flip = *xc == 'X';
+  long od = full ? id+kd-1 : id-kd+1;
+  long or = full ? ir+kr-1 : ir-kr+1;
+  long oc = full ? ic+kc-1 : ic-kc+1;
+  long nd = THFFT_goodSize(full ? od : id, 0);
+  long nr = THFFT_goodSize(full ? or : ir, 0);
+  long nc = THFFT_goodSize(full ? oc : ic, 1);
+  long z0 = full ? 0 : kd-1, y0 = full ? 0 : kr-1, x0 = full ? 0 : kc-1;
+  ptrdiff_t size = (ptrdiff_t)nd*nr*(nc/2+1);
+  ptrdiff_t threadSize = 4*size + nc;
+  double scale = (double)alpha/((double)nd*nr*nc);
+  THFFTPlan *pd = THFFTPlan_get(nd), *pr = THFFTPlan_get(nr), *pc = THFFTPlan_get(nc/2);
+  double *kspec, *tspec, *buf;
+  int nThreads = 1;
+  long pair, i, k, p;
+
+#ifdef _OPENMP
+  if(!omp_in_parallel())
+    nThreads = omp_get_max_threads();
+#endif
+  kspec = THAlloc(nOutputPlane*nInputPlane*2*size*sizeof(double));
+  tspec = THAlloc(nInputPlane*2*size*sizeof(double));
+  /* accumulated spectrum, transform work and row of each thread */
+  buf = THAlloc(nThreads*threadSize*sizeof(double));
+
+#pragma omp parallel for num_threads(nThreads) private(pair)
+  for(pair = 0; pair < nOutputPlane*nInputPlane; pair++)
+  {
+    double *b = buf + CONV_FFT_THREAD*threadSize;
+    THTensor_(fftForward3d)(kspec + pair*2*size,
+                            k_ + (pair/nInputPlane)*kstride0 + (pair%nInputPlane)*kstride1,
+                            kd, kr, kc, kstride2, flip, nd, nr, nc, pd, pr, pc, b + 4*size, b + 2*size);
+  }
+
+  for(p = 0; p < nBatch; p++)
+  {
+#pragma omp parallel for num_threads(nThreads) private(i)
+    for(i = 0; i < nInputPlane; i++)
+    {
+      double *b = buf + CONV_FFT_THREAD*threadSize;
+      THTensor_(fftForward3d)(tspec + i*2*size, t_ + p*tstride0 + i*tstride1,
+                              id, ir, ic, ir*ic, 0, nd, nr, nc, pd, pr, pc, b + 4*size, b + 2*size);
+    }
+
+#pragma omp parallel for num_threads(nThreads) private(k)
+    for(k = 0; k < nOutputPlane; k++)
+    {
+      double *b = buf + CONV_FFT_THREAD*threadSize;
+      ptrdiff_t l;
+      long j;
+      memset(b, 0, 2*size*sizeof(double));
+      for(j = 0; j < nInputPlane; j++)
+      {
+        double *x = tspec + j*2*size;
+        double *w = kspec + (k*nInputPlane + j)*2*size;
+        for(l = 0; l < size; l++)
+        {
+          b[2*l] += x[2*l]*w[2*l] - x[2*l+1]*w[2*l+1];
+          b[2*l+1] += x[2*l]*w[2*l+1] + x[2*l+1]*w[2*l];
+        }
+      }
+      THTensor_(fftInverse3d)(r_ + p*rstride0 + k*rstride1, od, or, oc, z0, y0, x0, scale,
+                              b, nd, nr, nc, pd, pr, pc, b + 4*size, b + 2*size);
+    }
+  }
+
+  THFree(kspec);
+  THFree(tspec);
+  THFree(buf);
+}
+
+#undef CONV_FFT_THREAD
+#undef CONV_WORKSPACE_MAX_CACHED
+
+#endif
+
 
 /*
   3D input, 3D kernel, 4D output
@@ -874,6 +1370,36 @@ void THTensor_(conv2Dger)(THTensor *r_, real beta, real alpha, THTensor *t_, THT
     }
   }
 
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  if (THTensor_(convUseFFT)(nInputPlane, 1, nKernelPlane, 1, nInputRows, nInputCols,
+                            1, nKernelRows, nKernelCols, 1, srow, scol, vf))
+  {
+    /* input planes as a batch of single planes */
+    THTensor_(fftConv)(output_data, nOutputRows*nOutputCols, nInputPlane*nOutputRows*nOutputCols,
+                       input_data, istride0, 0, nInputPlane, 1, 1, nInputRows, nInputCols,
+                       weight_data, kstride0, 0, 0, nKernelPlane, 1, nKernelRows, nKernelCols,
+                       alpha, vf, xc);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+  if (THTensor_(convUseGemm)(1, nKernelPlane, nKernelRows, nKernelCols, vf))
+  {
+    real *w = THTensor_(convPackKernels)(weight_data, nKernelPlane, 1, nKernelRows, nKernelCols,
+                                         kstride0, nKernelRows*nKernelCols, xc);
+    /* one product per input plane, into the output planes of all kernels */
+#pragma omp parallel for private(k)
+    for(k = 0; k < nInputPlane; k++)
+      THTensor_(unfoldGemm2d)(output_data + k*nOutputRows*nOutputCols, nInputPlane*nOutputRows*nOutputCols,
+                              alpha, input_data + k*istride0, 1, nInputRows, nInputCols,
+                              w, nKernelPlane, nKernelRows, nKernelCols, srow, scol);
+    THTensor_(convReleaseKernels)(w, weight_data);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+#endif
+
 #pragma omp parallel for private(k)
   for(k = 0; k < nKernelPlane; k++)
   {
@@ -942,6 +1468,9 @@ void THTensor_(conv2Dmv)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
   real *output_data;
   ptrdiff_t nelem;
   long k;
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  int tile;
+#endif
 
   THArgCheck(t_->nDimension == 3 , 3, "input: 3D Tensor expected");
   THArgCheck(k_->nDimension == 4 , 4, "kernel: 4D Tensor expected");
@@ -1012,6 +1541,45 @@ void THTensor_(conv2Dmv)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
     }
   }
 
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  if (THTensor_(convUseFFT)(1, nInputPlane, nOutputPlane, 1, nInputRows, nInputCols,
+                            1, nKernelRows, nKernelCols, 1, srow, scol, vf))
+  {
+    THTensor_(fftConv)(output_data, 0, nOutputRows*nOutputCols,
+                       input_data, 0, istride0, 1, nInputPlane, 1, nInputRows, nInputCols,
+                       weight_data, kstride0, kstride1, 0, nOutputPlane, 1, nKernelRows, nKernelCols,
+                       alpha, vf, xc);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+  tile = THTensor_(convWinogradTile)(1, nInputPlane, nOutputPlane, nOutputRows, nOutputCols,
+                                     nKernelRows, nKernelCols, srow, scol, vf);
+  if (tile)
+  {
+    real *w = THTensor_(winogradKernels)(weight_data, nOutputPlane, nInputPlane, kstride0, kstride1, tile, xc);
+    THTensor_(winograd2d)(output_data, nOutputRows*nOutputCols,
+                          alpha, input_data, nInputPlane, nInputRows, nInputCols,
+                          w, nOutputPlane, tile);
+    THFree(w);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+  if (THTensor_(convUseGemm)(nInputPlane, nOutputPlane, nKernelRows, nKernelCols, vf))
+  {
+    real *w = THTensor_(convPackKernels)(weight_data, nOutputPlane, nInputPlane, nKernelRows, nKernelCols,
+                                         kstride0, kstride1, xc);
+    THTensor_(unfoldGemm2d)(output_data, nOutputRows*nOutputCols,
+                            alpha, input_data, nInputPlane, nInputRows, nInputCols,
+                            w, nOutputPlane, nKernelRows, nKernelCols, srow, scol);
+    THTensor_(convReleaseKernels)(w, weight_data);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+#endif
+
 #pragma omp parallel for private(k)
   for(k = 0; k < nOutputPlane; k++)
   {
@@ -1080,6 +1648,9 @@ void THTensor_(conv2Dmm)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
   real *weight_data;
   real *output_data;
   long p;
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  int tile;
+#endif
 
   THArgCheck(t_->nDimension == 4 , 3, "input: 4D Tensor expected");
   THArgCheck(k_->nDimension == 4 , 4, "kernel: 4D Tensor expected");
@@ -1158,6 +1729,52 @@ void THTensor_(conv2Dmm)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
     }
   }
 
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  if (THTensor_(convUseFFT)(nbatch, nInputPlane, nOutputPlane, 1, nInputRows, nInputCols,
+                            1, nKernelRows, nKernelCols, 1, srow, scol, vf))
+  {
+    THTensor_(fftConv)(output_data, nOutputPlane*nOutputRows*nOutputCols, nOutputRows*nOutputCols,
+                       input_data, nInputPlane*nInputRows*nInputCols, nInputRows*nInputCols, nbatch, nInputPlane,
+                       1, nInputRows, nInputCols,
+                       weight_data, kstride0, kstride1, 0, nOutputPlane, 1, nKernelRows, nKernelCols,
+                       alpha, vf, xc);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+  tile = THTensor_(convWinogradTile)(nbatch, nInputPlane, nOutputPlane, nOutputRows, nOutputCols,
+                                     nKernelRows, nKernelCols, srow, scol, vf);
+  if (tile)
+  {
+    real *w = THTensor_(winogradKernels)(weight_data, nOutputPlane, nInputPlane, kstride0, kstride1, tile, xc);
+#pragma omp parallel for private(p)
+    for(p = 0; p < nbatch; p++)
+      THTensor_(winograd2d)(output_data + p*nOutputPlane*nOutputRows*nOutputCols, nOutputRows*nOutputCols,
+                            alpha, input_data + p*nInputPlane*nInputRows*nInputCols,
+                            nInputPlane, nInputRows, nInputCols,
+                            w, nOutputPlane, tile);
+    THFree(w);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+  if (THTensor_(convUseGemm)(nInputPlane, nOutputPlane, nKernelRows, nKernelCols, vf))
+  {
+    real *w = THTensor_(convPackKernels)(weight_data, nOutputPlane, nInputPlane, nKernelRows, nKernelCols,
+                                         kstride0, kstride1, xc);
+#pragma omp parallel for private(p)
+    for(p = 0; p < nbatch; p++)
+      THTensor_(unfoldGemm2d)(output_data + p*nOutputPlane*nOutputRows*nOutputCols, nOutputRows*nOutputCols,
+                              alpha, input_data + p*nInputPlane*nInputRows*nInputCols,
+                              nInputPlane, nInputRows, nInputCols,
+                              w, nOutputPlane, nKernelRows, nKernelCols, srow, scol);
+    THTensor_(convReleaseKernels)(w, weight_data);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+#endif
+
 #pragma omp parallel for private(p)
   for(p=0; p < nbatch; p++)
   {
@@ -1260,6 +1877,17 @@ void THTensor_(conv2Dmul)(THTensor *r_, real beta, real alpha, THTensor *t_, THT
   output_data = THTensor_(data)(r_);
 
 
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  if (THTensor_(convUseFFT)(1, 1, 1, 1, nInputRows, nInputCols, 1, nKernelRows, nKernelCols, 1, srow, scol, vf))
+  {
+    THTensor_(fftConv)(output_data, 0, 0, ptr_input, 0, 0, 1, 1, 1, nInputRows, nInputCols,
+                       ptr_weight, 0, 0, 0, 1, 1, nKernelRows, nKernelCols, alpha, vf, xc);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+#endif
+
   /* do image, kernel convolution */
   THTensor_(conv2d)(output_data,
                     alpha,
@@ -1453,7 +2081,7 @@ void THTensor_(conv3DRevger)(THTensor *r_, real beta, real alpha, THTensor *t_,
   real *weight_data;
   real *output_data;
   ptrdiff_t nelem;
-  long k, i;
+  long k;
 
   THArgCheck(t_->nDimension == 4 , 3, "input: 4D Tensor expected");
   THArgCheck(k_->nDimension == 4 , 4, "kernel: 4D Tensor expected");
@@ -1497,24 +2125,26 @@ void THTensor_(conv3DRevger)(THTensor *r_, real beta, real alpha, THTensor *t_,
   weight_data = THTensor_(data)(kernel);
   output_data = THTensor_(data)(r_);
 
+#pragma omp parallel for private(k)
   for(k = 0; k < nKernelPlane; k++)
   {
+    long i;
     /* get kernel */
     real *ptr_weight = weight_data+k*kstride0;
 
     for(i = 0; i < nInputPlane; i++)
     {
+      /* get output */
+      real *ptr_output = output_data + (k*nInputPlane + i)*nOutputDepth*nOutputCols*nOutputRows;
       /* get input */
       real *ptr_input = input_data+i*istride0;
 
       /* do image, kernel convolution */
-      THTensor_(validXCorr3DRevptr)(output_data,
+      THTensor_(validXCorr3DRevptr)(ptr_output,
                                     alpha,
                                     ptr_input,  nInputDepth, nInputRows,  nInputCols,
                                     ptr_weight, nKernelDepth, nKernelRows, nKernelCols,
                                     sdepth, srow, scol);
-      /* Next output plane */
-      output_data += nOutputDepth*nOutputCols*nOutputRows;
     }
   }
   THTensor_(free)(input);
@@ -1540,7 +2170,7 @@ void THTensor_(conv3Dger)(THTensor *r_, real beta, real alpha, THTensor *t_, THT
   real *weight_data;
   real *output_data;
   ptrdiff_t nelem;
-  long k, i;
+  long k;
 
   THArgCheck(t_->nDimension == 4 , 3, "input: 4D Tensor expected");
   THArgCheck(k_->nDimension == 4 , 4, "kernel: 4D Tensor expected");
@@ -1589,25 +2219,42 @@ void THTensor_(conv3Dger)(THTensor *r_, real beta, real alpha, THTensor *t_, THT
   weight_data = THTensor_(data)(kernel);
   output_data = THTensor_(data)(r_);
 
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  if (THTensor_(convUseFFT)(nInputPlane, 1, nKernelPlane, nInputDepth, nInputRows, nInputCols,
+                            nKernelDepth, nKernelRows, nKernelCols, sdepth, srow, scol, vf))
+  {
+    /* input planes as a batch of single planes */
+    THTensor_(fftConv)(output_data, nOutputDepth*nOutputRows*nOutputCols,
+                       nInputPlane*nOutputDepth*nOutputRows*nOutputCols,
+                       input_data, istride0, 0, nInputPlane, 1, nInputDepth, nInputRows, nInputCols,
+                       weight_data, kstride0, 0, nKernelRows*nKernelCols, nKernelPlane,
+                       nKernelDepth, nKernelRows, nKernelCols, alpha, vf, xc);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+#endif
+
+#pragma omp parallel for private(k)
   for(k = 0; k < nKernelPlane; k++)
   {
+    long i;
     /* get kernel */
     real *ptr_weight = weight_data+k*kstride0;
 
     for(i = 0; i < nInputPlane; i++)
     {
+      /* get output */
+      real *ptr_output = output_data + (k*nInputPlane + i)*nOutputDepth*nOutputCols*nOutputRows;
       /* get input */
       real *ptr_input = input_data+i*istride0;
 
       /* do image, kernel convolution */
-      THTensor_(conv3d)(output_data,
+      THTensor_(conv3d)(ptr_output,
                         alpha,
                         ptr_input,  nInputDepth, nInputRows,  nInputCols,
                         ptr_weight, nKernelDepth, nKernelRows, nKernelCols,
                         sdepth, srow, scol, vf, xc);
-
-      /* Next output plane */
-      output_data += nOutputDepth*nOutputCols*nOutputRows;
     }
   }
   THTensor_(free)(input);
@@ -1632,7 +2279,7 @@ void THTensor_(conv3Dmv)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
   real *weight_data;
   real *output_data;
   ptrdiff_t nelem;
-  long k, i;
+  long k;
 
   THArgCheck(t_->nDimension == 4 , 3, "input: 4D Tensor expected");
   THArgCheck(k_->nDimension == 5 , 4, "kernel: 5D Tensor expected");
@@ -1684,8 +2331,26 @@ void THTensor_(conv3Dmv)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
   weight_data = THTensor_(data)(kernel);
   output_data = THTensor_(data)(r_);
 
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  if (THTensor_(convUseFFT)(1, nInputPlane, nOutputPlane, nInputDepth, nInputRows, nInputCols,
+                            nKernelDepth, nKernelRows, nKernelCols, sdepth, srow, scol, vf))
+  {
+    THTensor_(fftConv)(output_data, 0, nOutputDepth*nOutputRows*nOutputCols,
+                       input_data, 0, istride0, 1, nInputPlane, nInputDepth, nInputRows, nInputCols,
+                       weight_data, kstride0, kstride1, kernel->stride[2], nOutputPlane,
+                       nKernelDepth, nKernelRows, nKernelCols, alpha, vf, xc);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+#endif
+
+#pragma omp parallel for private(k)
   for(k = 0; k < nOutputPlane; k++)
   {
+    long i;
+    /* get output */
+    real *ptr_output = output_data + k*nOutputDepth*nOutputCols*nOutputRows;
     for(i = 0; i < nInputPlane; i++)
     {
       /* get kernel */
@@ -1694,14 +2359,127 @@ void THTensor_(conv3Dmv)(THTensor *r_, real beta, real alpha, THTensor *t_, THTe
       real *ptr_input = input_data + i*istride0;
 
       /* do image, kernel convolution */
-      THTensor_(conv3d)(output_data,
+      THTensor_(conv3d)(ptr_output,
+                        alpha,
+                        ptr_input,  nInputDepth, nInputRows,  nInputCols,
+                        ptr_weight, nKernelDepth, nKernelRows, nKernelCols,
+                        sdepth, srow, scol, vf, xc);
+    }
+  }
+  THTensor_(free)(input);
+  THTensor_(free)(kernel);
+}
+
+/*
+  5D input, 5D kernel, 5D output
+  matrix matrix product like
+  y <- Ax + beta*y
+*/
+void THTensor_(conv3Dmm)(THTensor *r_, real beta, real alpha, THTensor *t_, THTensor *k_,
+                         long sdepth, long srow, long scol, const char *vf, const char *xc)
+{
+  long nInputPlane, nInputDepth, nInputRows, nInputCols;
+  long nKernelDepth, nKernelRows, nKernelCols;
+  long nOutputPlane, nOutputDepth, nOutputRows, nOutputCols;
+  long kstride0, kstride1;
+  THTensor *input;
+  THTensor *kernel;
+  long nbatch;
+  ptrdiff_t nelem;
+  real *input_data;
+  real *weight_data;
+  real *output_data;
+  long p;
+
+  THArgCheck(t_->nDimension == 5 , 3, "input: 5D Tensor expected");
+  THArgCheck(k_->nDimension == 5 , 4, "kernel: 5D Tensor expected");
+  THArgCheck(sdepth >= 1, 5, "Stride should be a positive integer");
+  THArgCheck(srow >= 1, 6, "Stride should be a positive integer");
+  THArgCheck(scol >= 1, 7, "Stride should be a positive integer");
+  THArgCheck(*vf == 'V' || *vf == 'F', 8, "type of convolution can 'V' or 'F'");
+  THArgCheck(*xc == 'C' || *xc == 'X', 8, "type of convolution can 'X' or 'C'");
+
+  input = THTensor_(newContiguous)(t_);
+  if (!(k_->stride[4] == 1) || !(k_->stride[3] == k_->size[4])) {
+    kernel = THTensor_(newContiguous)(k_);
+  } else {
+    THTensor_(retain)(k_);
+    kernel = k_;
+  }
+
+  nbatch = input->size[0];
+  nInputPlane = input->size[1];
+  nInputDepth = input->size[2];
+  nInputRows  = input->size[3];
+  nInputCols  = input->size[4];
+
+  kstride0    = kernel->stride[0];
+  kstride1    = kernel->stride[1];
+  nKernelDepth = kernel->size[2];
+  nKernelRows = kernel->size[3];
+  nKernelCols = kernel->size[4];
+  nOutputPlane = kernel->size[0];
+  THArgCheck(kernel->size[1] == nInputPlane, 2, "invalid number of input planes");
+
+  THArgCheck( (nInputDepth >= nKernelDepth && nInputRows >= nKernelRows && nInputCols >= nKernelCols) || *vf == 'F', 2, "conv3Dmm : Input image is smaller than kernel");
+
+  nOutputDepth = THTensor_(convsize)(nInputDepth, nKernelDepth, sdepth, vf);
+  nOutputRows = THTensor_(convsize)(nInputRows, nKernelRows, srow, vf);
+  nOutputCols = THTensor_(convsize)(nInputCols, nKernelCols, scol, vf);
+
+  nelem = THTensor_(nElement)(r_);
+  THTensor_(resize5d)(r_, nbatch, nOutputPlane, nOutputDepth, nOutputRows, nOutputCols);
+
+  if (nelem == 0 || beta == 0 || nelem != THTensor_(nElement)(r_))
+  {
+    THTensor_(zero)(r_);
+  }
+  else if (beta != 1)
+    THTensor_(mul)(r_, r_, beta);
+
+  input_data = THTensor_(data)(input);
+  weight_data = THTensor_(data)(kernel);
+  output_data = THTensor_(data)(r_);
+
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  if (THTensor_(convUseFFT)(nbatch, nInputPlane, nOutputPlane, nInputDepth, nInputRows, nInputCols,
+                            nKernelDepth, nKernelRows, nKernelCols, sdepth, srow, scol, vf))
+  {
+    THTensor_(fftConv)(output_data, nOutputPlane*nOutputDepth*nOutputRows*nOutputCols,
+                       nOutputDepth*nOutputRows*nOutputCols,
+                       input_data, nInputPlane*nInputDepth*nInputRows*nInputCols,
+                       nInputDepth*nInputRows*nInputCols, nbatch, nInputPlane,
+                       nInputDepth, nInputRows, nInputCols,
+                       weight_data, kstride0, kstride1, kernel->stride[2], nOutputPlane,
+                       nKernelDepth, nKernelRows, nKernelCols, alpha, vf, xc);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+#endif
+
+  /* one thread per (image, output plane) pair */
+#pragma omp parallel for private(p)
+  for(p = 0; p < nbatch*nOutputPlane; p++)
+  {
+    long k = p % nOutputPlane;
+    long i;
+    /* get output */
+    real *ptr_output = output_data + p*nOutputDepth*nOutputRows*nOutputCols;
+    for(i = 0; i < nInputPlane; i++)
+    {
+      /* get kernel */
+      real *ptr_weight = weight_data + k*kstride0 + i*kstride1;
+      /* get input */
+      real *ptr_input = input_data + ((p/nOutputPlane)*nInputPlane + i)*nInputDepth*nInputRows*nInputCols;
+
+      /* do image, kernel convolution */
+      THTensor_(conv3d)(ptr_output,
                         alpha,
                         ptr_input,  nInputDepth, nInputRows,  nInputCols,
                         ptr_weight, nKernelDepth, nKernelRows, nKernelCols,
                         sdepth, srow, scol, vf, xc);
     }
-    /* Next output plane */
-    output_data += nOutputDepth*nOutputCols*nOutputRows;
   }
   THTensor_(free)(input);
   THTensor_(free)(kernel);
@@ -1765,6 +2543,19 @@ void THTensor_(conv3Dmul)(THTensor *r_, real beta, real alpha, THTensor *t_, THT
   output_data = THTensor_(data)(r_);
 
 
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+  if (THTensor_(convUseFFT)(1, 1, 1, nInputDepth, nInputRows, nInputCols,
+                            nKernelDepth, nKernelRows, nKernelCols, sdepth, srow, scol, vf))
+  {
+    THTensor_(fftConv)(output_data, 0, 0, ptr_input, 0, 0, 1, 1, nInputDepth, nInputRows, nInputCols,
+                       ptr_weight, 0, 0, nKernelRows*nKernelCols, 1, nKernelDepth, nKernelRows, nKernelCols,
+                       alpha, vf, xc);
+    THTensor_(free)(input);
+    THTensor_(free)(kernel);
+    return;
+  }
+#endif
+
   /* do image, kernel convolution */
   THTensor_(conv3d)(output_data,
                     alpha,
@@ -1839,22 +2630,22 @@ void THTensor_(conv3Dcmul)(THTensor *r_, real beta, real alpha, THTensor *t_, TH
   weight_data = THTensor_(data)(kernel);
   output_data = THTensor_(data)(r_);
 
+#pragma omp parallel for private(k)
   for(k = 0; k < nOutputPlane; k++)
   {
     /* get kernel */
     real *ptr_weight = weight_data + k*kstride0;
     /* get input */
     real *ptr_input = input_data + k*istride0;
+    /* get output */
+    real *ptr_output = output_data + k*nOutputDepth*nOutputCols*nOutputRows;
 
     /* do image, kernel convolution */
-    THTensor_(conv3d)(output_data,
+    THTensor_(conv3d)(ptr_output,
                       alpha,
                       ptr_input,  nInputDepth, nInputRows,  nInputCols,
                       ptr_weight, nKernelDepth, nKernelRows, nKernelCols,
                       sdepth, srow, scol, vf, xc);
-
-    /* Next output plane */
-    output_data += nOutputDepth*nOutputCols*nOutputRows;
   }
   THTensor_(free)(input);
   THTensor_(free)(kernel);
@@ -1880,7 +2671,8 @@ void THTensor_(conv3Dmap)(THTensor *r_, real beta, real alpha, THTensor *t_, THT
   real *weight_data;
   real *output_data;
   long nmaps;
-  long k;
+  long *mapFirst, *mapOrder;
+  long o, k;
 
   THArgCheck(t_->nDimension == 4 , 3, "input: 4D Tensor expected");
   THArgCheck(k_->nDimension == 4 , 4, "kernel: 4D Tensor expected");
@@ -1911,6 +2703,34 @@ void THTensor_(conv3Dmap)(THTensor *r_, real beta, real alpha, THTensor *t_, THT
               && nInputCols >= nKernelCols) || *vf == 'F',
              2, "conv3Dmap : Input image is smaller than kernel");
 
+  /* map entries grouped by output plane, in their order, so that each
+     thread only reads the entries of the planes it owns */
+  nmaps = map->size[0];
+  mapFirst = THAlloc((nOutputPlane+1)*sizeof(long));
+  mapOrder = THAlloc(nmaps*sizeof(long));
+  for(o = 0; o <= nOutputPlane; o++)
+    mapFirst[o] = 0;
+  for(k = 0; k < nmaps; k++)
+  {
+    long to = (long)THTensor_(get2d)(map,k,1)-1;
+    if(to < 0 || to >= nOutputPlane)
+    {
+      THFree(mapFirst);
+      THFree(mapOrder);
+      THTensor_(free)(input);
+      THTensor_(free)(kernel);
+      THArgCheck(0, 6, "map: output plane out of range");
+    }
+    mapFirst[to+1]++;
+  }
+  for(o = 0; o < nOutputPlane; o++)
+    mapFirst[o+1] += mapFirst[o];
+  for(k = 0; k < nmaps; k++)
+    mapOrder[mapFirst[(long)THTensor_(get2d)(map,k,1)-1]++] = k;
+  for(o = nOutputPlane; o > 0; o--)
+    mapFirst[o] = mapFirst[o-1];
+  mapFirst[0] = 0;
+
   nOutputDepth = THTensor_(convsize)(nInputDepth, nKernelDepth, sdepth, vf);
   nOutputRows = THTensor_(convsize)(nInputRows, nKernelRows, srow, vf);
   nOutputCols = THTensor_(convsize)(nInputCols, nKernelCols, scol, vf);
@@ -1929,28 +2749,34 @@ void THTensor_(conv3Dmap)(THTensor *r_, real beta, real alpha, THTensor *t_, THT
   weight_data = THTensor_(data)(kernel);
   output_data = THTensor_(data)(r_);
 
-  nmaps = map->size[0];
-
-  for(k = 0; k < nmaps; k++)
+  /* each thread owns the output planes it updates */
+#pragma omp parallel for if(nmaps*nOutputDepth*nOutputRows*nOutputCols*nKernelDepth*nKernelRows*nKernelCols > TH_OMP_OVERHEAD_THRESHOLD) private(o)
+  for(o = 0; o < nOutputPlane; o++)
   {
-    /* get indices */
-    long from = (long)THTensor_(get2d)(map,k,0)-1;
-    long to   = (long)THTensor_(get2d)(map,k,1)-1;
+    long l;
+    for(l = mapFirst[o]; l < mapFirst[o+1]; l++)
+    {
+      /* get indices */
+      long k = mapOrder[l];
+      long from = (long)THTensor_(get2d)(map,k,0)-1;
 
-    /* get kernel */
-    real *ptr_weight = weight_data + k*kstride0;
-    /* get input */
-    real *ptr_input = input_data + from*istride0;
-    /* get output */
-    real *ptr_output = output_data + to*nOutputDepth*nOutputRows*nOutputCols;
+      /* get kernel */
+      real *ptr_weight = weight_data + k*kstride0;
+      /* get input */
+      real *ptr_input = input_data + from*istride0;
+      /* get output */
+      real *ptr_output = output_data + o*nOutputDepth*nOutputRows*nOutputCols;
 
-    /* do image, kernel convolution */
-    THTensor_(conv3d)(ptr_output,
-                      alpha,
-                      ptr_input,  nInputDepth, nInputRows,  nInputCols,
-                      ptr_weight, nKernelDepth, nKernelRows, nKernelCols,
-                      sdepth, srow, scol, vf, xc);
+      /* do image, kernel convolution */
+      THTensor_(conv3d)(ptr_output,
+                        alpha,
+                        ptr_input,  nInputDepth, nInputRows,  nInputCols,
+                        ptr_weight, nKernelDepth, nKernelRows, nKernelCols,
+                        sdepth, srow, scol, vf, xc);
+    }
   }
+  THFree(mapFirst);
+  THFree(mapOrder);
   THTensor_(free)(input);
   THTensor_(free)(kernel);
 }
@@ -587,6 +587,9 @@ real THTensor_(maxall)(THTensor *tensor)
 }
 
 static void THTensor_(quickselectnoidx)(real *arr, long k, long elements, long stride);
+static real THTensor_(histogramSelect)(real *data, ptrdiff_t n, ptrdiff_t k);
+
+#define MEDIAN_HISTOGRAM_MIN_SIZE (1 << 16) /* smaller tensors are copied and quickselected */
 
 real THTensor_(medianall)(THTensor *tensor)
 {
@@ -601,6 +604,10 @@ real THTensor_(medianall)(THTensor *tensor)
   numel = THTensor_(nElement)(tensor);
   k = (numel-1) >> 1;
 
+  /* large contiguous tensors are read a few times instead of being copied */
+  if(numel >= MEDIAN_HISTOGRAM_MIN_SIZE && THTensor_(isContiguous)(tensor))
+    return THTensor_(histogramSelect)(THTensor_(data)(tensor), numel, k);
+
   temp_ = THTensor_(newClone)(tensor);
   temp__data = THTensor_(data)(temp_);
 
@@ -613,6 +620,8 @@ real THTensor_(medianall)(THTensor *tensor)
   return theMedian;
 }
 
+#undef MEDIAN_HISTOGRAM_MIN_SIZE
+
 accreal THTensor_(sumall)(THTensor *tensor)
 {
   accreal sum = 0;
@@ -2088,6 +2097,11 @@ void THTensor_(reshape)(THTensor *r_, THTensor *t, THLongStorage *size)
 
    Julien, November 12th 2013
 */
+/* NaNs compare greater than any other value: they are sorted last in
+   ascending order and first in descending order, like in the radix sort */
+#define GT_OR_NAN(x, y) \
+  ((x != x && y == y) || (x > y))
+
 #define MAX_LEVELS  300
 #define M_SMALL 10 /* Limit for small subfiles */
 
@@ -2119,15 +2133,15 @@ static void THTensor_(quicksortascend)(real *arr, long *idx, long elements, long
       /* Use median of three for pivot choice */
     P=(L+R)>>1;
     BOTH_SWAP(P, L+1);
-    if (ARR(L+1) > ARR(R)) { BOTH_SWAP(L+1, R); }
-    if (ARR(L) > ARR(R)) { BOTH_SWAP(L, R); }
-    if (ARR(L+1) > ARR(L)) { BOTH_SWAP(L+1, L); }
+    if (GT_OR_NAN(ARR(L+1), ARR(R))) { BOTH_SWAP(L+1, R); }
+    if (GT_OR_NAN(ARR(L), ARR(R))) { BOTH_SWAP(L, R); }
+    if (GT_OR_NAN(ARR(L+1), ARR(L))) { BOTH_SWAP(L+1, L); }
 
     i = L+1; j = R; piv = ARR(L); pid = IDX(L);
 
     do {
-      do { i = i+1; } while(ARR(i) < piv);
-      do { j = j-1; } while(ARR(j) > piv);
+      do { i = i+1; } while(GT_OR_NAN(piv, ARR(i)));
+      do { j = j-1; } while(GT_OR_NAN(ARR(j), piv));
       if (j < i)
           break;
       BOTH_SWAP(i, j);
@@ -2178,7 +2192,7 @@ static void THTensor_(quicksortascend)(real *arr, long *idx, long elements, long
   } /* while not done */
   /* Now insertion sort on the concatenation of subfiles */
   for(i=elements-2; i>=0; i--) {
-    if (ARR(i) > ARR(i+1)) {
+    if (GT_OR_NAN(ARR(i), ARR(i+1))) {
       piv = ARR(i);
       pid = IDX(i);
       j = i+1;
@@ -2186,7 +2200,7 @@ static void THTensor_(quicksortascend)(real *arr, long *idx, long elements, long
         ARR(j-1) = ARR(j);
         IDX(j-1) = IDX(j);
         j = j+1;
-      } while(j < elements && ARR(j) < piv);
+      } while(j < elements && GT_OR_NAN(piv, ARR(j)));
       ARR(j-1) = piv;
       IDX(j-1) = pid;
      }
@@ -2208,15 +2222,15 @@ static void THTensor_(quicksortdescend)(real *arr, long *idx, long elements, lon
       /* Use median of three for pivot choice */
     P=(L+R)>>1;
     BOTH_SWAP(P, L+1);
-    if (ARR(L+1) < ARR(R)) { BOTH_SWAP(L+1, R); }
-    if (ARR(L) < ARR(R)) { BOTH_SWAP(L, R); }
-    if (ARR(L+1) < ARR(L)) { BOTH_SWAP(L+1, L); }
+    if (GT_OR_NAN(ARR(R), ARR(L+1))) { BOTH_SWAP(L+1, R); }
+    if (GT_OR_NAN(ARR(R), ARR(L))) { BOTH_SWAP(L, R); }
+    if (GT_OR_NAN(ARR(L), ARR(L+1))) { BOTH_SWAP(L+1, L); }
 
     i = L+1; j = R; piv = ARR(L); pid = IDX(L);
 
     do {
-      do { i = i+1; } while(ARR(i) > piv);
-      do { j = j-1; } while(ARR(j) < piv);
+      do { i = i+1; } while(GT_OR_NAN(ARR(i), piv));
+      do { j = j-1; } while(GT_OR_NAN(piv, ARR(j)));
       if (j < i)
           break;
       BOTH_SWAP(i, j);
@@ -2267,7 +2281,7 @@ static void THTensor_(quicksortdescend)(real *arr, long *idx, long elements, lon
   } /* while not done */
   /* Now insertion sort on the concatenation of subfiles */
   for(i=elements-2; i>=0; i--) {
-    if (ARR(i) < ARR(i+1)) {
+    if (GT_OR_NAN(ARR(i+1), ARR(i))) {
       piv = ARR(i);
       pid = IDX(i);
       j = i+1;
@@ -2275,7 +2289,7 @@ static void THTensor_(quicksortdescend)(real *arr, long *idx, long elements, lon
         ARR(j-1) = ARR(j);
         IDX(j-1) = IDX(j);
         j = j+1;
-      } while(j < elements && ARR(j) > piv);
+      } while(j < elements && GT_OR_NAN(ARR(j), piv));
       ARR(j-1) = piv;
       IDX(j-1) = pid;
      }
@@ -2285,38 +2299,907 @@ static void THTensor_(quicksortdescend)(real *arr, long *idx, long elements, lon
 #undef MAX_LEVELS
 #undef M_SMALL
 
-void THTensor_(sort)(THTensor *rt_, THLongTensor *ri_, THTensor *t, int dimension, int descendingOrder)
+/* LSD radix sort, with indices. Values are mapped to unsigned keys in the
+   same order: the sign bit of integers is flipped, as well as all the bits
+   of negative floating point numbers, and only the sign bit of the others.
+   NaNs all get the largest key.
+   Keys are then sorted RADIX_BITS bits at a time, skipping the digits which
+   are the same for all keys. The sort is stable: equal values keep the order of
+   their indices, in both orders. */
+#if defined(TH_REAL_IS_LONG) || defined(TH_REAL_IS_DOUBLE)
+#define RADIX_KEY uint64_t
+#else
+#define RADIX_KEY uint32_t
+#endif
+
+#define RADIX_PARALLEL_MIN_SIZE (1 << 18) /* shorter slices are sorted by a single thread */
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_DIGITS ((int)(8*sizeof(real)+RADIX_BITS-1)/RADIX_BITS)
+/* shorter slices are quicksorted: below this size, clearing and scanning
+   the histograms of every digit costs more than the sort itself */
+#define RADIX_MIN_SIZE (128*RADIX_DIGITS)
+
+static inline RADIX_KEY THTensor_(radixKey)(real value)
+{
+#if defined(TH_REAL_IS_BYTE)
+  return (RADIX_KEY)value;
+#elif defined(TH_REAL_IS_CHAR)
+  return (RADIX_KEY)((unsigned char)value ^ (CHAR_MIN < 0 ? 0x80 : 0));
+#elif defined(TH_REAL_IS_SHORT)
+  return (RADIX_KEY)((unsigned short)value ^ 0x8000);
+#elif defined(TH_REAL_IS_INT)
+  return (RADIX_KEY)((unsigned int)value ^ 0x80000000U);
+#elif defined(TH_REAL_IS_LONG)
+  return (RADIX_KEY)(unsigned long)value ^ ((RADIX_KEY)1 << (8*sizeof(long)-1));
+#else
+  RADIX_KEY bits;
+  /* NaNs, whatever their sign, after +inf */
+  if(value != value)
+    return ~(RADIX_KEY)0;
+  memcpy(&bits, &value, sizeof(bits));
+  return (bits >> (8*sizeof(bits)-1)) ? ~bits : bits | ((RADIX_KEY)1 << (8*sizeof(bits)-1));
+#endif
+}
+
+static inline real THTensor_(radixValue)(RADIX_KEY key)
+{
+#if defined(TH_REAL_IS_BYTE)
+  return (real)key;
+#elif defined(TH_REAL_IS_CHAR)
+  return (real)(unsigned char)(key ^ (CHAR_MIN < 0 ? 0x80 : 0));
+#elif defined(TH_REAL_IS_SHORT)
+  return (real)(unsigned short)(key ^ 0x8000);
+#elif defined(TH_REAL_IS_INT)
+  return (real)(unsigned int)(key ^ 0x80000000U);
+#elif defined(TH_REAL_IS_LONG)
+  return (real)(unsigned long)(key ^ ((RADIX_KEY)1 << (8*sizeof(long)-1)));
+#else
+  real value;
+  key = (key >> (8*sizeof(key)-1)) ? key ^ ((RADIX_KEY)1 << (8*sizeof(key)-1)) : ~key;
+  memcpy(&value, &key, sizeof(value));
+  return value;
+#endif
+}
+
+/* keys, keysTmp, idxA and idxB are buffers of at least `elements` entries,
+   count one of RADIX_DIGITS*RADIX_BUCKETS. Only the values are sorted when
+   idx is NULL, and idxA and idxB are then unused. */
+static void THTensor_(radixsort)(real *arr, long *idx, long elements, long stride, int descendingOrder,
+                                 RADIX_KEY *keys, RADIX_KEY *keysTmp, long *idxA, long *idxB, long *count)
+{
+  RADIX_KEY flip = (descendingOrder ? ~(RADIX_KEY)0 : 0);
+  long i;
+  int b;
+
+  memset(count, 0, sizeof(long)*RADIX_DIGITS*RADIX_BUCKETS);
+  for(i = 0; i < elements; i++)
+  {
+    RADIX_KEY key = THTensor_(radixKey)(arr[i*stride]) ^ flip;
+    keys[i] = key;
+    for(b = 0; b < RADIX_DIGITS; b++)
+      count[b*RADIX_BUCKETS + ((key >> (RADIX_BITS*b)) & (RADIX_BUCKETS-1))]++;
+  }
+  if(idx)
+  {
+    for(i = 0; i < elements; i++)
+      idxA[i] = i;
+  }
+
+  for(b = 0; b < RADIX_DIGITS; b++)
+  {
+    long *c = count + b*RADIX_BUCKETS;
+    long offset = 0;
+    int shift = RADIX_BITS*b;
+    int d;
+
+    /* all keys have the same digit */
+    if(c[(keys[0] >> shift) & (RADIX_BUCKETS-1)] == elements)
+      continue;
+
+    for(d = 0; d < RADIX_BUCKETS; d++)
+    {
+      long n = c[d];
+      c[d] = offset;
+      offset += n;
+    }
+    if(idx)
+    {
+      for(i = 0; i < elements; i++)
+      {
+        RADIX_KEY key = keys[i];
+        long pos = c[(key >> shift) & (RADIX_BUCKETS-1)]++;
+        keysTmp[pos] = key;
+        idxB[pos] = idxA[i];
+      }
+    }
+    else
+    {
+      for(i = 0; i < elements; i++)
+      {
+        RADIX_KEY key = keys[i];
+        keysTmp[c[(key >> shift) & (RADIX_BUCKETS-1)]++] = key;
+      }
+    }
+
+    {
+      RADIX_KEY *tmp = keys;
+      long *tmpi = idxA;
+      keys = keysTmp;
+      keysTmp = tmp;
+      idxA = idxB;
+      idxB = tmpi;
+    }
+  }
+
+  for(i = 0; i < elements; i++)
+    arr[i*stride] = THTensor_(radixValue)(keys[i] ^ flip);
+  if(idx)
+  {
+    for(i = 0; i < elements; i++)
+      idx[i*stride] = idxA[i];
+  }
+}
+
+#ifdef _OPENMP
+/* Radix sort of a single slice, spread over the threads: each thread counts
+   and scatters a contiguous chunk of the keys, at offsets which keep the
+   chunks in order, so the result is the same as the serial sort. count is
+   a buffer of omp_get_max_threads()*RADIX_DIGITS*RADIX_BUCKETS entries, of
+   which only the histograms of the threads actually running are used. */
+static void THTensor_(radixsortParallel)(real *arr, long *idx, long elements, long stride, int descendingOrder,
+                                         RADIX_KEY *keys_, RADIX_KEY *keysTmp_, long *idxA_, long *idxB_, long *count)
+{
+  RADIX_KEY flip = (descendingOrder ? ~(RADIX_KEY)0 : 0);
+  int skip[RADIX_DIGITS];
+
+#pragma omp parallel num_threads(omp_get_max_threads())
+  {
+    RADIX_KEY *keys = keys_, *keysTmp = keysTmp_;
+    long *idxA = idxA_, *idxB = idxB_;
+    int nThreads = omp_get_num_threads();
+    int thread = omp_get_thread_num();
+    long chunk = (elements + nThreads - 1)/nThreads;
+    long start = THMin(elements, thread*chunk);
+    long end = THMin(elements, start + chunk);
+    long *c = count + thread*RADIX_DIGITS*RADIX_BUCKETS;
+    long i;
+    int b, permuted = 0;
+
+    memset(c, 0, sizeof(long)*RADIX_DIGITS*RADIX_BUCKETS);
+    for(i = start; i < end; i++)
+    {
+      RADIX_KEY key = THTensor_(radixKey)(arr[i*stride]) ^ flip;
+      keys[i] = key;
+      for(b = 0; b < RADIX_DIGITS; b++)
+        c[b*RADIX_BUCKETS + ((key >> (RADIX_BITS*b)) & (RADIX_BUCKETS-1))]++;
+    }
+    if(idx)
+    {
+      for(i = start; i < end; i++)
+        idxA[i] = i;
+    }
+#pragma omp barrier
+
+    for(b = 0; b < RADIX_DIGITS; b++)
+    {
+      long *cb = c + b*RADIX_BUCKETS;
+      int shift = RADIX_BITS*b;
+
+#pragma omp single
+      {
+        long first = 0;
+        int t;
+        for(t = 0; t < nThreads; t++)
+          first += count[(t*RADIX_DIGITS + b)*RADIX_BUCKETS + ((keys[0] >> shift) & (RADIX_BUCKETS-1))];
+        skip[b] = (first == elements);
+      }
+      if(skip[b])
+        continue;
+
+      /* the chunk of a thread holds other keys once they have been moved */
+      if(permuted)
+      {
+        memset(cb, 0, sizeof(long)*RADIX_BUCKETS);
+        for(i = start; i < end; i++)
+          cb[(keys[i] >> shift) & (RADIX_BUCKETS-1)]++;
+#pragma omp barrier
+      }
+      permuted = 1;
+
+      /* bucket d of thread t starts after the buckets below d, and after
+         bucket d of the threads before t */
+#pragma omp single
+      {
+        long offset = 0;
+        int d, t;
+        for(d = 0; d < RADIX_BUCKETS; d++)
+        {
+          for(t = 0; t < nThreads; t++)
+          {
+            long *ct = count + (t*RADIX_DIGITS + b)*RADIX_BUCKETS;
+            long n = ct[d];
+            ct[d] = offset;
+            offset += n;
+          }
+        }
+      }
+
+      if(idx)
+      {
+        for(i = start; i < end; i++)
+        {
+          RADIX_KEY key = keys[i];
+          long pos = cb[(key >> shift) & (RADIX_BUCKETS-1)]++;
+          keysTmp[pos] = key;
+          idxB[pos] = idxA[i];
+        }
+      }
+      else
+      {
+        for(i = start; i < end; i++)
+        {
+          RADIX_KEY key = keys[i];
+          keysTmp[cb[(key >> shift) & (RADIX_BUCKETS-1)]++] = key;
+        }
+      }
+#pragma omp barrier
+
+      {
+        RADIX_KEY *tmp = keys;
+        long *tmpi = idxA;
+        keys = keysTmp;
+        keysTmp = tmp;
+        idxA = idxB;
+        idxB = tmpi;
+      }
+    }
+
+    for(i = start; i < end; i++)
+      arr[i*stride] = THTensor_(radixValue)(keys[i] ^ flip);
+    if(idx)
+    {
+      for(i = start; i < end; i++)
+        idx[i*stride] = idxA[i];
+    }
+  }
+}
+#endif
+
+/* The k-th smallest of n values (k starts at 0), selected without moving
+   them: each pass counts the radix keys which share the digits found so far
+   by their next RADIX_BITS bits, and keeps the bucket of the k-th one. The
+   few keys left are then copied and quickselected. */
+#define HISTOGRAM_SELECT_MAX_LEFT 4096
+
+static real THTensor_(histogramSelect)(real *data, ptrdiff_t n, ptrdiff_t k)
+{
+  RADIX_KEY prefix = 0, prefixMask = 0;
+  int shift = 8*sizeof(real);
+  int nThreads = 1;
+  long *count;
+  ptrdiff_t left = n;
+
+#ifdef _OPENMP
+  if(!omp_in_parallel())
+    nThreads = omp_get_max_threads();
+#endif
+  count = THAlloc(nThreads*RADIX_BUCKETS*sizeof(long));
+
+  while(shift > 0 && left > HISTOGRAM_SELECT_MAX_LEFT)
+  {
+    int bits = THMin(RADIX_BITS, shift);
+    RADIX_KEY mask = ((RADIX_KEY)1 << bits) - 1;
+    long chunk = (n + nThreads - 1)/nThreads;
+    int thread;
+    long d;
+
+    shift -= bits;
+#pragma omp parallel for if(n > TH_OMP_OVERHEAD_THRESHOLD) num_threads(nThreads) private(thread)
+    for(thread = 0; thread < nThreads; thread++)
+    {
+      long *c = count + thread*RADIX_BUCKETS;
+      ptrdiff_t i, end = THMin(n, (thread+1)*chunk);
+      memset(c, 0, RADIX_BUCKETS*sizeof(long));
+      for(i = thread*chunk; i < end; i++)
+      {
+        RADIX_KEY key = THTensor_(radixKey)(data[i]);
+        if((key & prefixMask) == prefix)
+          c[(key >> shift) & mask]++;
+      }
+    }
+
+    for(thread = 1; thread < nThreads; thread++)
+      for(d = 0; d <= (long)mask; d++)
+        count[d] += count[thread*RADIX_BUCKETS + d];
+    for(d = 0; k >= count[d]; d++)
+      k -= count[d];
+    prefix |= (RADIX_KEY)d << shift;
+    prefixMask |= mask << shift;
+    left = count[d];
+  }
+  THFree(count);
+
+  /* all the keys left are equal */
+  if(shift == 0)
+    return THTensor_(radixValue)(prefix);
+
+  {
+    real *temp = THAlloc(left*sizeof(real));
+    real value;
+    ptrdiff_t i, j = 0;
+    for(i = 0; i < n; i++)
+    {
+      if((THTensor_(radixKey)(data[i]) & prefixMask) == prefix)
+        temp[j++] = data[i];
+    }
+    THTensor_(quickselectnoidx)(temp, k, left, 1);
+    value = temp[k];
+    THFree(temp);
+    return value;
+  }
+}
+
+#undef HISTOGRAM_SELECT_MAX_LEFT
+
+/* Stable merge sort of n contiguous values, with their indices: runs of
+   MERGE_RUN_SIZE elements are insertion sorted, then merged back and forth
+   with the scratch buffers v2 and ix2. Ties are taken from the left run. */
+#define MERGE_RUN_SIZE 16
+
+static void THTensor_(mergesort)(real *v, long *ix, real *v2, long *ix2, long n, int descendingOrder)
+{
+  real *values = v;
+  long *indices = ix;
+  long start, width, i, j;
+
+  for(start = 0; start < n; start += MERGE_RUN_SIZE)
+  {
+    long end = THMin(n, start + MERGE_RUN_SIZE);
+    for(i = start+1; i < end; i++)
+    {
+      real value = v[i];
+      long index = ix[i];
+      for(j = i; j > start && (descendingOrder ? GT_OR_NAN(value, v[j-1]) : GT_OR_NAN(v[j-1], value)); j--)
+      {
+        v[j] = v[j-1];
+        ix[j] = ix[j-1];
+      }
+      v[j] = value;
+      ix[j] = index;
+    }
+  }
+
+  for(width = MERGE_RUN_SIZE; width < n; width *= 2)
+  {
+    for(start = 0; start < n; start += 2*width)
+    {
+      long mid = THMin(n, start + width);
+      long end = THMin(n, start + 2*width);
+      long k = start;
+
+      i = start;
+      j = mid;
+      while(i < mid && j < end)
+      {
+        if(descendingOrder ? GT_OR_NAN(v[j], v[i]) : GT_OR_NAN(v[i], v[j]))
+        {
+          v2[k] = v[j];
+          ix2[k++] = ix[j++];
+        }
+        else
+        {
+          v2[k] = v[i];
+          ix2[k++] = ix[i++];
+        }
+      }
+      for(; i < mid; i++, k++)
+      {
+        v2[k] = v[i];
+        ix2[k] = ix[i];
+      }
+      for(; j < end; j++, k++)
+      {
+        v2[k] = v[j];
+        ix2[k] = ix[j];
+      }
+    }
+
+    {
+      real *tmp = v;
+      long *tmpi = ix;
+      v = v2;
+      v2 = tmp;
+      ix = ix2;
+      ix2 = tmpi;
+    }
+  }
+
+  if(v != values)
+  {
+    memcpy(values, v, n*sizeof(real));
+    memcpy(indices, ix, n*sizeof(long));
+  }
+}
+
+#undef MERGE_RUN_SIZE
+
+/* Sorts one slice, and its indices unless idx is NULL. Long slices are
+   radix sorted, which is stable. Short ones are quicksorted in place, or
+   copied and sorted contiguously for a stable sort, or without indices.
+   keys, idxBuf and temp are buffers of the sizes given by
+   THTensor_(sortBufferSizes). */
+static void THTensor_(sortSlice)(real *arr, long *idx, long elements, long stride, int descendingOrder, int stable,
+                                 RADIX_KEY *keys, long *idxBuf, real *temp)
+{
+  long i;
+
+  if(elements >= RADIX_MIN_SIZE)
+  {
+    THTensor_(radixsort)(arr, idx, elements, stride, descendingOrder,
+                         keys, keys + elements, idxBuf, idxBuf + elements, idxBuf + 2*elements);
+    return;
+  }
+
+  if(idx && !stable)
+  {
+    for(i = 0; i < elements; i++)
+      idx[i*stride] = i;
+    if(descendingOrder)
+      THTensor_(quicksortdescend)(arr, idx, elements, stride);
+    else
+      THTensor_(quicksortascend)(arr, idx, elements, stride);
+    return;
+  }
+
+  for(i = 0; i < elements; i++)
+  {
+    temp[i] = arr[i*stride];
+    idxBuf[i] = i;
+  }
+  if(stable)
+    THTensor_(mergesort)(temp, idxBuf, temp + elements, idxBuf + elements, elements, descendingOrder);
+  else if(descendingOrder)
+    THTensor_(quicksortdescend)(temp, idxBuf, elements, 1);
+  else
+    THTensor_(quicksortascend)(temp, idxBuf, elements, 1);
+  for(i = 0; i < elements; i++)
+    arr[i*stride] = temp[i];
+  if(idx)
+  {
+    for(i = 0; i < elements; i++)
+      idx[i*stride] = idxBuf[i];
+  }
+}
+
+/* sizes of the buffers of THTensor_(sortSlice), for slices of `size` elements */
+static void THTensor_(sortBufferSizes)(long size, long *keysSize, long *idxSize, long *tempSize)
 {
+  *keysSize = (size >= RADIX_MIN_SIZE ? 2*size : 0);
+  *idxSize = (size >= RADIX_MIN_SIZE ? 2*size + RADIX_DIGITS*RADIX_BUCKETS : 2*size);
+  *tempSize = (size >= RADIX_MIN_SIZE ? 0 : 2*size);
+}
+
+/* offset of the slice number `slice` along dimension, for loops over the
+   slices which run in parallel: it is computed from the sizes and strides
+   of the other dimensions, the last one varying fastest */
+static ptrdiff_t THTensor_(sliceOffset)(int nDimension, const long *size, const long *stride,
+                                        int dimension, long slice)
+{
+  ptrdiff_t offset = 0;
+  int d;
+
+  for(d = nDimension-1; d >= 0; d--)
+  {
+    if(d == dimension)
+      continue;
+    offset += (slice % size[d])*stride[d];
+    slice /= size[d];
+  }
+  return offset;
+}
+
+static real *THTensor_(sliceData)(THTensor *t, int dimension, long slice)
+{
+  return THTensor_(data)(t) + THTensor_(sliceOffset)(t->nDimension, t->size, t->stride, dimension, slice);
+}
+
+static long *THTensor_(sliceIndices)(THLongTensor *t, int dimension, long slice)
+{
+  return THLongTensor_data(t) + THTensor_(sliceOffset)(t->nDimension, t->size, t->stride, dimension, slice);
+}
+
+/* sorts rt_ along dimension, with its indices in ri_ unless ri_ is NULL */
+static void THTensor_(sortImpl)(THTensor *rt_, THLongTensor *ri_, THTensor *t, int dimension,
+                                int descendingOrder, int stable)
+{
+  long size, stride, nSlices, keysSize, idxSize, tempSize, slice;
+  int nThreads = 1;
+  RADIX_KEY *keys = NULL;
+  long *idxBuf = NULL;
+  real *temp = NULL;
+
   THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 2, "invalid dimension %d",
       dimension + TH_INDEX_BASE);
 
   THTensor_(resizeAs)(rt_, t);
   THTensor_(copy)(rt_, t);
 
+  if(ri_)
   {
     THLongStorage *size = THTensor_(newSizeOf)(t);
     THLongTensor_resize(ri_, size, NULL);
     THLongStorage_free(size);
   }
 
-  if(descendingOrder)
+  size = THTensor_(size)(t, dimension);
+  if(size == 0)
+    return;
+  stride = THTensor_(stride)(rt_, dimension);
+  nSlices = THTensor_(nElement)(t)/size;
+  THTensor_(sortBufferSizes)(size, &keysSize, &idxSize, &tempSize);
+#ifdef _OPENMP
+  if(!omp_in_parallel())
+    nThreads = omp_get_max_threads();
+#endif
+
+#ifdef _OPENMP
+  /* slices too few to keep the threads busy, but long enough to be split */
+  if(nThreads > 1 && nSlices < nThreads && size >= RADIX_PARALLEL_MIN_SIZE)
   {
-    TH_TENSOR_DIM_APPLY2(real, rt_, long, ri_, dimension,
-                         long i;
-                         for(i = 0; i < ri__size; i++)
-                           ri__data[i*ri__stride] = i;
-                         THTensor_(quicksortdescend)(rt__data, ri__data, rt__size, rt__stride);)
-      }
+    keys = THAlloc(keysSize*sizeof(RADIX_KEY));
+    idxBuf = THAlloc((2*size + nThreads*RADIX_DIGITS*RADIX_BUCKETS)*sizeof(long));
+    for(slice = 0; slice < nSlices; slice++)
+      THTensor_(radixsortParallel)(THTensor_(sliceData)(rt_, dimension, slice),
+                                   ri_ ? THTensor_(sliceIndices)(ri_, dimension, slice) : NULL,
+                                   size, stride, descendingOrder,
+                                   keys, keys + size, idxBuf, idxBuf + size, idxBuf + 2*size);
+  }
+  /* slices sorted independently, with one set of buffers per thread */
+  else if(nThreads > 1 && nSlices > 1 && nSlices*size > TH_OMP_OVERHEAD_THRESHOLD)
+  {
+    keys = THAlloc(nThreads*keysSize*sizeof(RADIX_KEY));
+    idxBuf = THAlloc(nThreads*idxSize*sizeof(long));
+    temp = THAlloc(nThreads*tempSize*sizeof(real));
+#pragma omp parallel for num_threads(nThreads) private(slice)
+    for(slice = 0; slice < nSlices; slice++)
+    {
+      int thread = omp_get_thread_num();
+      THTensor_(sortSlice)(THTensor_(sliceData)(rt_, dimension, slice),
+                           ri_ ? THTensor_(sliceIndices)(ri_, dimension, slice) : NULL,
+                           size, stride, descendingOrder, stable,
+                           keys + thread*keysSize, idxBuf + thread*idxSize, temp + thread*tempSize);
+    }
+  }
   else
+#endif
   {
-    TH_TENSOR_DIM_APPLY2(real, rt_, long, ri_, dimension,
-                         long i;
-                         for(i = 0; i < ri__size; i++)
-                           ri__data[i*ri__stride] = i;
-                         THTensor_(quicksortascend)(rt__data, ri__data, rt__size, rt__stride);)
-      }
+    keys = THAlloc(keysSize*sizeof(RADIX_KEY));
+    idxBuf = THAlloc(idxSize*sizeof(long));
+    temp = THAlloc(tempSize*sizeof(real));
+    for(slice = 0; slice < nSlices; slice++)
+      THTensor_(sortSlice)(THTensor_(sliceData)(rt_, dimension, slice),
+                           ri_ ? THTensor_(sliceIndices)(ri_, dimension, slice) : NULL,
+                           size, stride, descendingOrder, stable, keys, idxBuf, temp);
+  }
+
+  THFree(keys);
+  THFree(idxBuf);
+  THFree(temp);
+}
+
+void THTensor_(sort)(THTensor *rt_, THLongTensor *ri_, THTensor *t, int dimension, int descendingOrder)
+{
+  THTensor_(sortImpl)(rt_, ri_, t, dimension, descendingOrder, 0);
 }
 
+void THTensor_(stableSort)(THTensor *rt_, THLongTensor *ri_, THTensor *t, int dimension, int descendingOrder)
+{
+  THTensor_(sortImpl)(rt_, ri_, t, dimension, descendingOrder, 1);
+}
+
+void THTensor_(sortValues)(THTensor *rt_, THTensor *t, int dimension, int descendingOrder)
+{
+  THTensor_(sortImpl)(rt_, NULL, t, dimension, descendingOrder, 0);
+}
+
+/* values are grouped by sorting them, in parallel, rather than by hashing:
+   the sorted order gives the unique values and their counts in one pass */
+void THTensor_(unique)(THTensor *values_, THLongTensor *inverse_, THLongTensor *counts_, THTensor *t,
+                       int returnInverse, int returnCounts)
+{
+  ptrdiff_t n = THTensor_(nElement)(t);
+  ptrdiff_t i, nUnique = 0;
+  THTensor *tc, *flat, *sorted;
+  THLongTensor *order = NULL, *inverse = NULL;
+  THLongStorage *size;
+  real *s;
+  long *o = NULL, *inv = NULL, *c = NULL;
+
+  if(n == 0)
+  {
+    THTensor_(resize1d)(values_, 0);
+    if(returnInverse)
+      THLongTensor_resize1d(inverse_, 0);
+    if(returnCounts)
+      THLongTensor_resize1d(counts_, 0);
+    return;
+  }
+
+  tc = THTensor_(newContiguous)(t);
+  flat = THTensor_(newWithStorage1d)(tc->storage, tc->storageOffset, n, 1);
+  sorted = THTensor_(new)();
+  if(returnInverse)
+  {
+    order = THLongTensor_new();
+    THTensor_(sortImpl)(sorted, order, flat, 0, 0, 0);
+    o = THLongTensor_data(order);
+
+    size = THTensor_(newSizeOf)(t);
+    THLongTensor_resize(inverse_, size, NULL);
+    THLongStorage_free(size);
+    inverse = THLongTensor_newContiguous(inverse_);
+    inv = THLongTensor_data(inverse);
+  }
+  else
+    THTensor_(sortImpl)(sorted, NULL, flat, 0, 0, 0);
+  THTensor_(free)(flat);
+  THTensor_(free)(tc);
+
+  if(returnCounts)
+    c = THAlloc(n*sizeof(long));
+
+  /* unique values are packed at the front of the sorted ones */
+  s = THTensor_(data)(sorted);
+  for(i = 0; i < n; i++)
+  {
+    if(i == 0 || s[i] != s[nUnique-1])
+    {
+      s[nUnique] = s[i];
+      if(c)
+        c[nUnique] = 0;
+      nUnique++;
+    }
+    if(c)
+      c[nUnique-1]++;
+    if(inv)
+      inv[o[i]] = nUnique-1;
+  }
+
+  THTensor_(resize1d)(sorted, nUnique);
+  THTensor_(resize1d)(values_, nUnique);
+  THTensor_(copy)(values_, sorted);
+  THTensor_(free)(sorted);
+
+  if(returnInverse)
+  {
+    THLongTensor_freeCopyTo(inverse, inverse_);
+    THLongTensor_free(order);
+  }
+
+  if(returnCounts)
+  {
+    long *counts_data;
+    long counts_stride;
+    THLongTensor_resize1d(counts_, nUnique);
+    counts_data = THLongTensor_data(counts_);
+    counts_stride = THLongTensor_stride(counts_, 0);
+    for(i = 0; i < nUnique; i++)
+      counts_data[i*counts_stride] = c[i];
+    THFree(c);
+  }
+}
+
+/* each thread counts its chunk of t in its own table, the tables are summed
+   at the end: worth it only when they are smaller than the input */
+static void THTensor_(bincountImpl)(THTensor *r_, THLongTensor *t, THTensor *weights, long minlength)
+{
+  ptrdiff_t n = THLongTensor_nElement(t);
+  long nbins = minlength, nParts = 1, part, bin;
+  THLongTensor *tc;
+  THTensor *wc = NULL;
+  long *t_data;
+  real *w = NULL, *r_data;
+  long r_stride;
+  ptrdiff_t chunk;
+  accreal *partial;
+
+  THArgCheck(minlength >= 0, 4, "minlength must be non-negative");
+  if(weights)
+    THArgCheck(THTensor_(nElement)(weights) == n, 3, "weights and input must have the same number of elements");
+
+  tc = THLongTensor_newContiguous(t);
+  t_data = THLongTensor_data(tc);
+  if(n > 0)
+  {
+    long minvalue = THLongTensor_minall(tc);
+    if(minvalue < 0)
+    {
+      THLongTensor_free(tc);
+      THArgCheck(0, 2, "bincount only counts non-negative integers");
+    }
+    nbins = THMax(nbins, THLongTensor_maxall(tc) + 1);
+  }
+  THTensor_(resize1d)(r_, nbins);
+  if(nbins == 0)
+  {
+    THLongTensor_free(tc);
+    return;
+  }
+  if(weights)
+  {
+    wc = THTensor_(newContiguous)(weights);
+    w = THTensor_(data)(wc);
+  }
+
+#ifdef _OPENMP
+  if(!omp_in_parallel() && n > TH_OMP_OVERHEAD_THRESHOLD)
+    nParts = THMax(1, THMin((long)omp_get_max_threads(), (long)(n/nbins)));
+#endif
+  partial = THAlloc(nParts*nbins*sizeof(accreal));
+  chunk = (n + nParts - 1)/nParts;
+
+#pragma omp parallel for if(nParts > 1) num_threads(nParts) private(part)
+  for(part = 0; part < nParts; part++)
+  {
+    accreal *p = partial + part*nbins;
+    ptrdiff_t i, end = THMin(n, (part+1)*chunk);
+    long b;
+    for(b = 0; b < nbins; b++)
+      p[b] = 0;
+    if(w)
+    {
+      for(i = part*chunk; i < end; i++)
+        p[t_data[i]] += w[i];
+    }
+    else
+    {
+      for(i = part*chunk; i < end; i++)
+        p[t_data[i]] += 1;
+    }
+  }
+
+  r_data = THTensor_(data)(r_);
+  r_stride = THTensor_(stride)(r_, 0);
+#pragma omp parallel for if(nParts > 1 && nbins > TH_OMP_OVERHEAD_THRESHOLD) num_threads(nParts) private(bin, part)
+  for(bin = 0; bin < nbins; bin++)
+  {
+    accreal sum = 0;
+    for(part = 0; part < nParts; part++)
+      sum += partial[part*nbins + bin];
+    r_data[bin*r_stride] = (real)sum;
+  }
+
+  THFree(partial);
+  THLongTensor_free(tc);
+  if(wc)
+    THTensor_(free)(wc);
+}
+
+void THTensor_(bincount)(THTensor *r_, THLongTensor *t, long minlength)
+{
+  THTensor_(bincountImpl)(r_, t, NULL, minlength);
+}
+
+void THTensor_(bincountWeighted)(THTensor *r_, THLongTensor *t, THTensor *weights, long minlength)
+{
+  THTensor_(bincountImpl)(r_, t, weights, minlength);
+}
+
+#undef RADIX_KEY
+#undef RADIX_MIN_SIZE
+#undef RADIX_PARALLEL_MIN_SIZE
+#undef RADIX_BITS
+#undef RADIX_BUCKETS
+#undef RADIX_DIGITS
+
+/* queries are searched by blocks, in lockstep: a block goes through the same
+   number of halvings, the comparisons are turned into conditional moves, and
+   the loads of the block are independent, so their cache misses overlap.
+   NaNs are greater than any other value, as in the sort: NaN queries go
+   after the boundaries which are not NaN. */
+#define SEARCH_BLOCK 8
+#define SEARCH_LT(x, y) ((x < y) || (y != y && x == x))
+#define SEARCH_LE(x, y) ((x <= y) || (y != y))
+
+static void THTensor_(searchBlock)(const real *b, long nb, const real *v, long *r, long count, int right)
+{
+  long pos[SEARCH_BLOCK];
+  long len = nb, half, j;
+
+  if(nb == 0)
+  {
+    for(j = 0; j < count; j++)
+      r[j] = 0;
+    return;
+  }
+
+  for(j = 0; j < count; j++)
+    pos[j] = 0;
+  if(right)
+  {
+    while(len > 1)
+    {
+      half = len/2;
+      for(j = 0; j < count; j++)
+        pos[j] += SEARCH_LE(b[pos[j]+half], v[j]) ? half : 0;
+      len -= half;
+    }
+    for(j = 0; j < count; j++)
+      r[j] = pos[j] + SEARCH_LE(b[pos[j]], v[j]);
+  }
+  else
+  {
+    while(len > 1)
+    {
+      half = len/2;
+      for(j = 0; j < count; j++)
+        pos[j] += SEARCH_LT(b[pos[j]+half], v[j]) ? half : 0;
+      len -= half;
+    }
+    for(j = 0; j < count; j++)
+      r[j] = pos[j] + SEARCH_LT(b[pos[j]], v[j]);
+  }
+}
+
+void THTensor_(searchsorted)(THLongTensor *r_, THTensor *boundaries, THTensor *values, int right)
+{
+  THTensor *bc, *vc;
+  THLongTensor *r;
+  THLongStorage *size;
+  const real *b, *v;
+  long *rd;
+  long nb, nRows, rowSize, blocksPerRow, nBlocks, block;
+  int d;
+
+  THArgCheck(THTensor_(nDimension)(boundaries) > 0, 2, "boundaries must not be empty");
+  nb = THTensor_(size)(boundaries, THTensor_(nDimension)(boundaries)-1);
+  nRows = THTensor_(nElement)(boundaries)/nb;
+  if(THTensor_(nDimension)(boundaries) > 1)
+  {
+    THArgCheck(THTensor_(nDimension)(values) == THTensor_(nDimension)(boundaries), 3,
+               "values must have as many dimensions as batched boundaries");
+    for(d = 0; d < THTensor_(nDimension)(boundaries)-1; d++)
+      THArgCheck(THTensor_(size)(values, d) == THTensor_(size)(boundaries, d), 3,
+                 "values and boundaries differ in size at dimension %d", d + TH_INDEX_BASE);
+  }
+
+  size = THTensor_(newSizeOf)(values);
+  THLongTensor_resize(r_, size, NULL);
+  THLongStorage_free(size);
+  if(THTensor_(nElement)(values) == 0)
+    return;
+
+  bc = THTensor_(newContiguous)(boundaries);
+  vc = THTensor_(newContiguous)(values);
+  r = THLongTensor_newContiguous(r_);
+  b = THTensor_(data)(bc);
+  v = THTensor_(data)(vc);
+  rd = THLongTensor_data(r);
+
+  /* with batched boundaries, each row of values has its own */
+  rowSize = THTensor_(nElement)(values)/nRows;
+  blocksPerRow = (rowSize + SEARCH_BLOCK - 1)/SEARCH_BLOCK;
+  nBlocks = nRows*blocksPerRow;
+#pragma omp parallel for if(THTensor_(nElement)(values) > TH_OMP_OVERHEAD_THRESHOLD) private(block)
+  for(block = 0; block < nBlocks; block++)
+  {
+    long row = block/blocksPerRow;
+    long start = (block%blocksPerRow)*SEARCH_BLOCK;
+    long offset = row*rowSize + start;
+    THTensor_(searchBlock)(b + row*nb, nb, v + offset, rd + offset,
+                           THMin(SEARCH_BLOCK, rowSize - start), right);
+  }
+
+  THTensor_(free)(bc);
+  THTensor_(free)(vc);
+  THLongTensor_freeCopyTo(r, r_);
+}
+
+#undef SEARCH_BLOCK
+#undef SEARCH_LT
+#undef SEARCH_LE
+
 /* Implementation of the Quickselect algorithm, based on Nicolas Devillard's
 public domain implementation at http://ndevilla.free.fr/median/median/
 Adapted similarly to the above Quicksort algorithm.
@@ -2417,14 +3300,99 @@ static void THTensor_(quickselect)(real *arr, long *idx, long k, long elements,
 #undef REAL_SWAP
 #undef BOTH_SWAP
 
+/* The mode of a slice is its most frequent value, the smallest one among
+   ties, with the index of its last occurrence. Integer values are counted
+   in a hash table, with linear probing, instead of being sorted. The table
+   holds at most half of the slice, or all the values of 8 and 16 bits
+   types. */
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+static long THTensor_(modeBufferSize)(long n)
+{
+  return n;
+}
+
+static void THTensor_(modeSlice)(real *data, long stride, long n, real *mode, long *modei,
+                                 real *temp, long *tempi, long tableSize)
+{
+  long i, freq = 0, maxFreq = 0, last = 0;
+
+  *mode = 0;
+  *modei = 0;
+
+  for(i = 0; i < n; i++)
+  {
+    temp[i] = data[i*stride];
+    tempi[i] = i;
+  }
+  THTensor_(quicksortascend)(temp, tempi, n, 1);
+
+  for(i = 0; i < n; i++)
+  {
+    freq++;
+    last = THMax(last, tempi[i]);
+    if(i == n-1 || temp[i] != temp[i+1])
+    {
+      if(freq > maxFreq)
+      {
+        *mode = temp[i];
+        *modei = last;
+        maxFreq = freq;
+      }
+      freq = 0;
+      last = 0;
+    }
+  }
+}
+#else
+static long THTensor_(modeBufferSize)(long n)
+{
+  long tableSize = 1;
+  while(tableSize < 2*n && (sizeof(real) > 2 || tableSize < (1L << (8*sizeof(real)))))
+    tableSize *= 2;
+  return tableSize;
+}
+
+static void THTensor_(modeSlice)(real *data, long stride, long n, real *mode, long *modei,
+                                 real *keys, long *counts, long tableSize)
+{
+  long *last = counts + tableSize;
+  long mask = tableSize-1;
+  long i, maxFreq = 0;
+
+  *mode = 0;
+  *modei = 0;
+  memset(counts, 0, tableSize*sizeof(long));
+  for(i = 0; i < n; i++)
+  {
+    real value = data[i*stride];
+    uint64_t hash = (uint64_t)(int64_t)value * 0x9E3779B97F4A7C15ULL;
+    long slot = (long)((hash ^ (hash >> 32)) & mask);
+    while(counts[slot] && keys[slot] != value)
+      slot = (slot+1) & mask;
+    keys[slot] = value;
+    counts[slot]++;
+    last[slot] = i;
+  }
+
+  for(i = 0; i < tableSize; i++)
+  {
+    if(counts[i] > maxFreq || (counts[i] && counts[i] == maxFreq && keys[i] < *mode))
+    {
+      *mode = keys[i];
+      *modei = last[i];
+      maxFreq = counts[i];
+    }
+  }
+}
+#endif
+
 void THTensor_(mode)(THTensor *values_, THLongTensor *indices_, THTensor *t, int dimension, int keepdim)
 {
   THLongStorage *dim;
-  THTensor *temp_;
-  THLongTensor *tempi_;
-  real *temp__data;
-  long *tempi__data;
-  long t_size_dim;
+  long t_size_dim, bufferSize;
+  int nThreads = 1;
+  real *temp;
+  long *tempi;
 
   THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 3, "dimension out of range");
 
@@ -2435,60 +3403,70 @@ void THTensor_(mode)(THTensor *values_, THLongTensor *indices_, THTensor *t, int
   THLongStorage_free(dim);
 
   t_size_dim = THTensor_(size)(t, dimension);
+  bufferSize = THTensor_(modeBufferSize)(t_size_dim);
+#ifdef _OPENMP
+  if(!omp_in_parallel())
+    nThreads = omp_get_max_threads();
+#endif
 
-  temp_ = THTensor_(new)();
-  THTensor_(resize1d)(temp_, t_size_dim);
-  temp__data = THTensor_(data)(temp_);
+  /* the counts of integer types are followed by the last index of each value */
+  temp = THAlloc(nThreads*bufferSize*sizeof(real));
+  tempi = THAlloc(2*nThreads*bufferSize*sizeof(long));
 
-  tempi_ = THLongTensor_new();
-  THLongTensor_resize1d(tempi_, t_size_dim);
-  tempi__data = THLongTensor_data(tempi_);
+#ifdef _OPENMP
+  if(nThreads > 1 && t_size_dim > 0 && THTensor_(nElement)(t) > TH_OMP_OVERHEAD_THRESHOLD)
+  {
+    long nSlices = THTensor_(nElement)(t)/t_size_dim;
+    long t_stride = THTensor_(stride)(t, dimension);
+    long slice;
 
-  TH_TENSOR_DIM_APPLY3(real, t, real, values_, long, indices_, dimension,
-                       long i;
-                       real mode = 0;
-                       long modei = 0;
-                       long temp_freq = 0;
-                       long max_freq = 0;
-                       for(i = 0; i < t_size_dim; i++)
-                          temp__data[i] = t_data[i*t_stride];
-                       for(i = 0; i < t_size_dim; i++)
-                          tempi__data[i] = i;
-                       THTensor_(quicksortascend)(temp__data, tempi__data, t_size_dim, 1);
-
-                       for(i = 0; i < t_size_dim; i++)
-                       {
-                          temp_freq++;
-                          if ((i == t_size_dim - 1) || (temp__data[i] != temp__data[i+1]))
-                          {
-                              if (temp_freq > max_freq)
-                              {
-                                 mode = temp__data[i];
-                                 modei = tempi__data[i];
-                                 max_freq = temp_freq;
-                              }
-                              temp_freq = 0;
-                          }
-                       }
-                       *values__data = mode;
-                       *indices__data = modei;);
+#pragma omp parallel for num_threads(nThreads) private(slice)
+    for(slice = 0; slice < nSlices; slice++)
+    {
+      int thread = omp_get_thread_num();
+      THTensor_(modeSlice)(THTensor_(sliceData)(t, dimension, slice), t_stride, t_size_dim,
+                           THTensor_(sliceData)(values_, dimension, slice),
+                           THTensor_(sliceIndices)(indices_, dimension, slice),
+                           temp + thread*bufferSize, tempi + 2*thread*bufferSize, bufferSize);
+    }
+  }
+  else
+#endif
+  {
+    TH_TENSOR_DIM_APPLY3(real, t, real, values_, long, indices_, dimension,
+                         THTensor_(modeSlice)(t_data, t_stride, t_size_dim, values__data, indices__data,
+                                              temp, tempi, bufferSize););
+  }
 
-  THTensor_(free)(temp_);
-  THLongTensor_free(tempi_);
+  THFree(temp);
+  THFree(tempi);
   if (!keepdim) {
     THTensor_(squeeze1d)(values_, values_, dimension);
     THLongTensor_squeeze1d(indices_, indices_, dimension);
   }
 }
 
+static void THTensor_(kthvalueSlice)(real *data, long stride, long n, long k, real *value, long *index,
+                                     real *temp, long *tempi)
+{
+  long i;
+  for(i = 0; i < n; i++)
+  {
+    temp[i] = data[i*stride];
+    tempi[i] = i;
+  }
+  THTensor_(quickselect)(temp, tempi, k - 1, n, 1);
+  *value = temp[k-1];
+  *index = tempi[k-1];
+}
+
 void THTensor_(kthvalue)(THTensor *values_, THLongTensor *indices_, THTensor *t, long k, int dimension, int keepdim)
 {
   THLongStorage *dim;
-  THTensor *temp_;
-  THLongTensor *tempi_;
-  real *temp__data;
-  long *tempi__data;
   long t_size_dim;
+  int nThreads = 1;
+  real *temp;
+  long *tempi;
 
   THArgCheck(dimension >= 0 && dimension < THTensor_(nDimension)(t), 3, "dimension out of range");
   THArgCheck(k > 0 && k <= t->size[dimension], 2, "selected index out of range");
@@ -2500,27 +3478,41 @@ void THTensor_(kthvalue)(THTensor *values_, THLongTensor *indices_, THTensor *t,
   THLongStorage_free(dim);
 
   t_size_dim = THTensor_(size)(t, dimension);
+#ifdef _OPENMP
+  if(!omp_in_parallel())
+    nThreads = omp_get_max_threads();
+#endif
 
-  temp_ = THTensor_(new)();
-  THTensor_(resize1d)(temp_, t_size_dim);
-  temp__data = THTensor_(data)(temp_);
+  temp = THAlloc(nThreads*t_size_dim*sizeof(real));
+  tempi = THAlloc(nThreads*t_size_dim*sizeof(long));
 
-  tempi_ = THLongTensor_new();
-  THLongTensor_resize1d(tempi_, t_size_dim);
-  tempi__data = THLongTensor_data(tempi_);
+#ifdef _OPENMP
+  if(nThreads > 1 && THTensor_(nElement)(t) > TH_OMP_OVERHEAD_THRESHOLD)
+  {
+    long nSlices = THTensor_(nElement)(t)/t_size_dim;
+    long t_stride = THTensor_(stride)(t, dimension);
+    long slice;
 
-  TH_TENSOR_DIM_APPLY3(real, t, real, values_, long, indices_, dimension,
-                       long i;
-                       for(i = 0; i < t_size_dim; i++)
-                          temp__data[i] = t_data[i*t_stride];
-                       for(i = 0; i < t_size_dim; i++)
-                          tempi__data[i] = i;
-                       THTensor_(quickselect)(temp__data, tempi__data, k - 1, t_size_dim, 1);
-                       *values__data = temp__data[k-1];
-                       *indices__data = tempi__data[k-1];);
+#pragma omp parallel for num_threads(nThreads) private(slice)
+    for(slice = 0; slice < nSlices; slice++)
+    {
+      int thread = omp_get_thread_num();
+      THTensor_(kthvalueSlice)(THTensor_(sliceData)(t, dimension, slice), t_stride, t_size_dim, k,
+                               THTensor_(sliceData)(values_, dimension, slice),
+                               THTensor_(sliceIndices)(indices_, dimension, slice),
+                               temp + thread*t_size_dim, tempi + thread*t_size_dim);
+    }
+  }
+  else
+#endif
+  {
+    TH_TENSOR_DIM_APPLY3(real, t, real, values_, long, indices_, dimension,
+                         THTensor_(kthvalueSlice)(t_data, t_stride, t_size_dim, k, values__data, indices__data,
+                                                  temp, tempi););
+  }
 
-  THTensor_(free)(temp_);
-  THLongTensor_free(tempi_);
+  THFree(temp);
+  THFree(tempi);
   if (!keepdim) {
     THTensor_(squeeze1d)(values_, values_, dimension);
     THLongTensor_squeeze1d(indices_, indices_, dimension);
@@ -2539,6 +3531,238 @@ void THTensor_(median)(THTensor *values_, THLongTensor *indices_, THTensor *t, i
   THTensor_(kthvalue)(values_, indices_, t, k+1, dimension, keepdim);
 }
 
+/* Selection of the k largest (dir = 1) or smallest (dir = 0) elements with
+   a bounded heap, for small k: the source is read once, and only the
+   elements which beat the worst kept one go through the heap. Elements are
+   ranked by value, then by index, so that the selection does not depend on
+   how a slice is split between threads, and NaNs are greater than any
+   other value, as in the sort. The root of the heap is the worst kept
+   element. */
+#define TOPK_HEAP_MAX_K 512 /* larger k are quickselected */
+#define TOPK_HEAP_MIN_RATIO 32 /* slices shorter than TOPK_HEAP_MIN_RATIO*k too */
+#define TOPK_BLOCK_SIZE 64 /* elements compared to the threshold at once */
+#define TOPK_PARALLEL_MIN_SIZE (1 << 18) /* shorter slices are read by a single thread */
+
+/* whether (a, ia) ranks below (b, ib) */
+static inline int THTensor_(topkWorse)(real a, long ia, real b, long ib, int dir)
+{
+  if(a == b || (a != a && b != b))
+    return ia > ib;
+  return dir ? GT_OR_NAN(b, a) : GT_OR_NAN(a, b);
+}
+
+static void THTensor_(topkSiftDown)(real *values, long *indices, long n, long pos, int dir)
+{
+  real value = values[pos];
+  long index = indices[pos];
+
+  for(;;)
+  {
+    long child = 2*pos+1;
+    if(child >= n)
+      break;
+    if(child+1 < n && THTensor_(topkWorse)(values[child+1], indices[child+1], values[child], indices[child], dir))
+      child++;
+    if(!THTensor_(topkWorse)(values[child], indices[child], value, index, dir))
+      break;
+    values[pos] = values[child];
+    indices[pos] = indices[child];
+    pos = child;
+  }
+  values[pos] = value;
+  indices[pos] = index;
+}
+
+/* adds an element to a heap of n <= k elements, and returns its new size */
+static long THTensor_(topkPush)(real *values, long *indices, long n, long k, real value, long index, int dir)
+{
+  long pos;
+
+  if(n == k)
+  {
+    if(THTensor_(topkWorse)(value, index, values[0], indices[0], dir))
+      return n;
+    values[0] = value;
+    indices[0] = index;
+    THTensor_(topkSiftDown)(values, indices, n, 0, dir);
+    return n;
+  }
+
+  for(pos = n; pos > 0; pos = (pos-1)/2)
+  {
+    long parent = (pos-1)/2;
+    if(!THTensor_(topkWorse)(value, index, values[parent], indices[parent], dir))
+      break;
+    values[pos] = values[parent];
+    indices[pos] = indices[parent];
+  }
+  values[pos] = value;
+  indices[pos] = index;
+  return n+1;
+}
+
+/* pushes the elements start to end-1 of a slice into a heap of n elements,
+   and returns its new size. Blocks of elements are first compared to the
+   worst kept element, in a loop the compiler can vectorize: as the heap
+   fills up with good elements, most blocks are skipped at once. */
+static long THTensor_(topkScan)(real *data, long stride, long start, long end, long k, int dir,
+                                real *values, long *indices, long n)
+{
+  long i = start;
+
+  for(; i < end && n < k; i++)
+    n = THTensor_(topkPush)(values, indices, n, k, data[i*stride], i, dir);
+
+  while(i < end)
+  {
+    long blockEnd = THMin(end, i + TOPK_BLOCK_SIZE);
+    real threshold = values[0];
+    int hit = 0;
+    long j;
+
+    if(stride != 1 || threshold != threshold)
+      hit = 1;
+    else if(dir)
+    {
+      for(j = i; j < blockEnd; j++)
+        hit |= GT_OR_NAN(data[j], threshold);
+    }
+    else
+    {
+      for(j = i; j < blockEnd; j++)
+        hit |= GT_OR_NAN(threshold, data[j]);
+    }
+
+    /* later elements lose ties, so only strictly better ones are pushed */
+    if(hit)
+    {
+      for(j = i; j < blockEnd; j++)
+      {
+        real value = data[j*stride];
+        if(dir ? GT_OR_NAN(value, values[0]) : GT_OR_NAN(values[0], value))
+        {
+          values[0] = value;
+          indices[0] = j;
+          THTensor_(topkSiftDown)(values, indices, k, 0, dir);
+        }
+      }
+    }
+    i = blockEnd;
+  }
+  return n;
+}
+
+/* sorts a heap of k elements from the best to the worst, into a slice */
+static void THTensor_(topkStore)(real *values, long *indices, long k, int dir,
+                                 real *rt_data, long rt_stride, long *ri_data, long ri_stride)
+{
+  long n;
+
+  for(n = k-1; n > 0; n--)
+  {
+    real value = values[n];
+    long index = indices[n];
+    values[n] = values[0];
+    indices[n] = indices[0];
+    values[0] = value;
+    indices[0] = index;
+    THTensor_(topkSiftDown)(values, indices, n, 0, dir);
+  }
+  for(n = 0; n < k; n++)
+  {
+    rt_data[n*rt_stride] = values[n];
+    ri_data[n*ri_stride] = indices[n];
+  }
+}
+
+#ifdef _OPENMP
+/* each thread selects the best k elements of a chunk of the slice, and
+   their union is then merged into the heap. buffer holds
+   (omp_get_max_threads()+1)*k values and indices. */
+static void THTensor_(topkParallel)(real *data, long stride, long sliceSize, long k, int dir,
+                                    real *values, long *indices,
+                                    real *rt_data, long rt_stride, long *ri_data, long ri_stride)
+{
+  int nThreads = omp_get_max_threads();
+  long chunk = (sliceSize + nThreads - 1)/nThreads;
+  long *counts = THAlloc(nThreads*sizeof(long));
+  long n = 0, i;
+  int thread;
+
+#pragma omp parallel for num_threads(nThreads) private(thread)
+  for(thread = 0; thread < nThreads; thread++)
+  {
+    long start = THMin(sliceSize, thread*chunk);
+    counts[thread] = THTensor_(topkScan)(data, stride, start, THMin(sliceSize, start + chunk), k, dir,
+                                         values + (thread+1)*k, indices + (thread+1)*k, 0);
+  }
+
+  for(thread = 0; thread < nThreads; thread++)
+    for(i = 0; i < counts[thread]; i++)
+      n = THTensor_(topkPush)(values, indices, n, k,
+                              values[(thread+1)*k + i], indices[(thread+1)*k + i], dir);
+  THFree(counts);
+  THTensor_(topkStore)(values, indices, k, dir, rt_data, rt_stride, ri_data, ri_stride);
+}
+#endif
+
+/* the k best elements of each slice, sorted, with the heap selection */
+static void THTensor_(topkHeap)(THTensor *rt_, THLongTensor *ri_, THTensor *t, long k, int dim, int dir)
+{
+  long sliceSize = THTensor_(size)(t, dim);
+  long nSlices = THTensor_(nElement)(t)/sliceSize;
+  int nThreads = 1;
+  real *values;
+  long *indices;
+
+#ifdef _OPENMP
+  if(!omp_in_parallel())
+    nThreads = omp_get_max_threads();
+
+  /* slices too few to keep the threads busy, but long enough to be split */
+  if(nThreads > 1 && nSlices < nThreads && sliceSize >= TOPK_PARALLEL_MIN_SIZE)
+  {
+    values = THAlloc((nThreads+1)*k*sizeof(real));
+    indices = THAlloc((nThreads+1)*k*sizeof(long));
+    TH_TENSOR_DIM_APPLY3(real, t, real, rt_, long, ri_, dim,
+                         THTensor_(topkParallel)(t_data, t_stride, sliceSize, k, dir, values, indices,
+                                                 rt__data, rt__stride, ri__data, ri__stride););
+  }
+  /* slices selected independently, with one heap per thread */
+  else if(nThreads > 1 && nSlices > 1 && nSlices*sliceSize > TH_OMP_OVERHEAD_THRESHOLD)
+  {
+    long tStride = THTensor_(stride)(t, dim);
+    long rtStride = THTensor_(stride)(rt_, dim);
+    long riStride = THLongTensor_stride(ri_, dim);
+    long slice;
+
+    values = THAlloc(nThreads*k*sizeof(real));
+    indices = THAlloc(nThreads*k*sizeof(long));
+#pragma omp parallel for num_threads(nThreads) private(slice)
+    for(slice = 0; slice < nSlices; slice++)
+    {
+      int thread = omp_get_thread_num();
+      THTensor_(topkScan)(THTensor_(sliceData)(t, dim, slice), tStride, 0, sliceSize, k, dir,
+                          values + thread*k, indices + thread*k, 0);
+      THTensor_(topkStore)(values + thread*k, indices + thread*k, k, dir,
+                           THTensor_(sliceData)(rt_, dim, slice), rtStride,
+                           THTensor_(sliceIndices)(ri_, dim, slice), riStride);
+    }
+  }
+  else
+#endif
+  {
+    values = THAlloc(k*sizeof(real));
+    indices = THAlloc(k*sizeof(long));
+    TH_TENSOR_DIM_APPLY3(real, t, real, rt_, long, ri_, dim,
+                         THTensor_(topkScan)(t_data, t_stride, 0, sliceSize, k, dir, values, indices, 0);
+                         THTensor_(topkStore)(values, indices, k, dir, rt__data, rt__stride, ri__data, ri__stride););
+  }
+
+  THFree(values);
+  THFree(indices);
+}
+
 void THTensor_(topk)(THTensor *rt_, THLongTensor *ri_, THTensor *t, long k, int dim, int dir, int sorted)
 {
   int numDims = THTensor_(nDimension)(t);
@@ -2547,6 +3771,16 @@ void THTensor_(topk)(THTensor *rt_, THLongTensor *ri_, THTensor *t, long k, int
   long sliceSize = THTensor_(size)(t, dim);
   THArgCheck(k > 0 && k <= sliceSize, 2, "k not in range for dimension");
 
+  if (k <= TOPK_HEAP_MAX_K && sliceSize >= TOPK_HEAP_MIN_RATIO*k) {
+    THLongStorage *topKSize = THTensor_(newSizeOf)(t);
+    THLongStorage_set(topKSize, dim, k);
+    THTensor_(resize)(rt_, topKSize, NULL);
+    THLongTensor_resize(ri_, topKSize, NULL);
+    THLongStorage_free(topKSize);
+    THTensor_(topkHeap)(rt_, ri_, t, k, dim, dir);
+    return;
+  }
+
   THTensor *tmpResults = THTensor_(new)();
   THTensor_(resize1d)(tmpResults, sliceSize);
   real *tmp__data = THTensor_(data)(tmpResults);
@@ -2604,6 +3838,12 @@ void THTensor_(topk)(THTensor *rt_, THLongTensor *ri_, THTensor *t, long k, int
   THLongTensor_free(tmpIndices);
 }
 
+#undef TOPK_HEAP_MAX_K
+#undef TOPK_HEAP_MIN_RATIO
+#undef TOPK_BLOCK_SIZE
+#undef TOPK_PARALLEL_MIN_SIZE
+#undef GT_OR_NAN
+
 void THTensor_(tril)(THTensor *r_, THTensor *t, long k)
 {
   long t_size_0, t_size_1;
@@ -101,6 +101,12 @@ TH_API void THTensor_(randperm)(THTensor *r_, THGenerator *_generator, long n);
 
 TH_API void THTensor_(reshape)(THTensor *r_, THTensor *t, THLongStorage *size);
 TH_API void THTensor_(sort)(THTensor *rt_, THLongTensor *ri_, THTensor *t, int dimension, int descendingOrder);
+TH_API void THTensor_(stableSort)(THTensor *rt_, THLongTensor *ri_, THTensor *t, int dimension, int descendingOrder);
+TH_API void THTensor_(sortValues)(THTensor *rt_, THTensor *t, int dimension, int descendingOrder);
+TH_API void THTensor_(unique)(THTensor *values_, THLongTensor *inverse_, THLongTensor *counts_, THTensor *t, int returnInverse, int returnCounts);
+TH_API void THTensor_(bincount)(THTensor *r_, THLongTensor *t, long minlength);
+TH_API void THTensor_(bincountWeighted)(THTensor *r_, THLongTensor *t, THTensor *weights, long minlength);
+TH_API void THTensor_(searchsorted)(THLongTensor *r_, THTensor *boundaries, THTensor *values, int right);
 TH_API void THTensor_(topk)(THTensor *rt_, THLongTensor *ri_, THTensor *t, long k, int dim, int dir, int sorted);
 TH_API void THTensor_(tril)(THTensor *r_, THTensor *t, long k);
 TH_API void THTensor_(triu)(THTensor *r_, THTensor *t, long k);
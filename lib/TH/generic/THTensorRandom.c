@@ -2,30 +2,180 @@
 #define TH_GENERIC_FILE "generic/THTensorRandom.c"
 #else
 
-void THTensor_(random)(THTensor *self, THGenerator *_generator)
-{
+#ifndef TH_RANDOM_FILL_KINDS
+#define TH_RANDOM_FILL_KINDS
+/* Tensors are filled by chunks of generator outputs, converted at once.
+   Philox generators fill the chunks in parallel: element i always gets the
+   output number offset+i of the generator (offset+2*(i/2) and the next one
+   for pairs of normal values), whatever the number of threads. */
+#define TH_RANDOM_CHUNK_SIZE 1024
+#define TH_RANDOM_OMP_THRESHOLD 100000
+enum {
+  TH_RANDOM_FILL_RANDOM,
+  TH_RANDOM_FILL_CLAMPED,
+  TH_RANDOM_FILL_GEOMETRIC,
+  TH_RANDOM_FILL_BERNOULLI,
+  TH_RANDOM_FILL_UNIFORM,
+  TH_RANDOM_FILL_NORMAL,
+  TH_RANDOM_FILL_EXPONENTIAL,
+  TH_RANDOM_FILL_CAUCHY,
+  TH_RANDOM_FILL_LOGNORMAL
+};
+#define TH_RANDOM_UNIFORM(r) ((double)(r) * (1.0/4294967296.0))
+/* number of uniform values drawn at once by multinomial sampling */
+#define TH_MULTINOMIAL_BLOCK_SIZE (1 << 18)
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#endif
+
+/* same conversions as THRandom_random() based code */
 #if defined(TH_REAL_IS_BYTE)
-  TH_TENSOR_APPLY(real, self, *self_data = (unsigned char)(THRandom_random(_generator) % (UCHAR_MAX+1)););
+#define TH_RANDOM_INTEGER(r) (unsigned char)((r) % (UCHAR_MAX+1))
 #elif defined(TH_REAL_IS_CHAR)
-  TH_TENSOR_APPLY(real, self, *self_data = (char)(THRandom_random(_generator) % (CHAR_MAX+1)););
+#define TH_RANDOM_INTEGER(r) (char)((r) % (CHAR_MAX+1))
 #elif defined(TH_REAL_IS_SHORT)
-  TH_TENSOR_APPLY(real, self, *self_data = (short)(THRandom_random(_generator) % (SHRT_MAX+1)););
+#define TH_RANDOM_INTEGER(r) (short)((r) % (SHRT_MAX+1))
 #elif defined(TH_REAL_IS_INT)
-  TH_TENSOR_APPLY(real, self, *self_data = (int)(THRandom_random(_generator) % (INT_MAX+1UL)););
+#define TH_RANDOM_INTEGER(r) (int)((r) % (INT_MAX+1UL))
 #elif defined(TH_REAL_IS_LONG)
-  TH_TENSOR_APPLY(real, self, *self_data = (long)(THRandom_random(_generator) % (LONG_MAX+1UL)););
+#define TH_RANDOM_INTEGER(r) (long)((r) % (LONG_MAX+1UL))
 #elif defined(TH_REAL_IS_FLOAT)
-  TH_TENSOR_APPLY(real, self, *self_data = (float)(THRandom_random(_generator) % ((1UL << FLT_MANT_DIG)+1)););
+#define TH_RANDOM_INTEGER(r) (float)((r) % ((1UL << FLT_MANT_DIG)+1))
 #elif defined(TH_REAL_IS_DOUBLE)
-  TH_TENSOR_APPLY(real, self, *self_data = (double)(THRandom_random(_generator) % ((1ULL << DBL_MANT_DIG)+1)););
-#else
-#error "Unknown type"
+#define TH_RANDOM_INTEGER(r) (double)((r) % ((1ULL << DBL_MANT_DIG)+1))
+#endif
+
+/* converts n outputs of a generator into values of the given kind; normal
+   values use pairs of outputs, and r must hold an even number of them */
+static void THTensor_(randomTransform)(real *data, const uint32_t *r, long n, int kind, double a, double b)
+{
+  long i;
+  switch(kind)
+  {
+    case TH_RANDOM_FILL_RANDOM:
+      for(i = 0; i < n; i++)
+        data[i] = TH_RANDOM_INTEGER((unsigned long)r[i]);
+      break;
+    case TH_RANDOM_FILL_CLAMPED:
+      for(i = 0; i < n; i++)
+        data[i] = (real)(((unsigned long)r[i] % (long)(b - a)) + (long)a);
+      break;
+    case TH_RANDOM_FILL_GEOMETRIC:
+      for(i = 0; i < n; i++)
+        data[i] = (real)((int)(log(1-TH_RANDOM_UNIFORM(r[i])) / log(a)) + 1);
+      break;
+    case TH_RANDOM_FILL_BERNOULLI:
+      for(i = 0; i < n; i++)
+        data[i] = (real)(TH_RANDOM_UNIFORM(r[i]) <= a);
+      break;
+#if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
+    case TH_RANDOM_FILL_UNIFORM:
+      for(i = 0; i < n; i++)
+        data[i] = (real)(TH_RANDOM_UNIFORM(r[i]) * (b - a) + a);
+      break;
+    case TH_RANDOM_FILL_NORMAL:
+    case TH_RANDOM_FILL_LOGNORMAL:
+      /* Box-Muller, as THRandom_normal() */
+      for(i = 0; i < n; i += 2)
+      {
+        double x = TH_RANDOM_UNIFORM(r[i]);
+        double rho = sqrt(-2. * log(1.0-TH_RANDOM_UNIFORM(r[i+1])));
+        double y0 = rho*cos(2.*M_PI*x)*b+a;
+        double y1 = rho*sin(2.*M_PI*x)*b+a;
+        if(kind == TH_RANDOM_FILL_LOGNORMAL)
+        {
+          y0 = exp(y0);
+          y1 = exp(y1);
+        }
+        data[i] = (real)y0;
+        if(i+1 < n)
+          data[i+1] = (real)y1;
+      }
+      break;
+    case TH_RANDOM_FILL_EXPONENTIAL:
+      for(i = 0; i < n; i++)
+        data[i] = (real)(-1. / a * log(1-TH_RANDOM_UNIFORM(r[i])));
+      break;
+    case TH_RANDOM_FILL_CAUCHY:
+      for(i = 0; i < n; i++)
+        data[i] = (real)(a + b * tan(M_PI*(TH_RANDOM_UNIFORM(r[i])-0.5)));
+      break;
 #endif
+    default:
+      THError("invalid random fill");
+  }
+}
+
+static void THTensor_(randomFill)(THTensor *self, THGenerator *_generator, int kind, double a, double b)
+{
+  THTensor *tensor = self;
+  long size = THTensor_(nElement)(self);
+  int isPaired = (kind == TH_RANDOM_FILL_NORMAL || kind == TH_RANDOM_FILL_LOGNORMAL);
+  real *data;
+  long start;
+
+  if(!THTensor_(isContiguous)(self))
+  {
+    tensor = THTensor_(new)();
+    THTensor_(resizeAs)(tensor, self);
+  }
+  data = THTensor_(data)(tensor);
+
+  if(THGenerator_type(_generator) == TH_GENERATOR_PHILOX)
+  {
+    long nChunks = (size + TH_RANDOM_CHUNK_SIZE - 1) / TH_RANDOM_CHUNK_SIZE;
+    uint64_t offset = THRandom_offset(_generator);
+    long chunk;
+#pragma omp parallel for if(size > TH_RANDOM_OMP_THRESHOLD) private(chunk)
+    for(chunk = 0; chunk < nChunks; chunk++)
+    {
+      uint32_t r[TH_RANDOM_CHUNK_SIZE];
+      long start = chunk*TH_RANDOM_CHUNK_SIZE;
+      long n = (size - start < TH_RANDOM_CHUNK_SIZE ? size - start : TH_RANDOM_CHUNK_SIZE);
+      THRandom_randomAt(_generator, offset + start, r, isPaired ? (n+1)/2*2 : n);
+      THTensor_(randomTransform)(data + start, r, n, kind, a, b);
+    }
+    THRandom_skip(_generator, isPaired ? (size+1)/2*2 : size);
+  }
+  else
+  {
+    /* same numbers as one THRandom_* call per element */
+    for(start = 0; start < size; start += TH_RANDOM_CHUNK_SIZE)
+    {
+      long n = (size - start < TH_RANDOM_CHUNK_SIZE ? size - start : TH_RANDOM_CHUNK_SIZE);
+      if(isPaired)
+      {
+        double y[TH_RANDOM_CHUNK_SIZE];
+        long i;
+        THRandom_normalFill(_generator, y, n, a, b);
+        for(i = 0; i < n; i++)
+          data[start+i] = (real)(kind == TH_RANDOM_FILL_LOGNORMAL ? exp(y[i]) : y[i]);
+      }
+      else
+      {
+        uint32_t r[TH_RANDOM_CHUNK_SIZE];
+        THRandom_randomFill(_generator, r, n);
+        THTensor_(randomTransform)(data + start, r, n, kind, a, b);
+      }
+    }
+  }
+
+  if(tensor != self)
+  {
+    THTensor_(copy)(self, tensor);
+    THTensor_(free)(tensor);
+  }
+}
+
+void THTensor_(random)(THTensor *self, THGenerator *_generator)
+{
+  THTensor_(randomFill)(self, _generator, TH_RANDOM_FILL_RANDOM, 0, 0);
 }
 
 void THTensor_(clampedRandom)(THTensor *self, THGenerator *_generator, long min, long max) {
   THArgCheck(max > min, 2, "max must be greater than min");
-  TH_TENSOR_APPLY(real, self, *self_data = (real)((THRandom_random(_generator) % (max - min)) + min);)
+  THTensor_(randomFill)(self, _generator, TH_RANDOM_FILL_CLAMPED, min, max);
 }
 
 void THTensor_(cappedRandom)(THTensor *self, THGenerator *_generator, long max) {
@@ -35,34 +185,65 @@ void THTensor_(cappedRandom)(THTensor *self, THGenerator *_generator, long max)
 
 void THTensor_(geometric)(THTensor *self, THGenerator *_generator, double p)
 {
-  TH_TENSOR_APPLY(real, self, *self_data = (real)THRandom_geometric(_generator, p););
+  THArgCheck(p > 0 && p < 1, 2, "must be > 0 and < 1");
+  THTensor_(randomFill)(self, _generator, TH_RANDOM_FILL_GEOMETRIC, p, 0);
 }
 
 void THTensor_(bernoulli)(THTensor *self, THGenerator *_generator, double p)
 {
-  TH_TENSOR_APPLY(real, self, *self_data = (real)THRandom_bernoulli(_generator, p););
+  THArgCheck(p >= 0 && p <= 1, 2, "must be >= 0 and <= 1");
+  THTensor_(randomFill)(self, _generator, TH_RANDOM_FILL_BERNOULLI, p, 0);
 }
 
 void THTensor_(bernoulli_FloatTensor)(THTensor *self, THGenerator *_generator, THFloatTensor *p)
 {
-  TH_TENSOR_APPLY2(real, self, float, p, *self_data = (real)THRandom_bernoulli(_generator, (double)*p_data););
+  THDoubleTensor *u;
+  int valid = 1;
+
+  /* checked before u exists, so that errors do not leak it */
+  THArgCheck(THFloatTensor_nElement(p) == THTensor_(nElement)(self), 3, "inconsistent tensor size");
+  TH_TENSOR_APPLY(float, p, if(!(*p_data >= 0 && *p_data <= 1)) valid = 0;);
+  THArgCheck(valid, 3, "must be >= 0 and <= 1");
+
+  /* uniform values drawn in bulk, then compared to p */
+  u = THDoubleTensor_new();
+  THDoubleTensor_resizeNd(u, self->nDimension, self->size, NULL);
+  THDoubleTensor_uniform(u, _generator, 0, 1);
+  TH_TENSOR_APPLY3(real, self, float, p, double, u,
+                   *self_data = (real)(*u_data <= (double)*p_data););
+  THDoubleTensor_free(u);
 }
 
 void THTensor_(bernoulli_DoubleTensor)(THTensor *self, THGenerator *_generator, THDoubleTensor *p)
 {
-  TH_TENSOR_APPLY2(real, self, double, p, *self_data = (real)THRandom_bernoulli(_generator, (double)*p_data););
+  THDoubleTensor *u;
+  int valid = 1;
+
+  /* checked before u exists, so that errors do not leak it */
+  THArgCheck(THDoubleTensor_nElement(p) == THTensor_(nElement)(self), 3, "inconsistent tensor size");
+  TH_TENSOR_APPLY(double, p, if(!(*p_data >= 0 && *p_data <= 1)) valid = 0;);
+  THArgCheck(valid, 3, "must be >= 0 and <= 1");
+
+  /* uniform values drawn in bulk, then compared to p */
+  u = THDoubleTensor_new();
+  THDoubleTensor_resizeNd(u, self->nDimension, self->size, NULL);
+  THDoubleTensor_uniform(u, _generator, 0, 1);
+  TH_TENSOR_APPLY3(real, self, double, p, double, u,
+                   *self_data = (real)(*u_data <= (double)*p_data););
+  THDoubleTensor_free(u);
 }
 
 #if defined(TH_REAL_IS_FLOAT) || defined(TH_REAL_IS_DOUBLE)
 
 void THTensor_(uniform)(THTensor *self, THGenerator *_generator, double a, double b)
 {
-  TH_TENSOR_APPLY(real, self, *self_data = (real)THRandom_uniform(_generator, a, b););
+  THTensor_(randomFill)(self, _generator, TH_RANDOM_FILL_UNIFORM, a, b);
 }
 
 void THTensor_(normal)(THTensor *self, THGenerator *_generator, double mean, double stdv)
 {
-  TH_TENSOR_APPLY(real, self, *self_data = (real)THRandom_normal(_generator, mean, stdv););
+  THArgCheck(stdv > 0, 3, "standard deviation must be strictly positive");
+  THTensor_(randomFill)(self, _generator, TH_RANDOM_FILL_NORMAL, mean, stdv);
 }
 
 void THTensor_(normal_means)(THTensor *self, THGenerator *gen, THTensor *means, double stddev)
@@ -90,136 +271,303 @@ void THTensor_(normal_means_stddevs)(THTensor *self, THGenerator *gen, THTensor
 
 void THTensor_(exponential)(THTensor *self, THGenerator *_generator, double lambda)
 {
-  TH_TENSOR_APPLY(real, self, *self_data = (real)THRandom_exponential(_generator, lambda););
+  THTensor_(randomFill)(self, _generator, TH_RANDOM_FILL_EXPONENTIAL, lambda, 0);
 }
 
 void THTensor_(cauchy)(THTensor *self, THGenerator *_generator, double median, double sigma)
 {
-  TH_TENSOR_APPLY(real, self, *self_data = (real)THRandom_cauchy(_generator, median, sigma););
+  THTensor_(randomFill)(self, _generator, TH_RANDOM_FILL_CAUCHY, median, sigma);
 }
 
 void THTensor_(logNormal)(THTensor *self, THGenerator *_generator, double mean, double stdv)
 {
-  TH_TENSOR_APPLY(real, self, *self_data = (real)THRandom_logNormal(_generator, mean, stdv););
+  THArgCheck(stdv > 0, 3, "standard deviation must be strictly positive");
+  THTensor_(randomFill)(self, _generator, TH_RANDOM_FILL_LOGNORMAL, mean, stdv);
 }
 
 
-void THTensor_(multinomialAliasSetup)(THTensor *probs, THLongTensor *J, THTensor *q)
+/* alias table of a distribution of K categories, in J and q; returns 0 if
+   a probability is not positive */
+static int THTensor_(aliasSetupRow)(const real *probs, long probsStride, long K,
+                                    long *J, real *q, long *smaller, long *larger)
 {
-  long inputsize = THTensor_(nElement)(probs);
-  long i = 0;
-  THLongTensor *smaller = THLongTensor_newWithSize1d(inputsize);
-  THLongTensor *larger = THLongTensor_newWithSize1d(inputsize);
   long small_c = 0;
   long large_c = 0;
-  THLongTensor_resize1d(J, inputsize);
-  THTensor_(resize1d)(q, inputsize);
-  real *q_data = THTensor_(data)(q);
-  long *J_data = THLongTensor_data(J);
-      
-  for(i = 0; i < inputsize; i++)
-    {
-      THTensor_fastSet1d(J, i, 0L);
-      real val = THTensor_fastGet1d(probs, i);
-      THTensor_fastSet1d(q, i, inputsize*val);
-      
-      if (inputsize * val < 1.0)
-        {
-          THTensor_fastSet1d(smaller, small_c, i);
-          small_c += 1;
-        }
-      else
-        {
-          THTensor_fastSet1d(larger, large_c, i);
-          large_c += 1;
-        }
-    }
+  long large, small;
+  real q_min, q_max;
+  long i;
+
+  for(i = 0; i < K; i++)
+  {
+    real val = probs[i*probsStride];
+    J[i] = 0;
+    q[i] = K*val;
+    if(K * val < 1.0)
+      smaller[small_c++] = i;
+    else
+      larger[large_c++] = i;
+  }
 
   // Loop through and create little binary mixtures that
   // appropriately allocate the larger outcomes over the
   // overall uniform mixture.
-  long large, small;
   while(small_c > 0 && large_c > 0)
-    {
-      large = THTensor_fastGet1d(larger, large_c-1);
-      small = THTensor_fastGet1d(smaller, small_c-1);
-      
-      THTensor_fastSet1d(J, small, large);
-      q_data[large * q->stride[0]] -= 1.0 - THTensor_fastGet1d(q, small);
+  {
+    large = larger[large_c-1];
+    small = smaller[small_c-1];
 
-      if(q_data[large * q->stride[0]] < 1.0)
-        {
-          THTensor_fastSet1d(smaller, small_c-1, large);
-          large_c -= 1;
-        }
-      else
-        {
-          THTensor_fastSet1d(larger, large_c-1, large);
-          small_c -= 1;
-        }
-    }
+    J[small] = large;
+    q[large] -= 1.0 - q[small];
 
-  real q_min = THTensor_fastGet1d(q, inputsize-1);
-  real q_max = q_min;
-  real q_temp;
-  for(i=0; i < inputsize; i++)
+    if(q[large] < 1.0)
     {
-      q_temp = THTensor_fastGet1d(q, i);
-      if(q_temp < q_min)
-        q_min = q_temp;
-      else if(q_temp > q_max)
-        q_max = q_temp;
+      smaller[small_c-1] = large;
+      large_c -= 1;
     }
-  THArgCheckWithCleanup((q_min > 0),
-                        THCleanup(THLongTensor_free(smaller); THLongTensor_free(larger);), 2,
-                        "q_min is less than 0");
-  
+    else
+    {
+      larger[large_c-1] = large;
+      small_c -= 1;
+    }
+  }
+
+  q_min = q[K-1];
+  q_max = q_min;
+  for(i = 0; i < K; i++)
+  {
+    if(q[i] < q_min)
+      q_min = q[i];
+    else if(q[i] > q_max)
+      q_max = q[i];
+  }
+  if(!(q_min > 0))
+    return 0;
+
   if(q_max > 1)
+  {
+    for(i = 0; i < K; i++)
+      q[i] /= q_max;
+  }
+  for(i = 0; i < K; i++)
+  {
+    // sometimes an large index isn't added to J.
+    // fix it by making the probability 1 so that J isn't indexed.
+    if(J[i] <= 0)
+      q[i] = 1.0;
+  }
+  return 1;
+}
+
+/* n draws from an alias table, with two generator outputs each */
+static void THTensor_(aliasDrawRow)(long *self, long selfStride, long n, const uint32_t *r,
+                                    const long *J, const real *q, long K)
+{
+  long i;
+  for(i = 0; i < n; i++)
+  {
+    long rand_ind = (long)(TH_RANDOM_UNIFORM(r[2*i]) * K);
+    int mask = (TH_RANDOM_UNIFORM(r[2*i+1]) <= (double)q[rand_ind]);
+    long sample_idx = J[rand_ind]*(1 - mask) + (rand_ind+1L) * mask;
+    self[i*selfStride] = sample_idx-1L;
+  }
+}
+
+/* n_sample categories of a distribution, from as many uniform numbers; cum is
+   a buffer of n_categories values. Returns 0 if the distribution is invalid. */
+static int THTensor_(multinomialRow)(long *self, long selfStride, const real *probs, long probsStride,
+                                     long n_categories, const double *uniform, int n_sample,
+                                     int with_replacement, double *cum)
+{
+  double sum = 0;
+  long j, k;
+
+  /* Get normalized cumulative distribution from prob distribution */
+  for(j = 0; j < n_categories; j++)
+  {
+    sum += probs[j*probsStride];
+    cum[j] = sum;
+  }
+  if(!(sum > 0))
+    return 0;
+  /* normalize cumulative probability distribution so that last val is 1
+     i.e. doesn't assume original prob_dist row sums to one */
+  for(j = 0; j < n_categories; j++)
+    cum[j] /= sum;
+
+  for(j = 0; j < n_sample; j++)
+  {
+    double uniform_sample = uniform[j];
+    const double *base = cum;
+    long len = n_categories;
+    long sample_idx;
+
+    /* Make sure the last cumulative distribution bucket sums to 1 */
+    cum[n_categories-1] = 1;
+
+    /* Branchless binary search for the first slot with
+       uniform_sample <= cum_dist[slot] */
+    while(len > 1)
     {
-      for(i=0; i < inputsize; i++)
-        {
-          q_data[i*q->stride[0]] /= q_max;
-        }
+      long half = len / 2;
+      base = (base[half] < uniform_sample ? base + half : base);
+      len -= half;
     }
-  for(i=0; i<inputsize; i++)
+    sample_idx = (base - cum) + (*base < uniform_sample);
+
+    /* store in result tensor (will be incremented for lua compat by wrapper) */
+    self[j*selfStride] = sample_idx;
+
+    /* Once a sample is drawn, it cannot be drawn again. ie sample without replacement */
+    if(!with_replacement)
     {
-      // sometimes an large index isn't added to J. 
-      // fix it by making the probability 1 so that J isn't indexed.
-      if(J_data[i] <= 0)
-        q_data[i] = 1.0;
+      /* marginal cumulative mass (i.e. original probability) of sample */
+      double diff = cum[sample_idx] - (sample_idx != 0 ? cum[sample_idx-1] : 0);
+      /* new sum of marginals is not one anymore... */
+      double new_sum = 1.0 - diff;
+      for(k = 0; k < n_categories; k++)
+      {
+        double new_val = cum[k];
+        /* remove sampled probability mass from later cumulative probabilities */
+        if(k >= sample_idx)
+          new_val -= diff;
+        /* make total marginals sum to one */
+        cum[k] = new_val / new_sum;
+      }
     }
-  THLongTensor_free(smaller);
-  THLongTensor_free(larger);
+  }
+  return 1;
+}
+
+void THTensor_(multinomialAliasSetup)(THTensor *probs, THLongTensor *J, THTensor *q)
+{
+  long inputsize = THTensor_(nElement)(probs);
+  long *smaller = THAlloc(sizeof(long)*inputsize);
+  long *larger = THAlloc(sizeof(long)*inputsize);
+  THTensor *probs_ = THTensor_(newContiguous)(probs);
+  int isValid;
+
+  THLongTensor_resize1d(J, inputsize);
+  THTensor_(resize1d)(q, inputsize);
+  isValid = THTensor_(aliasSetupRow)(THTensor_(data)(probs_), 1, inputsize,
+                                     THLongTensor_data(J), THTensor_(data)(q), smaller, larger);
+  THTensor_(free)(probs_);
+  THFree(smaller);
+  THFree(larger);
+  THArgCheck(isValid, 2, "q_min is less than 0");
 }
+
 void THTensor_(multinomialAliasDraw)(THLongTensor *self, THGenerator *_generator, THLongTensor *J, THTensor *q)
 {
   long K = THLongTensor_nElement(J);
   long output_nelem = THLongTensor_nElement(self);
-  
-  int i = 0, _mask=0;
-  real _q;
-  long rand_ind, sample_idx, J_sample, kk_sample;
-  for(i=0; i< output_nelem; i++)
-    {
-      rand_ind = (long)THRandom_uniform(_generator, 0, K) ;
-      _q = THTensor_fastGet1d(q, rand_ind);
+  THLongTensor *J_ = THLongTensor_newContiguous(J);
+  THTensor *q_ = THTensor_(newContiguous)(q);
+  uint32_t r[2*TH_RANDOM_CHUNK_SIZE];
+  long start;
 
-      _mask = THRandom_bernoulli(_generator, _q);
-      
-      J_sample = THTensor_fastGet1d(J, rand_ind);
+  for(start = 0; start < output_nelem; start += TH_RANDOM_CHUNK_SIZE)
+  {
+    long n = (output_nelem - start < TH_RANDOM_CHUNK_SIZE ? output_nelem - start : TH_RANDOM_CHUNK_SIZE);
+    THRandom_randomFill(_generator, r, 2*n);
+    THTensor_(aliasDrawRow)(THLongTensor_data(self) + start*self->stride[0], self->stride[0], n, r,
+                            THLongTensor_data(J_), THTensor_(data)(q_), K);
+  }
+  THLongTensor_free(J_);
+  THTensor_(free)(q_);
+}
 
-      sample_idx = J_sample*(1 -_mask) + (rand_ind+1L) * _mask;
+void THTensor_(multinomialAliasSetupBatch)(THTensor *probs, THLongTensor *J, THTensor *q)
+{
+  long n_dist, K, i;
+  long *buffer;
+  int nThreads = 1;
+  int isValid = 1;
+
+  THArgCheck(THTensor_(nDimension)(probs) == 2, 1, "2D tensor of distributions expected");
+  n_dist = THTensor_(size)(probs, 0);
+  K = THTensor_(size)(probs, 1);
+  THLongTensor_resize2d(J, n_dist, K);
+  THTensor_(resize2d)(q, n_dist, K);
+  THArgCheck(THLongTensor_isContiguous(J), 2, "alias tensor must be contiguous");
+  THArgCheck(THTensor_(isContiguous)(q), 3, "probability tensor must be contiguous");
+
+#ifdef _OPENMP
+  nThreads = omp_get_max_threads();
+#endif
+  /* small and large categories of each thread */
+  buffer = THAlloc(sizeof(long)*2*K*nThreads);
 
-      THTensor_fastSet1d(self, i, sample_idx-1L);
+#pragma omp parallel for if(n_dist*K > TH_RANDOM_OMP_THRESHOLD) private(i)
+  for(i = 0; i < n_dist; i++)
+  {
+    int thread = 0;
+#ifdef _OPENMP
+    thread = omp_get_thread_num();
+#endif
+    if(!THTensor_(aliasSetupRow)(THTensor_(data)(probs) + i*probs->stride[0], probs->stride[1], K,
+                                 THLongTensor_data(J) + i*K, THTensor_(data)(q) + i*K,
+                                 buffer + 2*K*thread, buffer + 2*K*thread + K))
+      isValid = 0;
+  }
+
+  THFree(buffer);
+  THArgCheck(isValid, 1, "q_min is less than 0");
+}
+
+void THTensor_(multinomialAliasDrawBatch)(THLongTensor *self, THGenerator *_generator, THLongTensor *J, THTensor *q)
+{
+  long n_dist, K, n_sample, rowsPerBlock, start, i;
+  THLongTensor *J_;
+  THTensor *q_;
+  uint32_t *r;
+
+  THArgCheck(THLongTensor_nDimension(J) == 2, 3, "2D alias tensor expected");
+  n_dist = THLongTensor_size(J, 0);
+  K = THLongTensor_size(J, 1);
+  THArgCheck(THTensor_(nDimension)(q) == 2 && THTensor_(size)(q, 0) == n_dist && THTensor_(size)(q, 1) == K, 4,
+             "probability and alias tensors must have the same size");
+  THArgCheck(THLongTensor_nDimension(self) == 2 && THLongTensor_size(self, 0) == n_dist, 1,
+             "2D output tensor with one row per distribution expected");
+  n_sample = THLongTensor_size(self, 1);
+  if(n_sample == 0)
+    return;
+
+  J_ = THLongTensor_newContiguous(J);
+  q_ = THTensor_(newContiguous)(q);
+  rowsPerBlock = TH_MULTINOMIAL_BLOCK_SIZE / (2*n_sample);
+  if(rowsPerBlock < 1)
+    rowsPerBlock = 1;
+  if(rowsPerBlock > n_dist)
+    rowsPerBlock = n_dist;
+  r = THAlloc(sizeof(uint32_t)*2*n_sample*rowsPerBlock);
+
+  for(start = 0; start < n_dist; start += rowsPerBlock)
+  {
+    long nRows = (n_dist - start < rowsPerBlock ? n_dist - start : rowsPerBlock);
+    THRandom_randomFill(_generator, r, 2*n_sample*nRows);
+#pragma omp parallel for if(nRows*n_sample > TH_RANDOM_OMP_THRESHOLD) private(i)
+    for(i = 0; i < nRows; i++)
+    {
+      long row = start + i;
+      THTensor_(aliasDrawRow)(THLongTensor_data(self) + row*self->stride[0], self->stride[1], n_sample,
+                              r + 2*n_sample*i, THLongTensor_data(J_) + row*K, THTensor_(data)(q_) + row*K, K);
     }
+  }
+
+  THFree(r);
+  THLongTensor_free(J_);
+  THTensor_(free)(q_);
 }
+
 void THTensor_(multinomial)(THLongTensor *self, THGenerator *_generator, THTensor *prob_dist, int n_sample, int with_replacement)
 {
   int start_dim = THTensor_(nDimension)(prob_dist);
   long n_dist;
   long n_categories;
-  THDoubleTensor* cum_dist;
-  int i,j,k;
+  long rowsPerBlock, start, i;
+  double *uniform, *cum_dist;
+  int nThreads = 1;
+  int isValid = 1;
 
   if (start_dim == 1)
   {
@@ -237,135 +585,58 @@ void THTensor_(multinomial)(THLongTensor *self, THGenerator *_generator, THTenso
     "cannot sample n_sample > prob_dist:size(1) samples without replacement");
   }
 
-  /* cumulative probability distribution vector */
-  cum_dist = THDoubleTensor_newWithSize1d(n_categories);
-
   /* will contain multinomial samples (category indices to be returned) */
   THLongTensor_resize2d(self, n_dist , n_sample);
 
-  for (i=0; i<n_dist; i++)
-  {
-    /* Get normalized cumulative distribution from prob distribution */
-    double sum = 0;
-    for (j=0; j<n_categories; j++)
-    {
-      sum += THStorage_(get)( \
-        prob_dist->storage, \
-        prob_dist->storageOffset+i*prob_dist->stride[0]+j*prob_dist->stride[1] \
-      );
-      THDoubleStorage_set(
-        cum_dist->storage, \
-        cum_dist->storageOffset+j*cum_dist->stride[0], \
-        sum \
-      );
-    }
-    THArgCheckWithCleanup((sum > 0), THCleanup(THDoubleTensor_free(cum_dist);), 2,
-                          "invalid multinomial distribution (sum of probabilities <= 0)");
-    /* normalize cumulative probability distribution so that last val is 1
-    i.e. doesn't assume original prob_dist row sums to one */
-    if ( (sum > 0) || ( ( sum < 1.00001) && (sum > 0.99999) ) )
-    {
-      for (j=0; j<n_categories; j++)
-      {
-        THDoubleTensor_data(cum_dist)[j*cum_dist->stride[0]] /= sum;
-      }
-    }
+  /* Rows are sampled in parallel, by blocks whose uniform numbers are drawn
+     beforehand in the order of a serial draw: the samples do not depend on
+     the number of threads. */
+  rowsPerBlock = TH_MULTINOMIAL_BLOCK_SIZE / n_sample;
+  if(rowsPerBlock < 1)
+    rowsPerBlock = 1;
+  if(rowsPerBlock > n_dist)
+    rowsPerBlock = n_dist;
+#ifdef _OPENMP
+  nThreads = omp_get_max_threads();
+#endif
+  uniform = THAlloc(sizeof(double)*n_sample*rowsPerBlock);
+  /* cumulative probability distribution vector of each thread */
+  cum_dist = THAlloc(sizeof(double)*n_categories*nThreads);
 
-    for (j=0; j<n_sample; j++)
+  for(start = 0; start < n_dist && isValid; start += rowsPerBlock)
+  {
+    long nRows = (n_dist - start < rowsPerBlock ? n_dist - start : rowsPerBlock);
+    THRandom_uniformFill(_generator, uniform, n_sample*nRows, 0, 1);
+#pragma omp parallel for if(nRows*n_categories > TH_RANDOM_OMP_THRESHOLD) private(i)
+    for(i = 0; i < nRows; i++)
     {
-      /* sample a probability mass from a uniform distribution */
-      double uniform_sample = THRandom_uniform(_generator, 0, 1);
-      /* Do a binary search for the slot in which the prob falls
-      ie cum_dist[row][slot-1] < uniform_prob < cum_distr[row][slot] */
-      int left_pointer = 0;
-      int right_pointer = n_categories;
-      int mid_pointer;
-      double cum_prob;
-      int sample_idx;
-      /* Make sure the last cumulative distribution bucket sums to 1 */
-      THDoubleTensor_data(cum_dist)[(n_categories-1)*cum_dist->stride[0]] = 1;
-
-      while(right_pointer - left_pointer > 0)
-      {
-          mid_pointer = left_pointer + (right_pointer - left_pointer) / 2;
-          cum_prob = THDoubleStorage_get( \
-            cum_dist->storage, \
-            cum_dist->storageOffset+mid_pointer*cum_dist->stride[0] \
-          );
-          if (cum_prob < uniform_sample)
-          {
-            left_pointer = mid_pointer + 1;
-          }
-          else
-          {
-            right_pointer = mid_pointer;
-          }
-      }
-      sample_idx = left_pointer;
-
-       /* store in result tensor (will be incremented for lua compat by wrapper) */
-      THLongStorage_set( \
-        self->storage, \
-        self->storageOffset+i*self->stride[0]+j*self->stride[1], \
-        sample_idx \
-      );
-
-      /* Once a sample is drawn, it cannot be drawn again. ie sample without replacement */
-      if (!with_replacement)
-      {
-        /* update cumulative distribution so that sample cannot be drawn again */
-        double diff;
-        double new_val = 0;
-        double sum;
-
-        if (sample_idx != 0)
-        {
-          new_val = THDoubleStorage_get( \
-            cum_dist->storage, \
-            cum_dist->storageOffset+(sample_idx-1)*cum_dist->stride[0] \
-          );
-        }
-        /* marginal cumulative mass (i.e. original probability) of sample */
-        diff = THDoubleStorage_get( \
-          cum_dist->storage, \
-          cum_dist->storageOffset+sample_idx*cum_dist->stride[0] \
-        ) - new_val;
-        /* new sum of marginals is not one anymore... */
-        sum = 1.0 - diff;
-        for (k=0; k<n_categories; k++)
-        {
-          new_val = THDoubleStorage_get( \
-            cum_dist->storage, \
-            cum_dist->storageOffset+k*cum_dist->stride[0] \
-          );
-          if (k >= sample_idx)
-          {
-            /* remove sampled probability mass from later cumulative probabilities */
-            new_val -= diff;
-          }
-          /* make total marginals sum to one */
-          new_val /= sum;
-          THDoubleStorage_set( \
-            cum_dist->storage, \
-            cum_dist->storageOffset+k*cum_dist->stride[0], \
-            new_val \
-          );
-        }
-      }
+      long row = start + i;
+      int thread = 0;
+#ifdef _OPENMP
+      thread = omp_get_thread_num();
+#endif
+      if(!THTensor_(multinomialRow)(THLongTensor_data(self) + row*self->stride[0], self->stride[1],
+                                    THTensor_(data)(prob_dist) + row*prob_dist->stride[0], prob_dist->stride[1],
+                                    n_categories, uniform + n_sample*i, n_sample, with_replacement,
+                                    cum_dist + n_categories*thread))
+        isValid = 0;
     }
   }
 
-  THDoubleTensor_free(cum_dist);
+  THFree(uniform);
+  THFree(cum_dist);
 
   if (start_dim == 1)
   {
     THLongTensor_resize1d(self, n_sample);
     THTensor_(resize1d)(prob_dist, n_categories);
   }
+  THArgCheck(isValid, 2, "invalid multinomial distribution (sum of probabilities <= 0)");
 }
-
 #endif
 
+#undef TH_RANDOM_INTEGER
+
 #if defined(TH_REAL_IS_BYTE)
 void THTensor_(getRNGState)(THGenerator *_generator, THTensor *self)
 {
@@ -380,13 +651,14 @@ void THTensor_(getRNGState)(THGenerator *_generator, THTensor *self)
 
 void THTensor_(setRNGState)(THGenerator *_generator, THTensor *self)
 {
-  static const size_t size = sizeof(THGenerator);
-  THGenerator *rng_state;
-  THArgCheck(THTensor_(nElement)(self) == size, 1, "RNG state is wrong size");
+  /* states saved before Philox generators only hold the Mersenne Twister fields */
+  size_t size = THTensor_(nElement)(self);
+  THGenerator rng_state;
+  THArgCheck(size == sizeof(THGenerator) || size == THGenerator_mt19937StateSize(), 1, "RNG state is wrong size");
   THArgCheck(THTensor_(isContiguous)(self), 1, "RNG state needs to be contiguous");
-  rng_state = (THGenerator *)THTensor_(data)(self);
-  THArgCheck(THGenerator_isValid(rng_state), 1, "Invalid RNG state");
-  THGenerator_copy(_generator, rng_state);
+  THGenerator_copyState(&rng_state, THTensor_(data)(self), size);
+  THArgCheck(THGenerator_isValid(&rng_state), 1, "Invalid RNG state");
+  THGenerator_copy(_generator, &rng_state);
 }
 #endif
 
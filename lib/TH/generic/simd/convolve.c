@@ -1,127 +1,133 @@
-#if defined(__AVX__)
+#include <string.h>
+#include "simd.h"
+#include "convolve.h"
 
-#ifdef _MSC_VER
-#include <intrin.h>
-
-static __inline int __get_cpuid (unsigned int __level, unsigned int *__eax,
-                                 unsigned int *__ebx, unsigned int *__ecx,
-                                 unsigned int *__edx) {
-  unsigned int cpui[4];
-  __cpuid(cpui, __level);
-  *__eax = cpui[0]; *__ebx = cpui[1]; *__ecx = cpui[2]; *__edx = cpui[3];
-  return 1;
-}
-
-static void xgetbv(unsigned int op, unsigned int* eax, unsigned int* edx) {
-  *eax = 0; *edx = 0;
-  if (op == 0)
-      *eax = _xgetbv(_XCR_XFEATURE_ENABLED_MASK);
-}
-
-#else
-
-#if __i386__
-#define __cpuid(__level, __eax, __ebx, __ecx, __edx) \
-__asm("  pushl  %%ebx\n" \
-"  cpuid\n" \
-"  mov    %%ebx,%1\n" \
-"  popl   %%ebx" \
-: "=a"(__eax), "=r" (__ebx), "=c"(__ecx), "=d"(__edx) \
-: "0"(__level))
-#else
-#define __cpuid(__level, __eax, __ebx, __ecx, __edx) \
-__asm("cpuid" : "=a"(__eax), "=b" (__ebx), "=c"(__ecx), "=d"(__edx) \
-: "0"(__level))
-#endif
-
-static __inline int __get_cpuid (unsigned int __level, unsigned int *__eax,
-                                 unsigned int *__ebx, unsigned int *__ecx,
-                                 unsigned int *__edx) {
-  __cpuid(__level, *__eax, *__ebx, *__ecx, *__edx);
-  return 1;
-}
-
-static void xgetbv(unsigned int op, unsigned int* eax, unsigned int* edx) {
-  __asm__ __volatile__
-  (".byte 0x0f, 0x01, 0xd0": "=a" (*eax), "=d" (*edx) : "c" (op) : "cc");
-}
-
-#endif
-
-enum ECPUFeature
+enum ConvolveInstructionSet
 {
-  kCPUFeature_SSE = 0x01,
-  kCPUFeature_SSE2 = 0x02,
-  kCPUFeature_SSE3 = 0x04,
-  kCPUFeature_SSE3_S = 0x08,
-  kCPUFeature_SSE4_1 = 0x10,
-  kCPUFeature_SSE4_2 = 0x20,
-  kCPUFeature_AVX = 0x40
+  kConvolve_None = 0,
+  kConvolve_SSE,
+  kConvolve_AVX,
+  kConvolve_AVX2,
+  kConvolve_AVX512
 };
 
-static unsigned int checkCPUFeatures() {
-  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
-  unsigned int features = 0;
-  __get_cpuid(1, &eax, &ebx, &ecx, &edx);
-  if( (edx & (1 << 25)) != 0 ) {
-    features |= kCPUFeature_SSE;
-  }
-  if( (edx & (1 << 26)) != 0 ) {
-    features |= kCPUFeature_SSE2;
-  }
-  if( (ecx & (1 << 0)) != 0 ) {
-    features |= kCPUFeature_SSE3;
-  }
-  if( (ecx & (1 << 9)) != 0 ) {
-    features |= kCPUFeature_SSE3_S;
-  }
-  if( (ecx & (1 << 19)) != 0 ) {
-    features |= kCPUFeature_SSE4_1;
-  }
-  if( (ecx & (1 << 20)) != 0 ) {
-    features |= kCPUFeature_SSE4_2;
-  }
-  if( (ecx & (1 << 28)) != 0 && (ecx & (1 << 27)) != 0 && (ecx & (1 << 26)) != 0 ) {
-    xgetbv(0, &eax, &edx);
-    if( (eax & 6) == 6 ) {
-      features |= kCPUFeature_AVX;
-    }
+/* best instruction set of the host with compiled kernels, detected on first use */
+static int convolveInstructionSet(void)
+{
+  static int sInstructionSet = -1;
+  if (sInstructionSet < 0) {
+    uint32_t hostSimdExts = detectHostSIMDExtensions();
+    int best = kConvolve_None;
+#if defined(USE_SSE2)
+    if (hostSimdExts & SIMDExtension_SSE)
+      best = kConvolve_SSE;
+#endif
+#if defined(USE_AVX)
+    if (hostSimdExts & SIMDExtension_AVX)
+      best = kConvolve_AVX;
+#endif
+#if defined(USE_AVX2)
+    if (hostSimdExts & SIMDExtension_AVX2)
+      best = kConvolve_AVX2;
+#endif
+#if defined(USE_AVX512)
+    if (hostSimdExts & SIMDExtension_AVX512)
+      best = kConvolve_AVX512;
+#endif
+    (void)hostSimdExts; /* unused without any SIMD kernel */
+    sInstructionSet = best;
   }
-  return features;
+  return sInstructionSet;
 }
 
-#include <stdio.h>
+void convolve_5x5_sse(float* output, float* input, float* kernel, long outRows, long outCols, long outStride, long inCols);
+void convolve_5x5_avx(float* output, float* input, float* kernel, long outRows, long outCols, long outStride, long inCols);
 
-static int haveCPUFeature(unsigned int feature) {
-  static unsigned int sCPUFeatures = 0;
-  static int sDetectedCPUFeatures = 0;
-  if (!sDetectedCPUFeatures) {
-    sDetectedCPUFeatures = 1;
-    sCPUFeatures = checkCPUFeatures();
-    if ((sCPUFeatures & kCPUFeature_AVX) != 0) {
-      printf("torch running avx\n");
-    } else {
-      printf("torch running sse \n");
+#if !defined(USE_SSE4_1) || !defined(USE_SSE4_2)
+/* without SSE4 kernels, the same accumulation one output at a time */
+static void convolve_5x5_scalar(float* output, float* input, float* kernel, long outRows, long outCols, long outStride, long inCols) {
+  long r, i;
+  for (r = 0; r < outRows; r++) {
+    for (i = 0; i < outCols; i++) {
+      float output0 = output[r * outStride + i];
+      int row;
+      for (row = 0; row < 5; row++) {
+        int col;
+        for (col = 0; col < 5; col++) {
+          output0 += kernel[5 * row + col] * input[(r + row) * inCols + i + col];
+        }
+      }
+      output[r * outStride + i] = output0;
     }
   }
-  return (sCPUFeatures & feature) != 0;
 }
-
 #endif
 
-void convolve_5x5_sse(float* output, float* input, float* kernel, long outRows, long outCols, long outStride, long inCols);
-void convolve_5x5_avx(float* output, float* input, float* kernel, long outRows, long outCols, long outStride, long inCols);
-
 void convolve_5x5(float* output, float* input, float* kernel, long outRows, long outCols, long inCols) {
-#if defined(__AVX__)
-  int avx = haveCPUFeature(kCPUFeature_AVX);
-  if (avx)
+#if defined(USE_AVX)
+  if (convolveInstructionSet() >= kConvolve_AVX)
   {
     convolve_5x5_avx(output, input, kernel, outRows, outCols, outCols, inCols);
   }
   else
 #endif
   {
+#if defined(USE_SSE4_1) && defined(USE_SSE4_2)
     convolve_5x5_sse(output, input, kernel, outRows, outCols, outCols, inCols);
+#else
+    convolve_5x5_scalar(output, input, kernel, outRows, outCols, outCols, inCols);
+#endif
   }
 }
+
+int convolve_valid_float(float *r_, float alpha, const float *t_, long ir, long ic,
+                         const float *k_, long kr, long kc, long sr)
+{
+  void (*const *kernels)(float *, float, const float *, long, long, long, long, const float *, long) = NULL;
+
+  if (kc < 1 || kc > CONVOLVE_MAX_COLS)
+    return 0;
+  switch (convolveInstructionSet()) {
+#if defined(USE_AVX512)
+    case kConvolve_AVX512: kernels = convolve_valid_float_avx512; break;
+#endif
+#if defined(USE_AVX2)
+    case kConvolve_AVX2: kernels = convolve_valid_float_avx2; break;
+#endif
+#if defined(USE_AVX)
+    case kConvolve_AVX: kernels = convolve_valid_float_avx; break;
+#endif
+#if defined(USE_SSE2)
+    case kConvolve_SSE: kernels = convolve_valid_float_sse; break;
+#endif
+    default: return 0;
+  }
+  kernels[kc](r_, alpha, t_, (ir - kr) / sr + 1, ic - kc + 1, ic, sr, k_, kr);
+  return 1;
+}
+
+int convolve_valid_double(double *r_, double alpha, const double *t_, long ir, long ic,
+                          const double *k_, long kr, long kc, long sr)
+{
+  void (*const *kernels)(double *, double, const double *, long, long, long, long, const double *, long) = NULL;
+
+  if (kc < 1 || kc > CONVOLVE_MAX_COLS)
+    return 0;
+  switch (convolveInstructionSet()) {
+#if defined(USE_AVX512)
+    case kConvolve_AVX512: kernels = convolve_valid_double_avx512; break;
+#endif
+#if defined(USE_AVX2)
+    case kConvolve_AVX2: kernels = convolve_valid_double_avx2; break;
+#endif
+#if defined(USE_AVX)
+    case kConvolve_AVX: kernels = convolve_valid_double_avx; break;
+#endif
+#if defined(USE_SSE2)
+    case kConvolve_SSE: kernels = convolve_valid_double_sse; break;
+#endif
+    default: return 0;
+  }
+  kernels[kc](r_, alpha, t_, (ir - kr) / sr + 1, ic - kc + 1, ic, sr, k_, kr);
+  return 1;
+}
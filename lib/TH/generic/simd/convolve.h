@@ -1 +1,35 @@
-void convolve_5x5(float* output, float* input, float* kernel, long outRows, long outCols, long inCols);
\ No newline at end of file
+#ifndef TH_CONVOLVE_INC
+#define TH_CONVOLVE_INC
+
+void convolve_5x5(float* output, float* input, float* kernel, long outRows, long outCols, long inCols);
+
+/* widest kernels of the SIMD valid cross-correlations */
+#define CONVOLVE_MAX_COLS 11
+
+/*
+  r_ += alpha * validXCorr2D(t_, k_) with strides (sr, 1), by the SIMD
+  kernels of the best instruction set of the host. Returns 0, leaving r_
+  untouched, when there are none for kernels of kc columns.
+*/
+int convolve_valid_float(float *r_, float alpha, const float *t_, long ir, long ic,
+                         const float *k_, long kr, long kc, long sr);
+int convolve_valid_double(double *r_, double alpha, const double *t_, long ir, long ic,
+                          const double *k_, long kr, long kc, long sr);
+
+/* kernels of each instruction set, indexed by kc: (r_, alpha, t_, or, oc, ic, sr, k_, kr) */
+#define CONVOLVE_DECLARE_TABLE(T, ISA) \
+  extern void (*const convolve_valid_ ## T ## _ ## ISA[CONVOLVE_MAX_COLS+1])(T *, T, const T *, long, long, long, long, \
+                                                                            const T *, long);
+
+CONVOLVE_DECLARE_TABLE(float, sse)
+CONVOLVE_DECLARE_TABLE(double, sse)
+CONVOLVE_DECLARE_TABLE(float, avx)
+CONVOLVE_DECLARE_TABLE(double, avx)
+CONVOLVE_DECLARE_TABLE(float, avx2)
+CONVOLVE_DECLARE_TABLE(double, avx2)
+CONVOLVE_DECLARE_TABLE(float, avx512)
+CONVOLVE_DECLARE_TABLE(double, avx512)
+
+#undef CONVOLVE_DECLARE_TABLE
+
+#endif
@@ -0,0 +1,26 @@
+#include <immintrin.h>
+#include "convolve.h"
+
+#define real float
+#define VEC __m256
+#define VEC_WIDTH 8
+#define VEC_LOAD(p) _mm256_loadu_ps(p)
+#define VEC_STORE(p, v) _mm256_storeu_ps(p, v)
+#define VEC_SET1(x) _mm256_set1_ps(x)
+#define VEC_ZERO() _mm256_setzero_ps()
+#define VEC_MADD(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
+#define CONVOLVE_NAME(K) convolve_valid_float_ ## K ## _avx
+#define CONVOLVE_TABLE convolve_valid_float_avx
+#include "convolve_template.h"
+
+#define real double
+#define VEC __m256d
+#define VEC_WIDTH 4
+#define VEC_LOAD(p) _mm256_loadu_pd(p)
+#define VEC_STORE(p, v) _mm256_storeu_pd(p, v)
+#define VEC_SET1(x) _mm256_set1_pd(x)
+#define VEC_ZERO() _mm256_setzero_pd()
+#define VEC_MADD(a, b, c) _mm256_add_pd(_mm256_mul_pd(a, b), c)
+#define CONVOLVE_NAME(K) convolve_valid_double_ ## K ## _avx
+#define CONVOLVE_TABLE convolve_valid_double_avx
+#include "convolve_template.h"
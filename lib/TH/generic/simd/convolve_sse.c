@@ -0,0 +1,26 @@
+#include <emmintrin.h>
+#include "convolve.h"
+
+#define real float
+#define VEC __m128
+#define VEC_WIDTH 4
+#define VEC_LOAD(p) _mm_loadu_ps(p)
+#define VEC_STORE(p, v) _mm_storeu_ps(p, v)
+#define VEC_SET1(x) _mm_set1_ps(x)
+#define VEC_ZERO() _mm_setzero_ps()
+#define VEC_MADD(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#define CONVOLVE_NAME(K) convolve_valid_float_ ## K ## _sse
+#define CONVOLVE_TABLE convolve_valid_float_sse
+#include "convolve_template.h"
+
+#define real double
+#define VEC __m128d
+#define VEC_WIDTH 2
+#define VEC_LOAD(p) _mm_loadu_pd(p)
+#define VEC_STORE(p, v) _mm_storeu_pd(p, v)
+#define VEC_SET1(x) _mm_set1_pd(x)
+#define VEC_ZERO() _mm_setzero_pd()
+#define VEC_MADD(a, b, c) _mm_add_pd(_mm_mul_pd(a, b), c)
+#define CONVOLVE_NAME(K) convolve_valid_double_ ## K ## _sse
+#define CONVOLVE_TABLE convolve_valid_double_sse
+#include "convolve_template.h"
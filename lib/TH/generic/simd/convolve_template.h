@@ -0,0 +1,102 @@
+/*
+  Valid cross-correlations of stride (sr, 1) by kernels of K = 1 to
+  CONVOLVE_MAX_COLS columns and any number of rows: output rows are
+  computed four vectors at a time, the kr*K taps summed in registers before
+  r_ += alpha*sum. One function per K, so that the taps of a kernel row are
+  unrolled, and a table of them indexed by K.
+
+  Included by the files of each instruction set, once per element type,
+  after defining real, VEC (the vector type), VEC_WIDTH, VEC_LOAD(p),
+  VEC_STORE(p, v), VEC_SET1(x), VEC_ZERO(), VEC_MADD(a, b, c) = a*b + c,
+  CONVOLVE_NAME(K) and CONVOLVE_TABLE; all undefined at the end.
+*/
+
+#define CONVOLVE_ACCUMULATE(s, x, w) s = VEC_MADD(VEC_LOAD(x), w, s)
+
+#define CONVOLVE_UPDATE(p, s) VEC_STORE(p, VEC_MADD(s, va, VEC_LOAD(p)))
+
+#define CONVOLVE_KERNEL(K)                                              \
+static void CONVOLVE_NAME(K)(real *r_, real alpha, const real *t_,      \
+                             long or, long oc, long ic, long sr,        \
+                             const real *k_, long kr)                   \
+{                                                                       \
+  VEC va = VEC_SET1(alpha);                                             \
+  long yy, xx, ky, kx;                                                  \
+  for(yy = 0; yy < or; yy++)                                            \
+  {                                                                     \
+    const real *row = t_ + yy*sr*ic;                                    \
+    for(xx = 0; xx + 4*VEC_WIDTH <= oc; xx += 4*VEC_WIDTH)              \
+    {                                                                   \
+      VEC s0 = VEC_ZERO(), s1 = VEC_ZERO();                             \
+      VEC s2 = VEC_ZERO(), s3 = VEC_ZERO();                             \
+      for(ky = 0; ky < kr; ky++)                                        \
+      {                                                                 \
+        const real *in = row + ky*ic + xx;                              \
+        const real *w = k_ + ky*K;                                      \
+        for(kx = 0; kx < K; kx++)                                       \
+        {                                                               \
+          VEC wk = VEC_SET1(w[kx]);                                     \
+          CONVOLVE_ACCUMULATE(s0, in + kx, wk);                         \
+          CONVOLVE_ACCUMULATE(s1, in + kx + VEC_WIDTH, wk);             \
+          CONVOLVE_ACCUMULATE(s2, in + kx + 2*VEC_WIDTH, wk);           \
+          CONVOLVE_ACCUMULATE(s3, in + kx + 3*VEC_WIDTH, wk);           \
+        }                                                               \
+      }                                                                 \
+      CONVOLVE_UPDATE(r_ + xx, s0);                                     \
+      CONVOLVE_UPDATE(r_ + xx + VEC_WIDTH, s1);                         \
+      CONVOLVE_UPDATE(r_ + xx + 2*VEC_WIDTH, s2);                       \
+      CONVOLVE_UPDATE(r_ + xx + 3*VEC_WIDTH, s3);                       \
+    }                                                                   \
+    for(; xx + VEC_WIDTH <= oc; xx += VEC_WIDTH)                        \
+    {                                                                   \
+      VEC s0 = VEC_ZERO();                                              \
+      for(ky = 0; ky < kr; ky++)                                        \
+        for(kx = 0; kx < K; kx++)                                       \
+          CONVOLVE_ACCUMULATE(s0, row + ky*ic + xx + kx, VEC_SET1(k_[ky*K + kx])); \
+      CONVOLVE_UPDATE(r_ + xx, s0);                                     \
+    }                                                                   \
+    for(; xx < oc; xx++)                                                \
+    {                                                                   \
+      real sum = 0;                                                     \
+      for(ky = 0; ky < kr; ky++)                                        \
+        for(kx = 0; kx < K; kx++)                                       \
+          sum += row[ky*ic + xx + kx]*k_[ky*K + kx];                    \
+      r_[xx] += alpha*sum;                                              \
+    }                                                                   \
+    r_ += oc;                                                           \
+  }                                                                     \
+}
+
+CONVOLVE_KERNEL(1)
+CONVOLVE_KERNEL(2)
+CONVOLVE_KERNEL(3)
+CONVOLVE_KERNEL(4)
+CONVOLVE_KERNEL(5)
+CONVOLVE_KERNEL(6)
+CONVOLVE_KERNEL(7)
+CONVOLVE_KERNEL(8)
+CONVOLVE_KERNEL(9)
+CONVOLVE_KERNEL(10)
+CONVOLVE_KERNEL(11)
+
+void (*const CONVOLVE_TABLE[CONVOLVE_MAX_COLS+1])(real *, real, const real *, long, long, long, long,
+                                                  const real *, long) = {
+  NULL,
+  CONVOLVE_NAME(1), CONVOLVE_NAME(2), CONVOLVE_NAME(3), CONVOLVE_NAME(4),
+  CONVOLVE_NAME(5), CONVOLVE_NAME(6), CONVOLVE_NAME(7), CONVOLVE_NAME(8),
+  CONVOLVE_NAME(9), CONVOLVE_NAME(10), CONVOLVE_NAME(11)
+};
+
+#undef CONVOLVE_ACCUMULATE
+#undef CONVOLVE_UPDATE
+#undef CONVOLVE_KERNEL
+#undef CONVOLVE_NAME
+#undef CONVOLVE_TABLE
+#undef real
+#undef VEC
+#undef VEC_WIDTH
+#undef VEC_LOAD
+#undef VEC_STORE
+#undef VEC_SET1
+#undef VEC_ZERO
+#undef VEC_MADD
@@ -10,9 +10,15 @@
 #endif
 
 // Can be found on Intel ISA Reference for CPUID
+#define CPUID_AVX512F_BIT 0x10000 // Bit 16 of EBX for EAX=0x7
 #define CPUID_AVX2_BIT 0x20       // Bit 5 of EBX for EAX=0x7
 #define CPUID_AVX_BIT  0x10000000 // Bit 28 of ECX for EAX=0x1
 #define CPUID_SSE_BIT  0x2000000  // bit 25 of EDX for EAX=0x1
+#define CPUID_OSXSAVE_BIT 0x8000000 // Bit 27 of ECX for EAX=0x1
+
+// XCR0 state components the OS must save for AVX-512: SSE and AVX (bits 1
+// and 2), opmask, upper halves of ZMM0-15 and ZMM16-31 (bits 5 to 7)
+#define XCR0_AVX512_STATE 0xE6
 
 // Helper macros for initialization
 #define FUNCTION_IMPL(NAME, EXT) \
@@ -49,6 +55,7 @@ enum SIMDExtensions
   SIMDExtension_AVX2    = 0x1,
   SIMDExtension_AVX     = 0x2,
   SIMDExtension_SSE     = 0x4,
+  SIMDExtension_AVX512  = 0x8,
 #endif
   SIMDExtension_DEFAULT = 0x0
 };
@@ -120,24 +127,55 @@ static inline void cpuid(uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *
 #endif
 }
 
+// Whether the OS saves the AVX-512 registers on context switches: the CPU
+// may support them while the kernel does not enable them in XCR0
+static inline int hostAVX512StateEnabled()
+{
+  uint32_t eax = 0x1, ebx, ecx = 0x0, edx;
+  uint64_t xcr0;
+
+  cpuid(&eax, &ebx, &ecx, &edx);
+  if (!(ecx & CPUID_OSXSAVE_BIT))
+    return 0;
+#if defined(_MSC_VER)
+  xcr0 = _xgetbv(0);
+#else
+  {
+    uint32_t lo, hi;
+    // xgetbv, spelled out for assemblers which do not know it
+    asm volatile ( ".byte 0x0f, 0x01, 0xd0"
+                   : "=a"(lo), "=d"(hi) : "c"(0) );
+    xcr0 = ((uint64_t)hi << 32) | lo;
+  }
+#endif
+  return (xcr0 & XCR0_AVX512_STATE) == XCR0_AVX512_STATE;
+}
+
 static inline uint32_t detectHostSIMDExtensions()
 {
   uint32_t eax, ebx, ecx, edx;
   uint32_t hostSimdExts = 0x0;
-  int TH_NO_AVX = 1, TH_NO_AVX2 = 1, TH_NO_SSE = 1;
+  int TH_NO_AVX = 1, TH_NO_AVX2 = 1, TH_NO_AVX512 = 1, TH_NO_SSE = 1;
   char *evar;
 
   evar = getenv("TH_NO_AVX2");
   if (evar == NULL || strncmp(evar, "1", 2) != 0)
     TH_NO_AVX2 = 0;
 
-  // Check for AVX2. Requires separate CPUID
+  evar = getenv("TH_NO_AVX512");
+  if (evar == NULL || strncmp(evar, "1", 2) != 0)
+    TH_NO_AVX512 = 0;
+
+  // Check for AVX2 and AVX-512. Requires separate CPUID
   eax = 0x7;
   ecx = 0x0;
   cpuid(&eax, &ebx, &ecx, &edx);
   if ((ebx & CPUID_AVX2_BIT) && TH_NO_AVX2 == 0) {
     hostSimdExts |= SIMDExtension_AVX2;
   }
+  if ((ebx & CPUID_AVX512F_BIT) && TH_NO_AVX512 == 0 && hostAVX512StateEnabled()) {
+    hostSimdExts |= SIMDExtension_AVX512;
+  }
 
   // Detect and enable AVX and SSE
   eax = 0x1;
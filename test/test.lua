@@ -1710,6 +1710,20 @@ function torchtest.bhistc()
    z[3] = torch.Tensor{ 1, 1, 1, 1, 2 }
    mytester:assertTensorEq(y,z,precision,'error in torch.bhistc in last dimension')
 end
+function torchtest.bincount()
+   local x = torch.LongTensor{ 0, 2, 2, 5 }
+   mytester:assertTensorEq(torch.bincount(x), torch.LongTensor{ 1, 0, 2, 0, 0, 1 }, 0, 'error in torch.bincount')
+   mytester:asserteq(torch.bincount(x, 10):size(1), 10, 'error in torch.bincount with minlength')
+   local y = torch.bincount(x, torch.Tensor{ 0.5, 1, 2, 4 })
+   mytester:assertTensorEq(y, torch.Tensor{ 0.5, 0, 3, 0, 0, 4 }, precision, 'error in torch.bincount with weights')
+   -- large enough to be counted in parallel
+   local z = torch.LongTensor(300000):random(0, 49)
+   local counts = torch.bincount(z)
+   for v = 0, 49 do
+      mytester:asserteq(counts[v+1], z:eq(v):sum(), 'error in parallel torch.bincount')
+   end
+   mytester:assertError(function() torch.bincount(torch.LongTensor{ 1, -1 }) end, 'negative values not detected')
+end
 function torchtest.ones()
    local mx = torch.ones(msize,msize)
    local mxx = torch.Tensor()
@@ -1834,6 +1848,35 @@ function torchtest.aliasMultinomial()
    end
 
 end
+
+function torchtest.multinomialBatch()
+   -- rows sampled in parallel get the samples of a serial draw
+   local probs = torch.rand(300, 1000):add(0.01)
+   local nThreads = torch.getnumthreads()
+   for _, replacement in ipairs{true, false} do
+      torch.manualSeed(123)
+      torch.setnumthreads(1)
+      local serial = torch.multinomial(probs, 50, replacement)
+      torch.setnumthreads(4)
+      torch.manualSeed(123)
+      mytester:assertTensorEq(torch.multinomial(probs, 50, replacement), serial, 0, 'multinomial depends on the number of threads')
+   end
+   torch.setnumthreads(nThreads)
+
+   -- batched alias tables sample each row as its own table
+   probs:cdiv(probs:sum(2):expandAs(probs))
+   local state = torch.multinomialAliasSetup(probs)
+   mytester:assertTableEq(state[1]:size():totable(), {300, 1000}, 'wrong alias table size')
+   torch.manualSeed(7)
+   local output = torch.multinomialAlias(torch.LongTensor(300, 20), state)
+   torch.manualSeed(7)
+   for i = 1, 300 do
+      local rowState = torch.multinomialAliasSetup(probs[i])
+      local row = torch.multinomialAlias(torch.LongTensor(20), rowState)
+      mytester:assertTensorEq(output[i], row, 0, 'batched alias sampling differs')
+   end
+end
+
 function torchtest.multinomialvector()
    local n_col = 4
    local t=os.time()
@@ -1984,6 +2027,149 @@ function torchtest.sortDescending()
    assertIsOrdered('descending', x, mxx, ixx, 'random with duplicate keys')
 end
 
+function torchtest.sortRadix()
+   -- long slices are radix sorted, with stable indices, for all types
+   local types = {'torch.ByteTensor', 'torch.CharTensor', 'torch.ShortTensor', 'torch.IntTensor',
+                  'torch.LongTensor', 'torch.FloatTensor', 'torch.DoubleTensor'}
+   for _, typename in ipairs(types) do
+      local x = torch.rand(3, 1000):mul(100):floor():add(-50)
+      if typename == 'torch.ByteTensor' then x:add(50) end
+      x = x:type(typename)
+      for _, descending in ipairs{false, true} do
+         local values, indices = torch.sort(x, 2, descending)
+         mytester:assertTensorEq(x:gather(2, indices):double(), values:double(), 0, typename .. ' wrong sort indices')
+         local ordered, stable = true, true
+         for i = 1, 3 do
+            for j = 2, 1000 do
+               local a, b = values[i][j-1], values[i][j]
+               ordered = ordered and (descending and a >= b or not descending and a <= b)
+               stable = stable and (a ~= b or indices[i][j-1] < indices[i][j])
+            end
+         end
+         mytester:assert(ordered, typename .. ' radix sort values unordered')
+         mytester:assert(stable, typename .. ' radix sort is not stable')
+      end
+   end
+   local values = torch.sort(torch.Tensor(1000):fill(1):cat(torch.Tensor{-math.huge, math.huge, -1e-300, 1e-300}))
+   mytester:assertTensorEq(values:narrow(1, 1, 3), torch.Tensor{-math.huge, -1e-300, 1e-300}, 0, 'wrong order of extreme values')
+   mytester:asserteq(values[1004], math.huge, 'wrong order of extreme values')
+end
+
+function torchtest.sortNaN()
+   -- NaNs are last in ascending order and first in descending order, for
+   -- short slices (quicksorted) as well as long ones (radix sorted)
+   for _, typename in ipairs{'torch.FloatTensor', 'torch.DoubleTensor'} do
+      for _, size in ipairs{100, 2000} do
+         local x = torch.rand(size):add(-0.5):type(typename)
+         x:indexFill(1, torch.range(1, size, 5):long(), 0/0)
+         local nNaN = size/5
+         local expected = torch.sort(x[x:eq(x)])
+         for _, descending in ipairs{false, true} do
+            local values, indices = torch.sort(x, descending)
+            local stableValues = torch.stableSort(x, descending)
+            local nans = descending and values:narrow(1, 1, nNaN) or values:narrow(1, size-nNaN+1, nNaN)
+            local others = descending and values:narrow(1, nNaN+1, size-nNaN) or values:narrow(1, 1, size-nNaN)
+            mytester:assert(nans:ne(nans):sum() == nNaN, typename .. ' NaNs sorted at the wrong place')
+            mytester:assertTensorEq(others, descending and expected:index(1, torch.range(size-nNaN, 1, -1):long()) or expected,
+                                    0, typename .. ' wrong sorted values with NaNs')
+            mytester:assert(x:index(1, indices):ne(values):eq(values:eq(values)):sum() == 0, typename .. ' wrong sort indices with NaNs')
+            mytester:assert(stableValues:ne(stableValues):eq(values:ne(values)):min() == 1, typename .. ' NaNs stable sorted at the wrong place')
+         end
+      end
+   end
+end
+
+function torchtest.sortParallel()
+   -- slices sorted across threads give the same results as slices sorted one by one
+   local x = torch.rand(200, 600):mul(50):floor()
+   local values, indices = torch.sort(x, 2)
+   for i = 1, 200, 37 do
+      local rowValues, rowIndices = torch.sort(x[i])
+      mytester:assertTensorEq(values[i], rowValues, 0, 'wrong values of a slice sorted in parallel')
+      mytester:assertTensorEq(indices[i], rowIndices, 0, 'wrong indices of a slice sorted in parallel')
+   end
+
+   -- a single long slice, split across threads
+   local y = torch.rand(300000):mul(1000):floor()
+   values, indices = torch.sort(y, true)
+   mytester:assertTensorEq(y:index(1, indices), values, 0, 'wrong indices of a long slice')
+   local ties = values:narrow(1, 1, 299999):eq(values:narrow(1, 2, 299999))
+   mytester:assert(values:narrow(1, 1, 299999):lt(values:narrow(1, 2, 299999)):sum() == 0,
+                   'long slice values unordered')
+   mytester:assert(indices:narrow(1, 1, 299999):maskedSelect(ties):lt(indices:narrow(1, 2, 299999):maskedSelect(ties)):min() == 1,
+                   'long slice sort is not stable')
+end
+
+function torchtest.stableSort()
+   -- ties keep the order of their indices in short slices too
+   for _, size in ipairs{10, 100, 1000} do
+      local x = torch.rand(30, size):mul(5):floor()
+      for _, descending in ipairs{false, true} do
+         local values, indices = torch.stableSort(x, 2, descending)
+         local sortedValues = torch.sort(x, 2, descending)
+         mytester:assertTensorEq(values, sortedValues, 0, 'wrong stable sort values')
+         mytester:assertTensorEq(x:gather(2, indices), values, 0, 'wrong stable sort indices')
+         local ties = values:narrow(2, 1, size-1):eq(values:narrow(2, 2, size-1))
+         local ordered = indices:narrow(2, 1, size-1):lt(indices:narrow(2, 2, size-1))
+         mytester:assert(ordered:maskedSelect(ties):min() == 1, 'stable sort is not stable')
+         mytester:assertTensorEq(torch.sortValues(x, 2, descending), sortedValues, 0, 'wrong values-only sort')
+      end
+   end
+   local x = torch.rand(7, 5)
+   mytester:assertTensorEq(x:sortValues(1), x:sort(1), 0, 'wrong values-only sort along a dimension')
+end
+
+function torchtest.unique()
+   local x = torch.Tensor{ 3, 1, 3, 2, 1 }
+   local y, i, c = torch.unique(x, true, true)
+   mytester:assertTensorEq(y, torch.Tensor{ 1, 2, 3 }, 0, 'wrong unique values')
+   mytester:assertTensorEq(i, torch.LongTensor{ 3, 1, 3, 2, 1 }, 0, 'wrong unique inverse indices')
+   mytester:assertTensorEq(c, torch.LongTensor{ 2, 1, 2 }, 0, 'wrong unique counts')
+   mytester:assertTensorEq(torch.unique(x), y, 0, 'wrong unique values without inverse')
+   local resinv = torch.LongTensor{ 7, 8 }
+   torch.unique(torch.Tensor(), resinv, torch.LongTensor(), x)
+   mytester:assertTensorEq(resinv, torch.LongTensor{ 7, 8 }, 0, 'inverse indices changed without inverse')
+
+   -- non-contiguous, and large enough to be sorted with the radix sort
+   local z = torch.IntTensor(200, 300):random(-500, 500):t()
+   y, i, c = torch.unique(z, true, true)
+   mytester:assert(y:narrow(1, 1, y:size(1)-1):lt(y:narrow(1, 2, y:size(1)-1)):min() == 1, 'unique values not sorted')
+   mytester:assertTensorEq(y:index(1, i:view(-1)):viewAs(z), z, 0, 'wrong unique inverse indices')
+   mytester:asserteq(c:sum(), z:nElement(), 'wrong unique counts')
+   mytester:asserteq(c[1], z:eq(y[1]):sum(), 'wrong unique counts')
+end
+
+function torchtest.searchsorted()
+   local boundaries = torch.Tensor{ 1, 3, 5 }
+   local x = torch.Tensor{ 0, 1, 2, 5, 6 }
+   mytester:assertTensorEq(torch.searchsorted(boundaries, x), torch.LongTensor{ 1, 1, 2, 3, 4 }, 0, 'wrong left searchsorted')
+   mytester:assertTensorEq(torch.searchsorted(boundaries, x, true), torch.LongTensor{ 1, 2, 2, 4, 4 }, 0, 'wrong right searchsorted')
+
+   -- NaNs go last, as in the sort
+   x = torch.Tensor{ 0/0, 2, 0/0 }
+   mytester:assertTensorEq(torch.searchsorted(boundaries, x), torch.LongTensor{ 4, 2, 4 }, 0, 'wrong searchsorted of NaN')
+   mytester:assertTensorEq(torch.searchsorted(torch.Tensor{ 1, 3, 0/0 }, x), torch.LongTensor{ 3, 2, 3 }, 0, 'wrong left searchsorted of NaN')
+   mytester:assertTensorEq(torch.searchsorted(torch.Tensor{ 1, 3, 0/0 }, x, true), torch.LongTensor{ 4, 2, 4 }, 0, 'wrong right searchsorted of NaN')
+
+   -- compare with a linear count, on a non-contiguous input
+   boundaries = torch.sort(torch.IntTensor(37):random(0, 20))
+   x = torch.IntTensor(30, 40):random(-2, 22):t()
+   for _, right in ipairs{false, true} do
+      local i = torch.searchsorted(boundaries, x, right)
+      local count = torch.LongTensor(x:size()):fill(1)
+      for k = 1, boundaries:size(1) do
+         local below = right and x:ge(boundaries[k]) or x:gt(boundaries[k])
+         count:add(below:long())
+      end
+      mytester:assertTensorEq(i, count, 0, 'wrong searchsorted on ' .. (right and 'right' or 'left') .. ' side')
+   end
+
+   -- one row of boundaries per row of x
+   boundaries = torch.Tensor{{ 1, 2 }, { 10, 20 }}
+   x = torch.Tensor{{ 1.5, 15 }, { 1.5, 15 }}
+   mytester:assertTensorEq(torch.searchsorted(boundaries, x), torch.LongTensor{{ 2, 3 }, { 1, 2 }}, 0, 'wrong batched searchsorted')
+end
+
 function torchtest.topK()
    local function topKViaSort(t, k, dim, dir)
       local sorted, indices = t:sort(dim, dir)
@@ -2049,6 +2235,68 @@ function torchtest.topK()
    end
 end
 
+function torchtest.topKHeap()
+   -- small k are selected with a heap, which keeps the lowest indices among ties
+   local x = torch.rand(20, 5000):mul(100):floor()
+   for _, dir in ipairs{false, true} do
+      for _, k in ipairs{1, 10, 100} do
+         local values, indices = torch.topk(x, k, 2, dir)
+         local sortedValues, sortedIndices = torch.sort(x, 2, dir)
+         mytester:assertTensorEq(values, sortedValues:narrow(2, 1, k), 0, 'wrong heap topk values')
+         mytester:assertTensorEq(indices, sortedIndices:narrow(2, 1, k), 0, 'wrong heap topk indices')
+      end
+   end
+   local y = torch.rand(400000)
+   local values, indices = torch.topk(y, 50, 1, true)
+   local sortedValues, sortedIndices = torch.sort(y, true)
+   mytester:assertTensorEq(values, sortedValues:narrow(1, 1, 50), 0, 'wrong topk values of a long slice')
+   mytester:assertTensorEq(indices, sortedIndices:narrow(1, 1, 50), 0, 'wrong topk indices of a long slice')
+
+   -- NaNs are greater than any other value, as in the sort
+   local z = torch.range(0, 199)
+   z[1] = 0/0
+   values, indices = torch.topk(z, 3, 1, true)
+   mytester:assert(values[1] ~= values[1], 'NaN not selected first by topk')
+   mytester:assertTensorEq(values:narrow(1, 2, 2), torch.Tensor{199, 198}, 0, 'wrong topk values with a NaN')
+   mytester:assertTensorEq(indices, torch.LongTensor{1, 200, 199}, 0, 'wrong topk indices with a NaN')
+   values, indices = torch.topk(z, 3, 1, false)
+   mytester:assertTensorEq(values, torch.Tensor{1, 2, 3}, 0, 'NaN selected by topk of the smallest values')
+   mytester:assertTensorEq(indices, torch.LongTensor{2, 3, 4}, 0, 'wrong topk indices with a NaN')
+   z:fill(0/0)
+   z[150] = 1
+   values, indices = torch.topk(z, 3, 1, false)
+   mytester:asserteq(values[1], 1, 'wrong topk value among NaNs')
+   mytester:assert(values[2] ~= values[2] and values[3] ~= values[3], 'wrong topk values among NaNs')
+   mytester:assertTensorEq(indices, torch.LongTensor{150, 1, 2}, 0, 'wrong topk indices among NaNs')
+end
+
+function torchtest.modeInteger()
+   -- integer values are counted in a hash table, with the same results as sorting
+   local x = torch.rand(50, 3000):mul(40):floor():add(-20)
+   for _, typename in ipairs{'torch.ByteTensor', 'torch.CharTensor', 'torch.ShortTensor',
+                             'torch.IntTensor', 'torch.LongTensor', 'torch.DoubleTensor'} do
+      local y = x:type(typename)
+      if typename == 'torch.ByteTensor' then y = (x + 20):type(typename) end
+      local values, indices = torch.mode(y, 2)
+      for i = 1, 50 do
+         local counts, last = {}, {}
+         local mode, maxCount
+         for j = 1, 3000 do
+            local v = y[i][j]
+            counts[v] = (counts[v] or 0) + 1
+            last[v] = j
+         end
+         for v, c in pairs(counts) do
+            if not maxCount or c > maxCount or (c == maxCount and v < mode) then
+               mode, maxCount = v, c
+            end
+         end
+         mytester:asserteq(values[i][1], mode, typename .. ' wrong mode value')
+         mytester:asserteq(indices[i][1], last[mode], typename .. ' wrong mode index')
+      end
+   end
+end
+
 function torchtest.kthvalue()
    local x = torch.rand(msize, msize, msize)
    local x0 = x:clone()
@@ -2762,6 +3010,85 @@ function torchtest.conv2()
    mytester:asserteq(maxdiff(immfc[1],imfc),0,'torch.conv2')
 end
 
+function torchtest.conv2Simd()
+   -- every kernel width of the SIMD kernels, and one past them, checked
+   -- against integer tensors
+   for _, kr in ipairs{1, 3, 7, 11, 15} do
+      for kc = 1, 12 do
+         local x = torch.LongTensor(kr + 9, kc + 37):random(-5, 5)
+         local k = torch.LongTensor(kr, kc):random(-5, 5)
+         for _, op in ipairs{'conv2', 'xcorr2'} do
+            local y = torch[op](x, k):double()
+            for _, t in ipairs{'torch.FloatTensor', 'torch.DoubleTensor'} do
+               mytester:assertlt(maxdiff(torch[op](x:type(t), k:type(t)):double(), y), 1e-8,
+                                 'torch.' .. op .. ' of ' .. t .. ' with ' .. kr .. 'x' .. kc .. ' kernels')
+            end
+         end
+      end
+   end
+end
+
+function torchtest.conv2Gemm()
+   -- enough planes to go through the unfolded matrix product
+   local x = torch.rand(6, 23, 31)
+   local k = torch.rand(8, 6, 3, 5)
+   local kt = k:transpose(1, 2):clone():transpose(1, 2)
+   for _, op in ipairs{'conv2', 'xcorr2'} do
+      local y = torch[op](x, k)
+      local y2 = torch.zeros(y:size())
+      for o = 1, k:size(1) do
+         for i = 1, k:size(2) do
+            y2[o]:add(torch[op](x[i], k[o][i]))
+         end
+      end
+      mytester:assertlt(maxdiff(y, y2), precision, 'torch.' .. op .. ' with many planes')
+      mytester:assertlt(maxdiff(torch[op](x, kt), y), precision, 'torch.' .. op .. ' with non-contiguous kernels')
+   end
+end
+
+function torchtest.conv2Winograd()
+   -- 3x3 kernels, with output sizes that are not multiples of the tiles
+   local x = torch.rand(6, 21, 30)
+   local k = torch.rand(5, 6, 3, 3)
+   local default = torch.getconvwinograd()
+   for _, op in ipairs{'conv2', 'xcorr2'} do
+      torch.setconvwinograd(0)
+      local y = torch[op](x, k)
+      for _, tile in ipairs{2, 4} do
+         torch.setconvwinograd(tile)
+         mytester:asserteq(torch.getconvwinograd(), tile, 'Winograd tile size not set')
+         mytester:assertlt(maxdiff(torch[op](x, k), y), precision, 'torch.' .. op .. ' with Winograd tiles of ' .. tile)
+      end
+   end
+   torch.setconvwinograd(default)
+   mytester:assertError(function() torch.setconvwinograd(3) end, 'unsupported Winograd tile size')
+end
+
+function torchtest.convFFT()
+   -- kernels large enough to go through FFTs, checked against the direct
+   -- loops of integer tensors
+   local function check(op, x, k, vf)
+      local y = torch[op](x:double(), k:double(), vf)
+      mytester:assertlt(maxdiff(y, torch[op](x, k, vf):double()), 1e-8, 'torch.' .. op .. ' ' .. vf .. ' with FFTs')
+   end
+   local x2 = torch.LongTensor(64, 80):random(-5, 5)
+   local k2 = torch.LongTensor(21, 17):random(-5, 5)
+   local x1 = torch.LongTensor(1, 3000):random(-5, 5)
+   local k1 = torch.LongTensor(1, 301):random(-5, 5)
+   local x3 = torch.LongTensor(16, 24, 24):random(-5, 5)
+   local k3 = torch.LongTensor(7, 9, 9):random(-5, 5)
+   for _, vf in ipairs{'V', 'F'} do
+      for _, op in ipairs{'conv2', 'xcorr2'} do
+         check(op, x2, k2, vf)
+         check(op, x1, k1, vf)
+         check(op, torch.LongTensor(3, 64, 80):random(-5, 5), torch.LongTensor(2, 3, 21, 17):random(-5, 5), vf)
+      end
+      for _, op in ipairs{'conv3', 'xcorr3'} do
+         check(op, x3, k3, vf)
+      end
+   end
+end
+
 function torchtest.conv3()
    local x = torch.rand(math.floor(torch.uniform(20,40)),
                         math.floor(torch.uniform(20,40)),
@@ -2899,6 +3226,23 @@ function torchtest.fconv3_fconv2_eq()
     mytester:assertlt(maxdiff(o3,o32),precision,'torch.conv3_conv2_eq')
 end
 
+function torchtest.conv3mm()
+   local x = torch.rand(3, 4, math.floor(torch.uniform(6,10)),
+                        math.floor(torch.uniform(6,10)), math.floor(torch.uniform(6,10)))
+   local k = torch.rand(5, 4, 2, 3, math.floor(torch.uniform(2,4)))
+
+   for _, vf in ipairs({'V', 'F'}) do
+      local oc = torch.conv3(x, k, vf)
+      local ox = torch.xcorr3(x, k, vf)
+      mytester:asserteq(oc:dim(), 5, 'torch.conv3 batch dimension')
+      mytester:asserteq(oc:size(1), 3, 'torch.conv3 batch size')
+      for i=1,x:size(1) do
+         mytester:asserteq(maxdiff(oc[i], torch.conv3(x[i], k, vf)), 0, 'torch.conv3 batch ' .. vf)
+         mytester:asserteq(maxdiff(ox[i], torch.xcorr3(x[i], k, vf)), 0, 'torch.xcorr3 batch ' .. vf)
+      end
+   end
+end
+
 function torchtest.logical()
    local x = torch.rand(100,100)*2-1;
    local xx = x:clone()
@@ -2927,6 +3271,33 @@ function torchtest.RNGState()
    mytester:assertTensorEq(before, after, 1e-16, 'getRNGState/setRNGState not generating same sequence')
 end
 
+function torchtest.RNGStateLegacy()
+   -- states saved before Philox generators stop after the Mersenne Twister
+   -- fields: the seeds and 626 unsigned longs, 3 doubles and an int
+   local longSize = torch.LongStorage():elementSize()
+   local size = math.ceil((longSize*626 + 8 + 3*8 + 4)/8)*8
+   torch.manualSeed(1234)
+   torch.uniform()
+   local legacy = torch.getRNGState():narrow(1, 1, size):clone()
+   local before = torch.rand(100)
+   torch.setRNGState(legacy)
+   mytester:assertTensorEq(torch.rand(100), before, 0, 'legacy RNG state not restored')
+
+   local gen = torch.Generator('philox')
+   torch.setRNGState(gen, legacy)
+   mytester:asserteq(gen:algorithm(), 'mt19937', 'legacy RNG state does not restore a Mersenne Twister generator')
+   mytester:assertTensorEq(torch.rand(gen, 100), before, 0, 'legacy RNG state not restored in a generator')
+
+   -- serialized generators of version 1 hold the same fields
+   local f = torch.MemoryFile()
+   f:writeByte(legacy:storage())
+   f:seek(1)
+   gen = torch.Generator('philox')
+   gen:read(f, 1)
+   f:close()
+   mytester:assertTensorEq(torch.rand(gen, 100), before, 0, 'legacy serialized generator not restored')
+end
+
 function torchtest.RNGStateAliasing()
     torch.manualSeed(1)
     local unused = torch.uniform()
@@ -2956,6 +3327,96 @@ function torchtest.serializeGenerator()
    mytester:assertne(generated, differentGenerated, 'Generators with different random seed should not produce the same output')
 end
 
+function torchtest.bulkRandomFill()
+   -- tensors get the same numbers as one draw per element, from any state
+   for _, size in ipairs{1, 101, 624, 2001} do
+      torch.manualSeed(size)
+      torch.normal()
+      local normal = torch.randn(size)
+      local uniform = torch.rand(size, 1):t()
+      local bernoulli = torch.Tensor(size):bernoulli(0.3)
+      torch.manualSeed(size)
+      torch.normal()
+      for i = 1, size do
+         mytester:asserteq(normal[i], torch.normal(), 'bulk normal differs')
+      end
+      for i = 1, size do
+         mytester:asserteq(uniform[1][i], torch.uniform(), 'bulk uniform differs')
+      end
+      for i = 1, size do
+         mytester:asserteq(bernoulli[i], torch.bernoulli(0.3), 'bulk bernoulli differs')
+      end
+   end
+end
+
+function torchtest.philoxGenerator()
+   local gen = torch.Generator('philox')
+   mytester:asserteq(gen:algorithm(), 'philox', 'wrong generator algorithm')
+   mytester:asserteq(torch.Generator():algorithm(), 'mt19937', 'wrong default generator algorithm')
+
+   -- values do not depend on the number of threads filling the tensor
+   local nThreads = torch.getnumthreads()
+   local size = 300001
+   torch.manualSeed(gen, 123)
+   torch.setnumthreads(1)
+   local uniform = torch.DoubleTensor(size):uniform(gen, -2, 3)
+   local normal = torch.FloatTensor(size):normal(gen, 1, 2)
+   local random = torch.LongTensor(size):random(gen, 7)
+   torch.setnumthreads(4)
+   torch.manualSeed(gen, 123)
+   mytester:assertTensorEq(torch.DoubleTensor(size):uniform(gen, -2, 3), uniform, 0, 'uniform depends on the number of threads')
+   mytester:assertTensorEq(torch.FloatTensor(size):normal(gen, 1, 2), normal, 0, 'normal depends on the number of threads')
+   mytester:assertTensorEq(torch.LongTensor(size):random(gen, 7), random, 0, 'random depends on the number of threads')
+   torch.setnumthreads(nThreads)
+
+   mytester:assert(uniform:min() >= -2 and uniform:max() < 3, 'uniform out of range')
+   mytester:assertlt(math.abs(uniform:mean() - 0.5), 0.02, 'wrong uniform mean')
+   mytester:assertlt(math.abs(normal:mean() - 1), 0.02, 'wrong normal mean')
+   mytester:assertlt(math.abs(normal:std() - 2), 0.02, 'wrong normal standard deviation')
+   mytester:assert(random:min() == 1 and random:max() == 7, 'random out of range')
+
+   -- non-contiguous tensors and scalars continue the same stream
+   torch.manualSeed(gen, 42)
+   local contiguous = torch.rand(gen, 10, 10)
+   local first = torch.uniform(gen)
+   torch.manualSeed(gen, 42)
+   local transposed = torch.Tensor(10, 10):t():uniform(gen)
+   mytester:assertTensorEq(transposed, contiguous, 0, 'non-contiguous fill differs')
+   mytester:asserteq(torch.uniform(gen), first, 'generator not moved past the tensor')
+end
+
+function torchtest.generatorJump()
+   for _, algorithm in ipairs{'mt19937', 'philox'} do
+      -- a jump draws the same numbers as drawing them one by one
+      for _, drawn in ipairs{0, 1, 700} do
+         local gen = torch.Generator(algorithm)
+         torch.manualSeed(gen, 123)
+         for i = 1, drawn do torch.random(gen) end
+         local stepped = torch.Generator()
+         torch.setRNGState(stepped, torch.getRNGState(gen))
+         gen:jump(15)
+         for i = 1, 2^15 do torch.random(stepped) end
+         mytester:assertTensorEq(torch.Tensor(100):random(gen), torch.Tensor(100):random(stepped), 0,
+                                 algorithm .. ' jump differs from drawing')
+      end
+
+      -- streams are reproducible, and two jumps of 2^96 apart
+      local gen = torch.Generator(algorithm)
+      torch.manualSeed(gen, 7)
+      local state = torch.getRNGState(gen)
+      local streams = gen:split(3)
+      mytester:asserteq(#streams, 3, 'wrong number of streams')
+      mytester:assert(torch.getRNGState(gen):ne(state):long():sum() == 0, 'split changed the generator')
+      local jumped = torch.Generator()
+      torch.setRNGState(jumped, state)
+      jumped:jump(96):jump(96)
+      mytester:asserteq(torch.random(streams[2]), torch.random(jumped), algorithm .. ' stream is not two jumps ahead')
+      local again = gen:split(3)
+      mytester:asserteq(torch.random(again[3]), torch.random(streams[3]), algorithm .. ' split is not reproducible')
+      mytester:assertne(torch.random(streams[1]), torch.random(again[2]), algorithm .. ' streams are the same')
+   end
+end
+
 function torchtest.testBoxMullerState()
     torch.manualSeed(123)
     local odd_number = 101
@@ -3853,6 +4314,186 @@ function torchtest.serialize()
    mytester:assertTensorEq(tensObj, torch.deserializeFromStorage(serStorage), 1e-10)
 end
 
+function torchtest.tensorWriter()
+   local filename = os.tmpname()
+   local rows = torch.FloatTensor(10, 3, 4):uniform()
+
+   -- a tiny extent size forces the file to grow several times
+   local writer = torch.TensorWriter(filename, 'torch.FloatTensor', {3, 4}, 64)
+   writer:append(rows[1])
+   writer:append(rows:narrow(1, 2, 6))
+   writer:append(rows:narrow(1, 8, 3):transpose(2, 3):contiguous():transpose(2, 3))
+   mytester:asserteq(writer:size(), 10, 'wrong number of rows')
+   writer:close()
+
+   local mapped = torch.mapTensorFile(filename)
+   mytester:assertTableEq(mapped:size():totable(), {10, 3, 4}, 'wrong size')
+   mytester:assertTensorEq(mapped, rows, 0, 'wrong content')
+   mytester:assertTensorEq(torch.mapTensorFile(filename, false, 'random'), rows, 0, 'wrong content with hints')
+   os.remove(filename)
+end
+
+function torchtest.mappingHints()
+   local filename = os.tmpname()
+   local x = torch.DoubleStorage(5000):copy(torch.randn(5000):storage())
+   local f = torch.DiskFile(filename, 'w'):binary()
+   f:writeDouble(x)
+   f:close()
+
+   for _, hints in ipairs{'populate', 'willneed sequential', 'random', ' random  populate '} do
+      local mapped = torch.DoubleStorage(filename, false, 0, false, hints)
+      mytester:asserteq(mapped:size(), 5000, 'wrong size with hints ' .. hints)
+      mytester:asserteq(mapped:prefetch(), mapped, 'prefetch does not return self')
+      mapped:prefetch(4001, 1000)
+      mapped:prefetch(5001, 0)
+      mytester:assertTensorEq(torch.DoubleTensor(mapped), torch.DoubleTensor(x), 0, 'wrong content with hints ' .. hints)
+   end
+   mytester:assertError(function() torch.DoubleStorage(filename, false, 0, false, 'randomly') end, 'invalid hint accepted')
+   mytester:assertError(function() torch.DoubleStorage(filename, false, 0, false, 'random sequential') end, 'exclusive hints accepted')
+   mytester:assertError(function() torch.DoubleStorage(filename):prefetch(4001, 1001) end, 'prefetch out of bounds')
+   -- not mapped: nothing to do
+   torch.DoubleStorage(10):prefetch()
+   os.remove(filename)
+end
+
+function torchtest.tensorFrames()
+   local x = torch.randn(5, 4)
+   local y = torch.IntTensor(3):random(100)
+   local f = torch.MemoryFile():binary()
+   f:writeTensorFrame(x)
+   f:writeTensorFrame(y)
+   f:writeTensorFrame(x:t())
+   f:writeTensorFrame(torch.FloatTensor())
+   f:seek(1)
+
+   local buffer = torch.DoubleTensor(5, 4)
+   local storage = torch.pointer(buffer:storage())
+   mytester:asserteq(f:readTensorFrame(buffer), buffer, 'frame not read into the given tensor')
+   mytester:assertTensorEq(buffer, x, 0, 'wrong frame')
+   mytester:asserteq(torch.pointer(buffer:storage()), storage, 'given tensor storage was replaced')
+   mytester:assertTensorEq(f:readTensorFrame(), y, 0, 'wrong int frame')
+   local transposed = torch.DoubleTensor(5, 4):t()
+   f:readTensorFrame(transposed)
+   mytester:assertTensorEq(transposed, x:t(), 0, 'wrong frame in a non-contiguous tensor')
+   mytester:asserteq(f:readTensorFrame(torch.FloatTensor(2)):dim(), 0, 'wrong empty frame')
+   mytester:asserteq(f:readTensorFrame(), nil, 'end of file expected')
+   mytester:assertError(function() f:seek(1); f:readTensorFrame(torch.FloatTensor()) end,
+                        'frame read into a tensor of another type')
+   f:close()
+end
+
+function torchtest.serializeView()
+   local x = torch.FloatTensor(1000):uniform()
+   local obj = {x = x, y = x:narrow(1, 11, 20), b = torch.ByteTensor(7):fill(3), name = 'view'}
+   local storage = torch.serializeToStorage(obj)
+   local copy = torch.deserializeFromStorage(storage)
+   mytester:assertTensorEq(copy.x, x, 0, 'wrong copied tensor')
+   local view = torch.deserializeFromStorage(storage, 'binary', true)
+   mytester:assertTensorEq(view.x, x, 0, 'wrong viewed tensor')
+   mytester:assertTensorEq(view.y, obj.y, 0, 'wrong viewed narrow')
+   mytester:assertTensorEq(view.b, obj.b, 0, 'wrong viewed byte tensor')
+   mytester:asserteq(view.name, 'view', 'wrong string')
+   -- the byte storage is always aligned, so it shares the serialized data
+   view.b:fill(5)
+   mytester:assertTensorEq(torch.deserializeFromStorage(storage).b, obj.b:clone():fill(5), 0,
+                           'byte storage is not a view')
+
+   -- chunked appends, followed by writes and reads in the middle
+   local f = torch.MemoryFile():binary()
+   local data = torch.DoubleTensor(100000):uniform()
+   for i = 1, 100 do
+      f:writeInt(i)
+   end
+   f:writeDouble(data:storage())
+   f:seek(1)
+   f:writeInt(-1)
+   f:seekEnd()
+   f:writeInt(101)
+   f:seek(1)
+   mytester:asserteq(f:readInt(), -1, 'wrong rewritten int')
+   f:seek(4*99+1)
+   mytester:asserteq(f:readInt(), 100, 'wrong appended int')
+   mytester:assertTensorEq(torch.DoubleTensor(f:readDouble(data:nElement())), data, 0, 'wrong appended data')
+   mytester:asserteq(f:readInt(), 101, 'wrong last int')
+   mytester:asserteq(f:storage():size(), 4*101 + 8*data:nElement() + 1, 'wrong storage size')
+   f:close()
+
+   -- chunks drained straight into a string
+   f = torch.MemoryFile():binary()
+   f:writeInt(7)
+   f:writeDouble(data:storage())
+   local str = f:drain()
+   mytester:asserteq(#str, 4 + 8*data:nElement(), 'wrong drained size')
+   f:writeInt(8)
+   mytester:asserteq(f:storage():size(), 5, 'drained file is not empty')
+   f:close()
+   f = torch.MemoryFile(torch.CharStorage():string(str), 'r', true):binary()
+   mytester:asserteq(f:readInt(), 7, 'wrong drained int')
+   mytester:assertTensorEq(torch.DoubleTensor(f:readDouble(data:nElement())), data, 0, 'wrong drained data')
+   f:close()
+end
+
+function torchtest.incrementalSave()
+   local base = os.tmpname()
+   local filename = os.tmpname()
+   local obj = {frozen = torch.randn(100, 100), tuned = torch.randn(100, 100), name = 'model'}
+   obj.view = obj.frozen:narrow(1, 2, 10)
+   torch.save(base, obj, 'binary', true, true)
+   mytester:assertTensorEq(torch.load(base).frozen, obj.frozen, 0, 'base checkpoint is not loadable')
+
+   obj.tuned:add(1)
+   torch.save(filename, obj, 'binary', true, base)
+   local function fileSize(name)
+      local file = torch.DiskFile(name)
+      local size = file:seekEnd():position()
+      file:close()
+      return size
+   end
+   local baseSize, size = fileSize(base), fileSize(filename)
+   mytester:assertlt(size, baseSize*0.75, 'unchanged storage was written again')
+
+   local loaded = torch.load(filename)
+   mytester:assertTensorEq(loaded.frozen, obj.frozen, 0, 'wrong referenced storage')
+   mytester:assertTensorEq(loaded.tuned, obj.tuned, 0, 'wrong changed storage')
+   mytester:assertTensorEq(loaded.view, obj.view, 0, 'wrong view')
+   mytester:asserteq(torch.pointer(loaded.view:storage()), torch.pointer(loaded.frozen:storage()), 'storage sharing lost')
+   mytester:asserteq(loaded.name, 'model', 'wrong string')
+
+   -- chains resolve to the file holding the data
+   local chained = os.tmpname()
+   torch.save(chained, loaded, 'binary', true, filename)
+   mytester:assertlt(fileSize(chained), baseSize*0.25, 'unchanged storages were written again')
+   mytester:assertTensorEq(torch.load(chained).frozen, obj.frozen, 0, 'wrong chained storage')
+   os.remove(chained)
+   os.remove(filename)
+   os.remove(base)
+end
+
+function torchtest.incrementalSaveMoved()
+   -- references are relative to the checkpoint directory, so that
+   -- checkpoints can be moved together
+   local root = os.tmpname()
+   os.remove(root)
+   paths.mkdir(root)
+   paths.mkdir(paths.concat(root, 'base'))
+   paths.mkdir(paths.concat(root, 'tuned'))
+   local obj = {frozen = torch.randn(100, 100), tuned = torch.randn(100, 100)}
+   torch.save(paths.concat(root, 'base', 'epoch1.t7'), obj, 'binary', true, true)
+   obj.tuned:add(1)
+   torch.save(paths.concat(root, 'tuned', 'epoch2.t7'), obj, 'binary', true, paths.concat(root, 'base', 'epoch1.t7'))
+
+   local moved = root .. '.moved'
+   mytester:assert(os.rename(root, moved), 'cannot move the checkpoint directory')
+   local loaded = torch.load(paths.concat(moved, 'tuned', 'epoch2.t7'))
+   mytester:assertTensorEq(loaded.frozen, obj.frozen, 0, 'wrong referenced storage after a move')
+   mytester:assertTensorEq(loaded.tuned, obj.tuned, 0, 'wrong changed storage after a move')
+   os.remove(paths.concat(moved, 'tuned', 'epoch2.t7'))
+   os.remove(paths.concat(moved, 'base', 'epoch1.t7'))
+   paths.rmdir(paths.concat(moved, 'tuned'))
+   paths.rmdir(paths.concat(moved, 'base'))
+   paths.rmdir(moved)
+end
+
 function torchtest.storageview()
    local s1 = torch.LongStorage({3, 4, 5})
    local s2 = torch.LongStorage(s1, 2)
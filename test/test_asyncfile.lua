@@ -0,0 +1,60 @@
+require 'torch'
+
+local tester = torch.Tester()
+local tests = torch.TestSuite()
+
+local function writeRecords(filename, n, size)
+   local f = torch.DiskFile(filename, 'w'):binary()
+   local records = {}
+   for i = 1, n do
+      records[i] = torch.rand(size)
+      f:writeObject(records[i])
+   end
+   f:close()
+   return records
+end
+
+function tests.readObject()
+   local filename = os.tmpname()
+   local records = writeRecords(filename, 20, 1000)
+   -- small buffers so that records straddle several of them
+   local f = torch.AsyncFile(filename, 4096, 3)
+   for i = 1, #records do
+      tester:assertTensorEq(f:readObject(), records[i], 0, 'record ' .. i .. ' differs')
+   end
+   f:close()
+   os.remove(filename)
+end
+
+function tests.seek()
+   local filename = os.tmpname()
+   local f = torch.DiskFile(filename, 'w'):binary()
+   f:writeInt(torch.range(1, 10000):int():storage())
+   f:close()
+
+   f = torch.AsyncFile(filename, 1024, 2)
+   f:seek(4*5000+1)
+   tester:asserteq(f:readInt(), 5001, 'wrong value after seek')
+   f:seek(4*10+1)
+   tester:asserteq(f:readInt(), 11, 'wrong value after seek backward')
+   tester:asserteq(f:position(), 4*11+1, 'wrong position')
+   f:seekEnd()
+   f:quiet()
+   f:readInt()
+   tester:assert(f:hasError(), 'reading past the end should fail')
+   f:close()
+   os.remove(filename)
+end
+
+function tests.readOnly()
+   local filename = os.tmpname()
+   writeRecords(filename, 1, 10)
+   local f = torch.AsyncFile(filename)
+   tester:assert(f:isReadable() and not f:isWritable(), 'AsyncFile is read-only')
+   tester:assertError(function() f:writeInt(1) end, 'writing should fail')
+   f:close()
+   os.remove(filename)
+end
+
+tester:add(tests)
+tester:run()
@@ -88,5 +88,105 @@ function tests.testSharing()
   removeShmFile(shmFileName)
 end
 
+function tests.sharedPool()
+  if ffi.os == 'Windows' then
+    return
+  end
+  local name = os.tmpname():gsub('/','_'):gsub('^', '/')
+  local pool = torch.SharedPool(name, 1000, 4)
+  tester:asserteq(pool:blockSize(), 1024, 'block size is not aligned')
+  tester:asserteq(pool:nFree(), 4, 'wrong number of free blocks')
+
+  local storage = torch.FloatStorage(pool, 100):fill(3)
+  storage:resize(256)
+  tester:assertError(function() storage:resize(257) end, 'storage resized past its block')
+  tester:asserteq(pool:nFree(), 3, 'block not taken')
+
+  -- the same block, seen through another mapping of the pool
+  local other = torch.SharedPool(name)
+  local block = pool:share(storage)
+  local shared = torch.FloatStorage(other, 100, block)
+  tester:asserteq(shared[100], 3, 'wrong shared content')
+  shared[1] = 7
+  tester:asserteq(storage[1], 7, 'storages do not share their block')
+  tester:assertError(function() torch.FloatStorage(other, 10, 5) end, 'invalid block accepted')
+
+  storage = nil
+  collectgarbage()
+  collectgarbage()
+  tester:asserteq(pool:nFree(), 3, 'block released while shared')
+  shared = nil
+  collectgarbage()
+  collectgarbage()
+  tester:asserteq(pool:nFree(), 4, 'block not released')
+
+  local storages = {}
+  for i = 1, 4 do
+    storages[i] = torch.ByteStorage(pool, 10)
+  end
+  tester:assertError(function() torch.ByteStorage(pool, 10) end, 'pool not exhausted')
+end
+
+function tests.sharedQueue()
+  if ffi.os == 'Windows' then
+    return
+  end
+  local name = os.tmpname():gsub('/','_'):gsub('^', '/')
+  local pool = torch.SharedPool(name, 1024, 8)
+  local queue = torch.SharedQueue(name .. '.queue', pool, 3)
+  tester:asserteq(queue:capacity(), 4, 'capacity is not a power of 2')
+  tester:asserteq(queue:tryPop(), nil, 'queue is not empty')
+  tester:assertError(function() queue:push(torch.FloatTensor(4)) end, 'pushed a tensor outside the pool')
+
+  for i = 1, 4 do
+    local tensor = torch.IntTensor(torch.IntStorage(pool, 12), 1, torch.LongStorage{3, 4}):fill(i)
+    tester:assert(queue:tryPush(tensor), 'queue is full')
+  end
+  tester:asserteq(queue:size(), 4, 'wrong queue size')
+  tester:assert(not queue:tryPush(torch.IntTensor(torch.IntStorage(pool, 1))), 'queue is not full')
+  collectgarbage()
+  collectgarbage()
+  tester:asserteq(pool:nFree(), 4, 'queued blocks released')
+
+  -- items are popped in order, from another mapping of the queue
+  local other = torch.SharedQueue(name .. '.queue')
+  for i = 1, 4 do
+    local tensor = other:pop()
+    tester:asserteq(torch.type(tensor), 'torch.IntTensor', 'wrong tensor type')
+    tester:assertTableEq(tensor:size():totable(), {3, 4}, 'wrong tensor size')
+    tester:asserteq(tensor:min(), i, 'wrong tensor content')
+    tester:asserteq(tensor:max(), i, 'wrong tensor content')
+  end
+  tester:asserteq(other:tryPop(), nil, 'queue is not empty')
+  collectgarbage()
+  collectgarbage()
+  tester:asserteq(pool:nFree(), 8, 'popped blocks not released')
+end
+
+function tests.memfdStorage()
+  if ffi.os ~= 'Linux' then
+    return
+  end
+  local storage = torch.FloatStorage(100, 'memfd'):fill(3)
+  tester:assert(storage:fd() ~= nil, 'memory file descriptor not kept')
+  tester:asserteq(torch.FloatStorage(10):fd(), nil, 'unexpected file descriptor')
+
+  local sender, receiver = torch.socketpair()
+  storage:send(sender)
+  torch.DoubleStorage(10, 'memfd'):send(sender)
+  local received = torch.receiveStorage(receiver)
+  tester:asserteq(torch.type(received), 'torch.FloatStorage', 'wrong storage type')
+  tester:asserteq(received:size(), 100, 'wrong storage size')
+  tester:asserteq(received[100], 3, 'wrong storage content')
+  received[1] = 7
+  tester:asserteq(storage[1], 7, 'storages do not share their memory')
+  tester:asserteq(torch.type(torch.receiveStorage(receiver)), 'torch.DoubleStorage', 'wrong storage type')
+
+  -- the sender closes its socket: no more storages
+  torch.DiskFile(sender, 'w'):close()
+  tester:asserteq(torch.receiveStorage(receiver), nil, 'storage received from a closed socket')
+  torch.DiskFile(receiver, 'r'):close()
+end
+
 tester:add(tests)
 tester:run()
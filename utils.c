@@ -5,6 +5,7 @@
 # include <time.h>
 #else
 # include <sys/time.h>
+# include <sys/socket.h>
 #endif
 
 THLongStorage* torch_checklongargs(lua_State *L, int index)
@@ -183,6 +184,22 @@ static int torch_getnumcores(lua_State *L)
   return 1;
 }
 
+static int torch_getconvwinograd(lua_State *L)
+{
+  int tile = THGetConvWinograd();
+  if(tile == TH_CONV_WINOGRAD_AUTO)
+    lua_pushnil(L);
+  else
+    lua_pushinteger(L, tile);
+  return 1;
+}
+
+static int torch_setconvwinograd(lua_State *L)
+{
+  THSetConvWinograd(lua_isnoneornil(L, 1) ? TH_CONV_WINOGRAD_AUTO : luaL_checkint(L, 1));
+  return 0;
+}
+
 static void luaTorchGCFunction(void *data)
 {
   lua_State *L = data;
@@ -222,6 +239,37 @@ static int torch_updateerrorhandlers(lua_State *L)
   return 0;
 }
 
+/* a connected pair of Unix domain sockets, to pass storages to a forked
+   process with storage:send() and torch.receiveStorage() */
+static int torch_socketpair(lua_State *L)
+{
+#ifdef _WIN32
+  return luaL_error(L, "socketpair is not supported on Windows");
+#else
+  int fds[2];
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+    return luaL_error(L, "unable to create a socket pair");
+  lua_pushinteger(L, fds[0]);
+  lua_pushinteger(L, fds[1]);
+  return 2;
+#endif
+}
+
+/* returns a file descriptor sent by storage:send() and its message, or
+   nothing when the peer closed the socket */
+static int torch_receivefd(lua_State *L)
+{
+  int socket = luaL_checkint(L, 1);
+  char message[TORCH_STORAGE_FD_MESSAGE_SIZE];
+  int fd = THMapAllocator_receiveFd(socket, message, sizeof(message));
+  if(fd < 0)
+    return 0;
+  message[sizeof(message)-1] = '\0';
+  lua_pushinteger(L, fd);
+  lua_pushstring(L, message);
+  return 2;
+}
+
 static const struct luaL_Reg torch_utils__ [] = {
   {"getdefaulttensortype", torch_lua_getdefaulttensortype},
   {"isatty", torch_isatty},
@@ -230,6 +278,8 @@ static const struct luaL_Reg torch_utils__ [] = {
   {"setnumthreads", torch_setnumthreads},
   {"getnumthreads", torch_getnumthreads},
   {"getnumcores", torch_getnumcores},
+  {"setconvwinograd", torch_setconvwinograd},
+  {"getconvwinograd", torch_getconvwinograd},
   {"factory", luaT_lua_factory},
   {"getconstructortable", luaT_lua_getconstructortable},
   {"typename", luaT_lua_typename},
@@ -245,6 +295,8 @@ static const struct luaL_Reg torch_utils__ [] = {
   {"pointer", luaT_lua_pointer},
   {"setheaptracking", torch_setheaptracking},
   {"updateerrorhandlers", torch_updateerrorhandlers},
+  {"socketpair", torch_socketpair},
+  {"receivefd", torch_receivefd},
   {NULL, NULL}
 };
 